@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+/* The consumer serves what it finds in one poll, which is often one or two keys under moderate load.
+ * With adaptive batching, the consumer polls a little longer to grow the batch, if more requests are expected soon.
+ *
+ * It keeps an EWMA of the arrival rate (requests per ns, sampled at each poll which finds requests),
+ * and waits for min(max_wait_ns, the expected time to reach target_batch) only if
+ * the expected arrivals in max_wait_ns are no less than min_gain.
+ * So under light load, or when the batch is big enough (heavy load), it serves immediately.
+ *
+ * The arrival rate is not enough: if all producers are waiting for this batch (e.g., a few closed loop producers),
+ * no more request will come however high the rate is. So it also keeps an EWMA of the requests gained by each wait,
+ * and stops waiting when the waits do not pay, except one probe for every kProbeInterval batches.
+ */
+
+namespace cmp_mem_engine
+{
+
+struct BatchingConfig
+{
+    uint64_t max_wait_ns = 0;       // the most time to wait for one batch, 0 means immediate service (disabled)
+    size_t target_batch = 32;       // stop waiting when the batch reaches it
+    double min_gain = 1.0;          // the least requests expected from one wait
+};
+
+class AdaptiveBatcher
+{
+private:
+    static constexpr double kAlpha = 0.125;        // the weight of the newest sample of EWMA
+    static constexpr size_t kProbeInterval = 64;
+
+    BatchingConfig config_;
+    double rate_ = 0;                               // requests per ns
+    double gain_ = 0;                               // requests gained per wait
+    uint64_t last_ns_ = 0;
+    size_t skipped_ = 0;
+
+public:
+    void configure(const BatchingConfig& config)
+    {
+        config_ = config;
+        rate_ = 0;
+        gain_ = config.min_gain;                    // try to wait at first
+        last_ns_ = 0;
+        skipped_ = 0;
+    }
+
+    bool enabled() const
+    {
+        return config_.max_wait_ns != 0;
+    }
+
+    size_t target() const
+    {
+        return config_.target_batch;
+    }
+
+    // Called when a poll at now_ns finds cnt requests for a new batch,
+    // return how long to keep polling for more (0 meaning serve now)
+    uint64_t budget(const size_t cnt, const uint64_t now_ns)
+    {
+        observe(cnt, now_ns);
+
+        if (cnt >= config_.target_batch || rate_ * static_cast<double>(config_.max_wait_ns) < config_.min_gain)
+            return 0;
+
+        if (gain_ < config_.min_gain && ++skipped_ % kProbeInterval != 0)
+            return 0;
+
+        const double to_target = static_cast<double>(config_.target_batch - cnt) / rate_;
+        return static_cast<uint64_t>(std::min(static_cast<double>(config_.max_wait_ns), to_target));
+    }
+
+    // Called after the wait which got extra requests, at now_ns
+    void waited(const size_t extra, const uint64_t now_ns)
+    {
+        observe(extra, now_ns);
+        gain_ += kAlpha * (static_cast<double>(extra) - gain_);
+    }
+
+private:
+    void observe(const size_t cnt, const uint64_t now_ns)
+    {
+        if (last_ns_ != 0 && now_ns > last_ns_)
+            rate_ += kAlpha * (static_cast<double>(cnt) / static_cast<double>(now_ns - last_ns_) - rate_);
+
+        last_ns_ = now_ns;
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,112 @@
+#include "async_producer.h"
+
+#include <cassert>
+
+namespace cmp_mem_engine
+{
+
+PendingKeys::PendingKeys(const size_t capacity)
+{
+    // no more than half of the buckets are used
+    size_t bucket_num = 16;
+    while (bucket_num < capacity * 2)
+        bucket_num *= 2;
+
+    buckets_.resize(bucket_num);
+    waiters_.reserve(capacity);
+}
+
+size_t PendingKeys::find(const std::string* key) const
+{
+    const size_t mask = buckets_.size() - 1;
+
+    size_t pos = home_of(key);
+    while (buckets_[pos].key != nullptr && buckets_[pos].key != key)
+        pos = (pos + 1) & mask;
+
+    return pos;
+}
+
+void PendingKeys::add(const std::string* key, AsyncBatch* batch, const uint32_t index)
+{
+    uint32_t w = free_;
+    if (w != kNil)
+    {
+        free_ = waiters_[w].next;
+        waiters_[w] = {batch, index, kNil};
+    }
+    else
+    {
+        w = static_cast<uint32_t>(waiters_.size());
+        waiters_.push_back({batch, index, kNil});
+    }
+
+    Bucket& bucket = buckets_[find(key)];
+    if (bucket.key == key)
+    {
+        waiters_[bucket.tail].next = w;
+        bucket.tail = w;
+        return;
+    }
+
+    bucket = {key, w, w};
+    if (++key_num_ * 2 > buckets_.size())
+        grow();
+}
+
+std::pair<AsyncBatch*, uint32_t> PendingKeys::take(const std::string* key)
+{
+    const size_t pos = find(key);
+    Bucket& bucket = buckets_[pos];
+    assert(bucket.key == key);
+
+    const uint32_t w = bucket.head;
+    const Waiter waiter = waiters_[w];
+
+    waiters_[w].next = free_;
+    free_ = w;
+
+    if (waiter.next != kNil)
+        bucket.head = waiter.next;
+    else
+        erase_bucket(pos);
+
+    return {waiter.batch, waiter.index};
+}
+
+// backward shift deletion, so no tombstone for linear probing
+void PendingKeys::erase_bucket(size_t pos)
+{
+    const size_t mask = buckets_.size() - 1;
+
+    buckets_[pos].key = nullptr;
+    --key_num_;
+
+    for (size_t next = (pos + 1) & mask; buckets_[next].key != nullptr; next = (next + 1) & mask)
+    {
+        const size_t home = home_of(buckets_[next].key);
+
+        // the bucket stays if its home is cyclically in (pos, next]
+        const bool stay = pos <= next ? (pos < home && home <= next) : (pos < home || home <= next);
+        if (stay)
+            continue;
+
+        buckets_[pos] = buckets_[next];
+        buckets_[next].key = nullptr;
+        pos = next;
+    }
+}
+
+void PendingKeys::grow()
+{
+    std::vector<Bucket> old(buckets_.size() * 2);
+    old.swap(buckets_);
+
+    for (const Bucket& bucket : old)
+    {
+        if (bucket.key != nullptr)
+            buckets_[find(bucket.key)] = bucket;
+    }
+}
+
+}   // namespace cmp_mem_engine
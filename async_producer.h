@@ -0,0 +1,536 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <tuple>
+#include <utility>
+#include <iostream>
+#include <coroutine>
+#include <exception>
+
+#include "const_and_share_struct.h"
+#include "producer_consumer.h"
+
+
+/* AsyncProducer<Transport, Wait> is a producer thread which runs many logical transactions at the same time.
+ *
+ * Each transaction is a C++20 coroutine, which looks up its keys by
+ *
+ *     co_await producer.get_batch(keys, vals);
+ *
+ * and is suspended until all of vals are answered. The producer thread is a scheduler of the coroutines:
+ * it sends the keys of the suspended transactions to the transport, receives the results,
+ * and resumes a coroutine when the results of its batch are all received.
+ * So one thread keeps hundreds of keys in flight, and hides the round trip to the consumer,
+ * if the transport can hold them (e.g., RingTransport). It has the same interface as Producer.
+ *
+ * The transports report a result by the key pointer, not by the request.
+ * If more than one batch is waiting for the same key pointer, the result goes to the oldest one,
+ * it does not matter because the value of the same key is the same.
+ */
+
+namespace cmp_mem_engine
+{
+
+// The number of concurrent logical transactions of one AsyncProducer in closed loop
+constexpr size_t kAsyncTransactionNum = 64;
+
+// The coroutine type of a logical transaction. It starts suspended, then is handed to AsyncProducer::spawn(),
+// the frame is freed when it returns
+class AsyncTask
+{
+public:
+    struct promise_type
+    {
+        size_t* live = nullptr;      // the counter of the scheduler
+
+        AsyncTask get_return_object()
+        {
+            return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void()
+        {
+            --*live;
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit AsyncTask(const std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+public:
+    AsyncTask() = delete;
+    AsyncTask(const AsyncTask&) = delete;
+    AsyncTask& operator=(const AsyncTask&) = delete;
+    AsyncTask& operator=(AsyncTask&&) = delete;
+
+    AsyncTask(AsyncTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    ~AsyncTask()
+    {
+        // never spawned
+        if (handle_)
+            handle_.destroy();
+    }
+
+    std::coroutine_handle<promise_type> release()
+    {
+        return std::exchange(handle_, nullptr);
+    }
+};
+
+// One co_await of get_batch(), lives in the frame of the suspended coroutine
+struct AsyncBatch
+{
+    const std::vector<const std::string*>* keys = nullptr;
+    std::vector<const std::string*>* vals = nullptr;
+    size_t sent = 0;                // keys[0, sent) have been sent
+    size_t remaining = 0;           // the number of keys not answered
+    std::coroutine_handle<> waiter;
+    AsyncBatch* next = nullptr;     // in the send queue
+};
+
+/* The in-flight keys of one AsyncProducer, from the key pointer to the batches waiting for it (FIFO).
+ * An open addressing table (linear probing) of the key pointers,
+ * and the waiters of one key are linked in a pool, so no allocation after warm up.
+ */
+class PendingKeys
+{
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Waiter
+    {
+        AsyncBatch* batch;
+        uint32_t index;             // of batch->keys
+        uint32_t next;
+    };
+
+    struct Bucket
+    {
+        const std::string* key = nullptr;
+        uint32_t head = kNil;
+        uint32_t tail = kNil;
+    };
+
+    std::vector<Waiter> waiters_;
+    uint32_t free_ = kNil;
+
+    std::vector<Bucket> buckets_;
+    size_t key_num_ = 0;
+
+public:
+    PendingKeys(const PendingKeys&) = delete;
+    PendingKeys(PendingKeys&&) = delete;
+    PendingKeys& operator=(const PendingKeys&) = delete;
+    PendingKeys& operator=(PendingKeys&&) = delete;
+
+    explicit PendingKeys(const size_t capacity = kAsyncTransactionNum * kTransactionOneStepMostKeys);
+
+    void add(const std::string* key, AsyncBatch* batch, const uint32_t index);
+    // pop the oldest waiter of key, which must have been added
+    std::pair<AsyncBatch*, uint32_t> take(const std::string* key);
+
+private:
+    size_t home_of(const std::string* key) const
+    {
+        return static_cast<size_t>((reinterpret_cast<uintptr_t>(key) * 0x9E3779B97F4A7C15) >> 32) & (buckets_.size() - 1);
+    }
+
+    size_t find(const std::string* key) const;
+    void erase_bucket(size_t pos);
+    void grow();
+};
+
+template <typename Transport, typename Wait>
+class AsyncProducer
+{
+private:
+    KeySampler sampler_;
+    std::thread thread_;
+
+    typename Transport::ProducerEnd end_;
+    Wait wait_;
+
+    // point to local_stats_, or to a block of LiveStats if published
+    ProducerStats local_stats_;
+    ProducerStats* stats_ = &local_stats_;
+    const size_t bench_num_;
+    const size_t pid_;
+
+    OpenLoopConfig open_loop_;
+    LatencyHistogram latency_;
+
+    std::chrono::high_resolution_clock::time_point time_start_;
+    std::chrono::high_resolution_clock::time_point time_end_;
+
+    // the scheduler, only touched by the producer thread
+    size_t live_ = 0;                                   // the number of coroutines not returned
+    size_t issued_ = 0;                                 // the keys taken by the transactions, for closed loop
+    std::vector<std::coroutine_handle<>> ready_;
+    std::vector<std::coroutine_handle<>> resuming_;
+    AsyncBatch* send_head_ = nullptr;
+    AsyncBatch* send_tail_ = nullptr;
+    PendingKeys pending_;
+    size_t request_most_ = 0;
+    size_t result_most_ = 0;
+
+public:
+    class BatchAwaiter
+    {
+    private:
+        AsyncProducer& producer_;
+        AsyncBatch batch_;
+
+    public:
+        BatchAwaiter(AsyncProducer& producer, const std::vector<const std::string*>& keys,
+                     std::vector<const std::string*>& vals)
+            : producer_(producer)
+        {
+            batch_.keys = &keys;
+            batch_.vals = &vals;
+            batch_.remaining = keys.size();
+            vals.assign(keys.size(), nullptr);
+        }
+
+        bool await_ready() const
+        {
+            return batch_.remaining == 0;
+        }
+
+        void await_suspend(const std::coroutine_handle<> waiter)
+        {
+            batch_.waiter = waiter;
+            producer_.enqueue(&batch_);
+        }
+
+        void await_resume() const {}
+    };
+
+    AsyncProducer() = delete;
+    AsyncProducer(const AsyncProducer&) = delete;
+    AsyncProducer(AsyncProducer&&) = delete;
+    AsyncProducer& operator=(const AsyncProducer&) = delete;
+    AsyncProducer& operator=(AsyncProducer&&) = delete;
+
+    // The producer looks up bench_num keys in benchmark() by kAsyncTransactionNum coroutines
+    explicit AsyncProducer(const size_t pid, typename Transport::Channel& channel, const std::vector<std::string>& samples,
+                           const size_t bench_num = kBenchmarkCount)
+        : sampler_(pid, samples), end_(pid, channel), bench_num_(bench_num), pid_(pid)
+    {
+        wait_.bind(end_.parker());
+        ready_.reserve(kAsyncTransactionNum);
+        resuming_.reserve(kAsyncTransactionNum);
+    }
+
+    // Call before start_thread(), then each arrival of the open loop is a new coroutine
+    // which does not wait for the transactions before it, for config.duration (bench_num is not used)
+    void set_open_loop(const OpenLoopConfig& config)
+    {
+        open_loop_ = config;
+    }
+
+    ~AsyncProducer() noexcept
+    {
+        try
+        {
+            wait_until_join();
+        }
+        catch(std::system_error& e)
+        {
+            std::cerr << "~AsyncProducer() failed when join, reason = " << e.what() << '\n';
+        }
+    }
+
+    void start_thread()
+    {
+        std::thread t(&AsyncProducer::benchmark, this);
+        thread_ = std::move(t);
+    }
+
+    void wait_until_join()
+    {
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    std::tuple<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>
+    get_time_points() const
+    {
+        return {time_start_, time_end_};
+    }
+
+    size_t get_bench_count() const
+    {
+        return stats_->bench_cnt;
+    }
+
+    const ProducerStats& get_stats() const
+    {
+        return *stats_;
+    }
+
+    // Call before start_thread(), then the stats are written to the shared memory of live_stats
+    void publish_stats(LiveStats& live_stats)
+    {
+        ProducerStats* block = live_stats.add_producer(pid_);
+        if (block != nullptr)
+            stats_ = block;
+    }
+
+    // the latency of each transaction from its intended send time, only for open loop
+    const LatencyHistogram& get_latency() const
+    {
+        return latency_;
+    }
+
+    // Only for the coroutines spawned by this producer.
+    // Suspend until vals[i] is the answer of keys[i] for all i (kNotFound for a miss),
+    // keys and vals must live until resumed. vals[i] may be read only if the cache releases no value
+    // (see the lifetime of a result value in producer_consumer.h)
+    BatchAwaiter get_batch(const std::vector<const std::string*>& keys, std::vector<const std::string*>& vals)
+    {
+        return BatchAwaiter(*this, keys, vals);
+    }
+
+    // Only called by the producer thread, the task is resumed by the next round of the scheduler
+    void spawn(AsyncTask task)
+    {
+        std::coroutine_handle<AsyncTask::promise_type> handle = task.release();
+        handle.promise().live = &live_;
+        ++live_;
+        ready_.push_back(handle);
+    }
+
+private:
+    void benchmark()
+    {
+        CMP_TRACE_THREAD("async producer " + std::to_string(pid_));
+
+        const size_t cpu_start = thread_cpu_ns();
+
+        if (open_loop_.tx_per_sec > 0)
+            benchmark_open_loop();
+        else
+            benchmark_closed_loop();
+
+        stats_->cpu_ns = thread_cpu_ns() - cpu_start;
+    }
+
+    void benchmark_closed_loop()
+    {
+        time_start_ = std::chrono::high_resolution_clock::now();
+
+        for (size_t i = 0; i != kAsyncTransactionNum; ++i)
+        {
+            spawn(closed_loop_transactions());
+        }
+
+        while (live_ != 0)
+        {
+            schedule_round();
+        }
+
+        time_end_ = std::chrono::high_resolution_clock::now();
+    }
+
+    void benchmark_open_loop()
+    {
+        time_start_ = std::chrono::high_resolution_clock::now();
+        const std::chrono::high_resolution_clock::time_point stop = time_start_ + open_loop_.duration;
+
+        ArrivalSchedule schedule(pid_, open_loop_, time_start_);
+        std::chrono::high_resolution_clock::time_point intended = schedule.next();
+
+        while (intended < stop || live_ != 0)
+        {
+            // nothing in flight, so nothing to do before the next arrival
+            if (live_ == 0)
+                ArrivalSchedule::wait_until(intended);
+
+            const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+            while (intended < stop && intended <= now)
+            {
+                spawn(open_loop_transaction(intended));
+                intended = schedule.next();
+            }
+
+            schedule_round();
+        }
+
+        time_end_ = std::chrono::high_resolution_clock::now();
+    }
+
+    // bench_cnt is updated for each transaction, so it is live for LiveStats
+    AsyncTask closed_loop_transactions()
+    {
+        std::vector<const std::string*> keys;
+        std::vector<const std::string*> vals;
+        keys.reserve(kTransactionOneStepMostKeys);
+        vals.reserve(kTransactionOneStepMostKeys);
+
+        while (issued_ < bench_num_)
+        {
+            const size_t key_batch_num = sampler_.rand_batch_num();
+            issued_ += key_batch_num;
+            sampler_.prepare_input_keys(key_batch_num, keys);
+
+            co_await get_batch(keys, vals);
+
+            stats_->bench_cnt += key_batch_num;
+        }
+    }
+
+    // one frame for each arrival, the latency is from its intended time
+    AsyncTask open_loop_transaction(const std::chrono::high_resolution_clock::time_point intended)
+    {
+        std::vector<const std::string*> keys;
+        std::vector<const std::string*> vals;
+
+        const size_t key_batch_num = sampler_.rand_batch_num();
+        sampler_.prepare_input_keys(key_batch_num, keys);
+
+        co_await get_batch(keys, vals);
+
+        const auto done = std::chrono::high_resolution_clock::now();
+        latency_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+
+        stats_->bench_cnt += key_batch_num;
+    }
+
+    void enqueue(AsyncBatch* batch)
+    {
+        if (send_tail_ == nullptr)
+            send_head_ = batch;
+        else
+            send_tail_->next = batch;
+
+        send_tail_ = batch;
+    }
+
+    // resume the ready coroutines, send the waiting keys and receive the results, then wait if no progress
+    void schedule_round()
+    {
+        bool progress = false;
+
+        // the resumed coroutines maybe make the others ready (e.g., spawn), they go to the next round
+        if (!ready_.empty())
+        {
+            resuming_.swap(ready_);
+            for (std::coroutine_handle<> handle : resuming_)
+            {
+                handle.resume();
+            }
+            resuming_.clear();
+            progress = true;
+        }
+
+        if (send_head_ != nullptr && end_.can_send())
+            progress |= send_batches();
+
+        const size_t answered_in_this_turn = end_.receive([this](const std::string* key, const std::string* val)
+        {
+            auto [batch, index] = pending_.take(key);
+            (*batch->vals)[index] = val;
+
+            if (reinterpret_cast<const char*>(val) == kNotFound)
+            {
+                ++stats_->miss_cnt;
+            }
+            else
+            {
+                ++stats_->hit_cnt;
+            }
+
+            if (--batch->remaining == 0)
+                ready_.push_back(batch->waiter);
+        });
+
+        if (answered_in_this_turn == 0)
+        {
+            ++stats_->result_wait_cnt;
+            ++result_most_;
+        }
+        else
+        {
+            CMP_TRACE_EVENT(TraceType::kResultObserved, answered_in_this_turn);
+
+            if (result_most_ > stats_->result_wait_most)
+                stats_->result_wait_most = result_most_;
+
+            result_most_ = 0;
+            progress = true;
+        }
+
+        if (progress)
+        {
+            wait_.reset();
+        }
+        else
+        {
+            if (wait_.idle())
+                ++stats_->sleep_cnt;
+        }
+    }
+
+    // send the queued batches in order until the transport is full, return true if any key is sent
+    bool send_batches()
+    {
+        bool progress = false;
+
+        while (send_head_ != nullptr)
+        {
+            AsyncBatch* batch = send_head_;
+            const std::vector<const std::string*>& keys = *batch->keys;
+
+            const size_t sent_in_this_turn = end_.send(keys, batch->sent);
+            if (sent_in_this_turn == 0)
+            {
+                ++stats_->request_wait_cnt;
+                ++request_most_;
+                break;
+            }
+
+            CMP_TRACE_EVENT(TraceType::kRequestPublish, sent_in_this_turn);
+
+            // before the next receive(), so a result always finds its waiter
+            for (size_t i = batch->sent; i != batch->sent + sent_in_this_turn; ++i)
+            {
+                pending_.add(keys[i], batch, static_cast<uint32_t>(i));
+            }
+            batch->sent += sent_in_this_turn;
+
+            if (request_most_ > stats_->request_wait_most)
+                stats_->request_wait_most = request_most_;
+
+            request_most_ = 0;
+            progress = true;
+
+            if (batch->sent != keys.size())
+                break;
+
+            send_head_ = batch->next;
+            if (send_head_ == nullptr)
+                send_tail_ = nullptr;
+
+            if (!end_.can_send())
+                break;
+        }
+
+        return progress;
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <functional>
+
+/* Most lookups go to a few hot keys, so a batch from several producers often has the same key more than once.
+ * BatchDedup finds the first slot of the same key in one batch, so the consumer does one lookup
+ * (and one promotion of 2Q) for each distinct key, and copies the result to the other slots.
+ *
+ * The producers have their own copies of the keys, so the keys are compared by the strings, not the pointers.
+ * An open addressing table of (hash, slot) for one batch, which is not cleared but invalidated by the batch stamp.
+ */
+
+namespace cmp_mem_engine
+{
+
+class BatchDedup
+{
+public:
+    static constexpr size_t kNoSlot = SIZE_MAX;
+
+private:
+    struct Entry
+    {
+        size_t hash;
+        uint32_t slot;
+        uint32_t stamp;         // the entry is used only if stamp == stamp_
+    };
+
+    std::vector<Entry> entries_;
+    uint32_t stamp_ = 0;
+
+public:
+    BatchDedup() = delete;
+    BatchDedup(const BatchDedup&) = delete;
+    BatchDedup(BatchDedup&&) = delete;
+    BatchDedup& operator=(const BatchDedup&) = delete;
+    BatchDedup& operator=(BatchDedup&&) = delete;
+
+    // capacity is the most keys in one batch
+    explicit BatchDedup(const size_t capacity)
+    {
+        size_t size = 16;
+        while (size < capacity * 2)
+            size *= 2;
+
+        entries_.resize(size, Entry{0, 0, 0});
+    }
+
+    // Called before the first find_or_add() of a batch, or again to forget the slots so far
+    // (e.g., a key is written in the middle of the batch)
+    void begin_batch()
+    {
+        if (++stamp_ == 0)
+        {
+            // wrap around, the old stamps are not valid any more
+            for (Entry& e : entries_)
+                e.stamp = 0;
+            stamp_ = 1;
+        }
+    }
+
+    // Return the first slot before slot which has the same key in keys, or kNoSlot if key[slot] is the first one
+    size_t find_or_add(const std::vector<const std::string*>& keys, const size_t slot)
+    {
+        const std::string& key = *keys[slot];
+        const size_t hash = std::hash<std::string>()(key);
+        const size_t mask = entries_.size() - 1;
+
+        for (size_t pos = ((hash * 0x9E3779B97F4A7C15ull) >> 32) & mask; ; pos = (pos + 1) & mask)
+        {
+            Entry& e = entries_[pos];
+            if (e.stamp != stamp_)
+            {
+                e = Entry{hash, static_cast<uint32_t>(slot), stamp_};
+                return kNoSlot;
+            }
+
+            if (e.hash == hash && (keys[e.slot] == keys[slot] || *keys[e.slot] == key))
+                return e.slot;
+        }
+    }
+};
+
+}   // namespace cmp_mem_engine
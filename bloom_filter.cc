@@ -0,0 +1,25 @@
+#include "bloom_filter.h"
+
+#include <cstring>
+
+namespace cmp_mem_engine
+{
+
+BlockedBloomFilter::BlockedBloomFilter(const size_t key_num)
+{
+    constexpr size_t kBlockBits = sizeof(Block) * 8;
+
+    size_t block_num = 1;
+    while (block_num * kBlockBits < key_num * kBloomBitsPerKey)
+        block_num *= 2;
+
+    blocks_ = std::make_unique<Block[]>(block_num);      // zeroed
+    block_mask_ = block_num - 1;
+}
+
+void BlockedBloomFilter::clear()
+{
+    std::memset(static_cast<void*>(blocks_.get()), 0, size_in_bytes());
+}
+
+}   // namespace cmp_mem_engine
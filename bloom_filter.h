@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* A blocked Bloom filter (the split block Bloom filter of Parquet / Impala):
+ * the filter is an array of 256-bit blocks, a key selects one block by its hash,
+ * and sets one bit in each of the 8 32-bit words of the block.
+ * So a lookup is one memory access (a block is in one cache line), and the 8 bits are tested at once by SIMD.
+ *
+ * With kBloomBitsPerKey = 16 the false positive rate is about 0.5%.
+ * It does not support delete, rebuild it (clear() then insert all) after many deletes.
+ *
+ * The SIMD path is AVX2 if compiled with it (e.g., -mavx2), else SSE2 for the test, else scalar.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kBloomBitsPerKey = 16;
+
+class BlockedBloomFilter
+{
+private:
+    struct alignas(32) Block
+    {
+        uint32_t words[8];
+    };
+
+    static constexpr uint32_t kSalts[8] =
+    {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+    };
+
+    std::unique_ptr<Block[]> blocks_;
+    size_t block_mask_;
+
+public:
+    BlockedBloomFilter() = delete;
+    BlockedBloomFilter(const BlockedBloomFilter&) = delete;
+    BlockedBloomFilter(BlockedBloomFilter&&) = delete;
+    BlockedBloomFilter& operator=(const BlockedBloomFilter&) = delete;
+    BlockedBloomFilter& operator=(BlockedBloomFilter&&) = delete;
+
+    // key_num is the expected number of keys
+    explicit BlockedBloomFilter(const size_t key_num);
+
+    void clear();
+
+    // hash is the 64-bit hash of the key, the high half selects the block and the low half the bits
+    void insert(const uint64_t hash)
+    {
+        Block& block = blocks_[block_of(hash)];
+        const Block mask = make_mask(static_cast<uint32_t>(hash));
+
+        for (size_t i = 0; i != 8; ++i)
+            block.words[i] |= mask.words[i];
+    }
+
+    // false if the key of hash is surely not inserted
+    bool may_contain(const uint64_t hash) const
+    {
+        const Block& block = blocks_[block_of(hash)];
+
+#if defined(__AVX2__)
+        const __m256i salts = _mm256_setr_epi32(kSalts[0], kSalts[1], kSalts[2], kSalts[3],
+                                                kSalts[4], kSalts[5], kSalts[6], kSalts[7]);
+        const __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(hash)), salts), 27);
+        const __m256i mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+
+        // all bits of mask are in block
+        return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(block.words)), mask) != 0;
+#elif defined(__SSE2__)
+        const Block mask = make_mask(static_cast<uint32_t>(hash));
+
+        const __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i*>(block.words));
+        const __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i*>(block.words + 4));
+        const __m128i mask_lo = _mm_load_si128(reinterpret_cast<const __m128i*>(mask.words));
+        const __m128i mask_hi = _mm_load_si128(reinterpret_cast<const __m128i*>(mask.words + 4));
+
+        const __m128i eq = _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(lo, mask_lo), mask_lo),
+                                         _mm_cmpeq_epi32(_mm_and_si128(hi, mask_hi), mask_hi));
+        return _mm_movemask_epi8(eq) == 0xffff;
+#else
+        const Block mask = make_mask(static_cast<uint32_t>(hash));
+
+        for (size_t i = 0; i != 8; ++i)
+        {
+            if ((block.words[i] & mask.words[i]) != mask.words[i])
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    size_t size_in_bytes() const
+    {
+        return (block_mask_ + 1) * sizeof(Block);
+    }
+
+private:
+    size_t block_of(const uint64_t hash) const
+    {
+        return static_cast<size_t>(hash >> 32) & block_mask_;
+    }
+
+    static Block make_mask(const uint32_t low)
+    {
+        Block mask;
+        for (size_t i = 0; i != 8; ++i)
+            mask.words[i] = uint32_t(1) << ((low * kSalts[i]) >> 27);
+
+        return mask;
+    }
+};
+
+}   // namespace cmp_mem_engine
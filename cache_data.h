@@ -0,0 +1,689 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <memory>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+
+#include "const_and_share_struct.h"
+#include "random_str.h"
+#include "near_cache.h"
+#include "heavy_hitters.h"
+#include "bloom_filter.h"
+#include "timer_wheel.h"
+#include "policy_slru.h"
+#include "shards_mrc.h"
+#include "write_behind.h"
+#include "hot_set.h"
+#include "compute_op.h"
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kUnlimitedCapacity = std::numeric_limits<size_t>::max();
+
+// Own by one single threead, no lock using.
+// Policy is the eviction policy (see eviction_policy.h), SingleData is of the SLRU (2Q) one
+template <typename Policy>
+class CacheData
+{
+private:
+    using Map = std::unordered_map<HeapKey, CombinedVal>;
+
+    RandomEngine re_;
+
+    Map key_vals_;
+    // the policy is tuned for the key space (of a shard), the keys are evicted only if they are more than capacity_
+    Policy policy_;
+    size_t capacity_ = kUnlimitedCapacity;
+
+    size_t hit_cnt_;
+    size_t miss_cnt_;
+
+    // the versions of the near caches of the producers, bumped before a key is written or evicted
+    VersionStripes* versions_ = nullptr;
+
+    // the most frequent keys of all lookups (hit or miss)
+    HeavyHitters heavy_hitters_;
+
+    // optional, the puts are written behind to its sink
+    WriteBehind* write_behind_ = nullptr;
+
+    // optional, the miss ratio curve of all lookups
+    std::unique_ptr<ShardsMrc> mrc_;
+
+    // optional, in front of key_vals_ so most misses do not probe it
+    std::unique_ptr<BlockedBloomFilter> bloom_;
+    size_t bloom_negative_cnt_ = 0;         // the misses answered by the filter
+    size_t bloom_false_positive_cnt_ = 0;   // the misses which passed the filter
+
+    // the keys with TTL, an expired key is a miss at once (lazy), and removed when its timer is due
+    TimerWheel wheel_;
+    // the keys of the evicted entries which still have timers, freed when the timers are due
+    std::unordered_map<const std::string*, std::unique_ptr<const std::string>> orphan_keys_;
+    uint64_t epoch_ms_;
+    size_t lazy_expired_cnt_ = 0;           // the lookups of expired keys not removed yet
+    size_t expired_cnt_ = 0;                // the keys removed by the wheel
+    size_t evicted_cnt_ = 0;                // the victims of the policy
+    // the values freed (removed keys) or changed (replaced or written in place), so a value pointer
+    // of an earlier result may be dangling or torn (see the lifetime of a result value in producer_consumer.h)
+    size_t released_val_cnt_ = 0;
+
+    // the sampled insert times in lookups, for the ages of the hits and the victims in the policy telemetry
+    AgeSampler ages_;
+    uint64_t lookup_cnt_ = 0;               // the clock of the ages, not reset by reset_hit_miss()
+
+public:
+    CacheData() = delete;
+    CacheData(const CacheData&) = delete;
+    CacheData(CacheData&&) = delete;
+    CacheData& operator=(const CacheData&) = delete;
+    CacheData& operator=(CacheData&&) = delete;
+
+    // The shard shard_idx of shard_num only keeps the keys of shard_of(key, shard_num) == shard_idx.
+    // All shards generate the same key space, and the same samples (from all shards)
+    explicit CacheData(const size_t init_key_num, const size_t sample_num, std::vector<std::string>& samples,
+                       const size_t shard_idx = 0, const size_t shard_num = 1)
+        : re_(1), policy_(init_key_num / shard_num), hit_cnt_(0), miss_cnt_(0), epoch_ms_(coarse_clock_ms())
+    {
+        assert(sample_num <= init_key_num && samples.empty());
+        assert(shard_idx < shard_num);
+
+        key_vals_.reserve(init_key_num / shard_num);
+
+        size_t sample_cnt = 0;
+
+        for (size_t i = 0; i != init_key_num; ++i)
+        {
+            std::string key = rand_str_scope(re_, kKeyMinLen, kKeyMaxLen);
+            std::string val = rand_str_scope(re_, kValMinLen, kValMaxLlen);
+
+            if (sample_cnt < sample_num)
+            {
+                samples.push_back(key);
+                ++sample_cnt;
+            }
+
+            if (shard_num != 1 && shard_of(key, shard_num) != shard_idx)
+                continue;
+
+            // add key and value to HashMap and the policy
+            auto [it_map, inserted] = 
+                key_vals_.insert({HeapKey(std::make_unique<std::string>(std::move(key))), CombinedVal(std::move(val))});
+            if (inserted)
+            {
+                const std::string* key = &(it_map->first.real_key()); 
+                const uint64_t hash = std::hash<std::string>()(*key);
+                it_map->second.policy_link = policy_.on_insert(key, hash);
+                ages_.on_insert(key, hash, lookup_cnt_);
+            }
+        }
+    }
+
+    // Return nullptr if not found, else the value of std::sttring.
+    // It will refresh the policy for each hit
+    std::string* find_val(const std::string& key)
+    {
+        CombinedVal* entry = lookup(key);
+        return entry == nullptr ? nullptr : &entry->val;
+    }
+
+    // Insert key or replace its value, evict the victims of the policy if the keys are more than the capacity.
+    // Return the value in the cache
+    std::string* insert(const std::string& key, std::string&& val)
+    {
+        return &insert_entry(key, std::move(val)).val;
+    }
+
+    // Insert key if it is absent (or expired), else keep the value in the cache, e.g., a loaded value
+    // which must not replace a write (of a compute request) after the miss. Return the value in the cache
+    std::string* insert_absent(const std::string& key, std::string&& val)
+    {
+        const HeapKey stack_key(&key);
+        const auto it = key_vals_.find(stack_key);
+        if (it != key_vals_.end() && (it->second.expire_ms == 0 || it->second.expire_ms > now_ms()))
+            return &it->second.val;
+
+        return insert(key, std::move(val));
+    }
+
+    // Insert key or replace its value like insert(), and mark it dirty for the write-behind if any
+    std::string* put(const std::string& key, std::string&& val)
+    {
+        std::string* in_cache = insert(key, std::move(val));
+        if (write_behind_ != nullptr)
+            write_behind_->put(key, *in_cache);
+
+        return in_cache;
+    }
+
+    // Run the compute request (see compute_op.h) on its key, a lookup and maybe a write of the value,
+    // the status, the version and the result are written to request. The writes are put like put()
+    void apply(ComputeRequest& request)
+    {
+        request.result.clear();
+        request.version = 0;
+        request.status = ComputeStatus::kOk;
+
+        CombinedVal* entry = lookup(request.key);
+
+        switch (request.op)
+        {
+        case ComputeOp::kGets:
+        case ComputeOp::kGetAndTouch:
+            if (entry == nullptr)
+            {
+                request.status = ComputeStatus::kNotFound;
+                return;
+            }
+            if (request.op == ComputeOp::kGetAndTouch)
+                set_ttl(request.key, request.ttl_ms);
+            request.result = entry->val;
+            break;
+
+        case ComputeOp::kIncr:
+        case ComputeOp::kDecr:
+        {
+            int64_t num = 0;
+            if (entry != nullptr && !parse_int64(entry->val, num))
+            {
+                request.status = ComputeStatus::kNotNumber;
+                request.result = entry->val;
+                break;
+            }
+
+            const bool overflow = request.op == ComputeOp::kIncr ? __builtin_add_overflow(num, request.delta, &num)
+                                                                  : __builtin_sub_overflow(num, request.delta, &num);
+            if (overflow)
+            {
+                request.status = ComputeStatus::kOverflow;
+                request.result = entry == nullptr ? std::string("0") : entry->val;
+                break;
+            }
+
+            entry = &write_entry(request.key, entry, std::to_string(num));
+            request.result = entry->val;
+            break;
+        }
+
+        case ComputeOp::kCas:
+            if (entry == nullptr ? request.expected_version != 0 : request.expected_version != entry->version)
+            {
+                request.status = entry == nullptr ? ComputeStatus::kNotFound : ComputeStatus::kVersionMismatch;
+                if (entry != nullptr)
+                    request.result = entry->val;
+                break;
+            }
+
+            entry = &write_entry(request.key, entry, std::string(request.operand));
+            break;
+
+        case ComputeOp::kAppend:
+            if (entry == nullptr)
+            {
+                request.status = ComputeStatus::kNotFound;
+                return;
+            }
+
+            invalidate_near(request.key);
+            entry->val += request.operand;
+            written(request.key, *entry);
+            break;
+        }
+
+        if (entry != nullptr)
+            request.version = entry->version;
+    }
+
+private:
+    // find_val() of the entry, nullptr if not found or expired
+    CombinedVal* lookup(const std::string& key)
+    {
+        const uint64_t hash = std::hash<std::string>()(key);
+
+        ++lookup_cnt_;
+        heavy_hitters_.add(key, hash);
+        if (mrc_ != nullptr)
+            mrc_->add(key, hash);
+
+        if (bloom_ != nullptr && !bloom_->may_contain(hash))
+        {
+            ++miss_cnt_;
+            ++bloom_negative_cnt_;
+
+            return nullptr;
+        }
+
+        const HeapKey stack_key(&key);      // construct a stack-memory(pseduo) HeapKey
+
+        const auto it = key_vals_.find(stack_key);  // hash find
+
+        if (it == key_vals_.end())
+        {
+            ++miss_cnt_;
+            if (bloom_ != nullptr)
+                ++bloom_false_positive_cnt_;
+
+            return nullptr;
+        }
+        else if (it->second.expire_ms != 0 && it->second.expire_ms <= now_ms())
+        {
+            // expired, the wheel will remove it, but the near caches must not keep answering it until then
+            invalidate_near(key);
+            ++miss_cnt_;
+            ++lazy_expired_cnt_;
+
+            return nullptr;
+        }
+        else
+        {
+            ++hit_cnt_;
+
+            policy_.on_hit(it->second.policy_link);
+            ages_.on_hit(&it->first.real_key(), hash, lookup_cnt_, policy_.telemetry());
+
+            return &it->second;
+        }
+    }
+
+    // insert() of the entry, the version of a replaced value is bumped.
+    // An expired key (not removed yet) gets the new value without TTL
+    CombinedVal& insert_entry(const std::string& key, std::string&& val)
+    {
+        const HeapKey stack_key(&key);
+        const auto it = key_vals_.find(stack_key);
+        if (it != key_vals_.end())
+        {
+            invalidate_near(key);
+            ++released_val_cnt_;
+            it->second.val = std::move(val);
+            it->second.bump_version();
+            if (it->second.expire_ms != 0 && it->second.expire_ms <= now_ms())
+                it->second.expire_ms = 0;
+            return it->second;
+        }
+
+        const uint64_t hash = std::hash<std::string>()(key);
+        while (key_vals_.size() >= capacity_ && evict_one(hash))
+            ;
+
+        auto [it_map, inserted] = 
+            key_vals_.insert({HeapKey(std::make_unique<std::string>(key)), CombinedVal(std::move(val))});
+        assert(inserted);
+
+        it_map->second.policy_link = policy_.on_insert(&it_map->first.real_key(), hash);
+        ages_.on_insert(&it_map->first.real_key(), hash, lookup_cnt_);
+        if (bloom_ != nullptr)
+            bloom_->insert(hash);
+
+        return it_map->second;
+    }
+
+    // Write val to the entry of key (nullptr if absent or expired) for a compute request, return the entry
+    CombinedVal& write_entry(const std::string& key, CombinedVal* entry, std::string&& val)
+    {
+        if (entry == nullptr)
+        {
+            // insert_entry() bumps the version of an expired one
+            entry = &insert_entry(key, std::move(val));
+            if (write_behind_ != nullptr)
+                write_behind_->put(key, entry->val);
+            return *entry;
+        }
+
+        invalidate_near(key);
+        entry->val = std::move(val);
+        written(key, *entry);
+        return *entry;
+    }
+
+    // the value of entry is changed in place
+    void written(const std::string& key, CombinedVal& entry)
+    {
+        ++released_val_cnt_;
+        entry.bump_version();
+        if (write_behind_ != nullptr)
+            write_behind_->put(key, entry.val);
+    }
+
+    // the whole of str is a decimal int64
+    static bool parse_int64(const std::string& str, int64_t& num)
+    {
+        if (str.empty())
+            return false;
+
+        char* end = nullptr;
+        errno = 0;
+        num = std::strtoll(str.c_str(), &end, 10);
+        return errno == 0 && end == str.c_str() + str.size();
+    }
+
+public:
+
+    // The puts are written behind to the sink of write_behind (see write_behind.h), nullptr for none.
+    // The caller flushes the old one if needed
+    void set_write_behind(WriteBehind* write_behind)
+    {
+        write_behind_ = write_behind;
+    }
+
+    WriteBehind* write_behind() const
+    {
+        return write_behind_;
+    }
+
+    // Dump the hottest keys (no more than max_num from the warm end of the protected segment) to path
+    // for a warm restart (see hot_set.h). Return the number of dumped keys, 0 if failed. SLRU only
+    size_t dump_hot(const char* path, const size_t max_num = kHotSetMaxKeyNum) const
+    {
+        std::vector<const std::string*> keys;
+        keys.reserve(std::min(max_num, key_vals_.size()));
+        policy_.walk_hot(max_num, [&keys](const std::string* key)
+        {
+            keys.push_back(key);
+        });
+
+        return write_hot_set(path, keys) ? keys.size() : 0;
+    }
+
+    // Rebuild the protected segment by the hot set of path before the lookups start: the keys are moved
+    // to the warm end of protected from the coldest one, so protected is in the recency order of the dump.
+    // A key not in the cache is loaded by load(key, val) (false if the backend has not it) and inserted.
+    // Return the number of the preloaded keys. SLRU only
+    template <typename F>
+    size_t warm_up(const char* path, F&& load)
+    {
+        std::vector<std::string> keys;
+        if (!read_hot_set(path, keys))
+            return 0;
+
+        size_t warmed = 0;
+        std::string val;
+        for (auto key = keys.rbegin(); key != keys.rend(); ++key)
+        {
+            const HeapKey stack_key(&*key);
+            auto it = key_vals_.find(stack_key);
+            if (it == key_vals_.end())
+            {
+                if (!load(*key, val))
+                    continue;
+
+                insert(*key, std::move(val));
+                it = key_vals_.find(stack_key);
+            }
+
+            policy_.preload(it->second.policy_link);
+            ++warmed;
+        }
+
+        return warmed;
+    }
+
+    // only the keys in the cache are warmed
+    size_t warm_up(const char* path)
+    {
+        return warm_up(path, [](const std::string&, std::string&) { return false; });
+    }
+
+    // The most keys, the victims of the policy are evicted at once if more.
+    // kUnlimitedCapacity (the default) for no eviction
+    void set_capacity(const size_t capacity)
+    {
+        capacity_ = capacity;
+        policy_.set_capacity(capacity == kUnlimitedCapacity ? key_vals_.size() : capacity);
+
+        while (key_vals_.size() > capacity_ && evict_one(0))
+            ;
+    }
+
+    std::tuple<size_t, size_t> hit_miss() const
+    {
+        return {hit_cnt_, miss_cnt_};
+    }
+
+    void reset_hit_miss()
+    {
+        hit_cnt_ = 0;
+        miss_cnt_ = 0;
+    }
+
+    // The telemetry of the policy (see policy_telemetry.h) is written to telemetry from now on
+    // (e.g., in LiveStats), nullptr for the one in the policy
+    void set_telemetry(PolicyTelemetry* telemetry)
+    {
+        policy_.set_telemetry(telemetry);
+    }
+
+    const PolicyTelemetry& telemetry() const
+    {
+        return policy_.telemetry();
+    }
+
+    HeavyHitters& heavy_hitters()
+    {
+        return heavy_hitters_;
+    }
+
+    // Build the Bloom filter of all keys (or drop it), not thread safe with find_val().
+    // A new key must be inserted to the filter, and the filter must be rebuilt after many keys are removed
+    void set_bloom(const bool enable)
+    {
+        bloom_.reset();
+        bloom_negative_cnt_ = 0;
+        bloom_false_positive_cnt_ = 0;
+
+        if (!enable)
+            return;
+
+        bloom_ = std::make_unique<BlockedBloomFilter>(key_vals_.size());
+        for (const auto& [key, val] : key_vals_)
+            bloom_->insert(std::hash<std::string>()(key.real_key()));
+    }
+
+    // the false positive rate of the Bloom filter in percent, i.e., how many lookups of absent keys passed it
+    double bloom_false_positive_percent() const
+    {
+        const size_t negative = bloom_negative_cnt_ + bloom_false_positive_cnt_;
+
+        return negative == 0 ? 0 : static_cast<double>(bloom_false_positive_cnt_) * 100 / static_cast<double>(negative);
+    }
+
+    // Estimate the miss ratio curve up to max_size keys and the SLRU splits of split_size keys from now on
+    // (see shards_mrc.h), or stop it if max_size is 0. Not thread safe with find_val()
+    void set_mrc(const size_t max_size, const size_t split_size)
+    {
+        mrc_.reset();
+        if (max_size != 0)
+            mrc_ = std::make_unique<ShardsMrc>(max_size, split_size);
+    }
+
+    const ShardsMrc* mrc() const
+    {
+        return mrc_.get();
+    }
+
+    // Called before the consumer thread starts, nullptr for no near cache
+    void set_versions(VersionStripes* versions)
+    {
+        versions_ = versions;
+    }
+
+    // The ms since the construction (from 1, so 0 is no TTL), of a coarse clock (a few ms) which is cheap for each lookup
+    uint32_t now_ms() const
+    {
+        return static_cast<uint32_t>(coarse_clock_ms() - epoch_ms_ + 1);
+    }
+
+    // Set the TTL of key from now, 0 for no TTL. Return false if key is not found
+    bool set_ttl(const std::string& key, const uint32_t ttl_ms)
+    {
+        const HeapKey stack_key(&key);
+        const auto it = key_vals_.find(stack_key);
+        if (it == key_vals_.end())
+            return false;
+
+        set_ttl(it, ttl_ms);
+        return true;
+    }
+
+    // Set the TTL of each key by ttl_of(key) (0 for no TTL), e.g., for the mixed TTLs of a benchmark
+    template <typename F>
+    void set_ttl_all(F&& ttl_of)
+    {
+        for (auto it = key_vals_.begin(); it != key_vals_.end(); ++it)
+            set_ttl(it, ttl_of(it->first.real_key()));
+    }
+
+    // Called by the consumer thread when it is idle, advance the timer wheel by no more than budget steps
+    // and remove the expired keys. Return the number of removed keys
+    size_t expire_step(const size_t budget)
+    {
+        if (wheel_.empty())
+            return 0;
+
+        size_t removed = 0;
+        wheel_.advance(now_ms(), budget, [this, &removed](const std::string* key, const uint32_t expire_ms)
+        {
+            // the entry is evicted
+            if (orphan_keys_.erase(key) != 0)
+                return;
+
+            const HeapKey stack_key(key);
+            const auto it = key_vals_.find(stack_key);
+            assert(it != key_vals_.end() && it->second.in_wheel);
+
+            CombinedVal& entry = it->second;
+            entry.in_wheel = false;
+            if (entry.expire_ms == 0)
+            {
+                // the TTL is cleared
+            }
+            else if (entry.expire_ms > expire_ms)
+            {
+                // the TTL is extended after the timer
+                wheel_.insert(key, entry.expire_ms);
+                entry.in_wheel = true;
+            }
+            else
+            {
+                policy_.on_erase(entry.policy_link);
+                erase(it, false);
+                ++removed;
+            }
+        });
+
+        expired_cnt_ += removed;
+        return removed;
+    }
+
+    size_t key_num() const
+    {
+        return key_vals_.size();
+    }
+
+    size_t evicted_num() const
+    {
+        return evicted_cnt_;
+    }
+
+    // the values freed or changed so far, the value pointers of the results are safe to read
+    // only if it does not change while they are read
+    size_t released_val_num() const
+    {
+        return released_val_cnt_;
+    }
+
+    // the keys removed by the timer wheel, and the lookups of the expired keys before they are removed
+    std::tuple<size_t, size_t> expired_lazy_expired() const
+    {
+        return {expired_cnt_, lazy_expired_cnt_};
+    }
+
+private:
+    static uint64_t coarse_clock_ms()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+    }
+
+    // A key has no more than one timer. An earlier TTL is done when its timer is due,
+    // and a later one (or no TTL) makes the timer inserted again (or dropped) then, so the wheel is not searched
+    void set_ttl(const typename Map::iterator it, const uint32_t ttl_ms)
+    {
+        CombinedVal& entry = it->second;
+        if (ttl_ms == 0)
+        {
+            entry.expire_ms = 0;
+            return;
+        }
+
+        // a near cache answer is not checked for TTL, so drop it if the key expires earlier than before
+        const uint32_t expire_ms = now_ms() + ttl_ms;
+        if (entry.expire_ms == 0 || expire_ms < entry.expire_ms)
+            invalidate_near(it->first.real_key());
+
+        entry.expire_ms = expire_ms;
+        if (!entry.in_wheel)
+        {
+            wheel_.insert(&it->first.real_key(), entry.expire_ms);
+            entry.in_wheel = true;
+        }
+    }
+
+    // Remove a key and its value from the map, it is removed from the policy already.
+    // The Bloom filter keeps the bits of key (no delete), it only costs a false positive of its lookup.
+    // If the key has a timer, the key lives as an orphan until the timer is due, so the wheel is not searched
+    void erase(const typename Map::iterator it, const bool evicted)
+    {
+        invalidate_near(it->first.real_key());
+        ++released_val_cnt_;
+        ages_.on_remove(&it->first.real_key(), lookup_cnt_, evicted ? &policy_.telemetry() : nullptr);
+
+        if (!it->second.in_wheel)
+        {
+            key_vals_.erase(it);
+            return;
+        }
+
+        auto node = key_vals_.extract(it);
+        std::unique_ptr<const std::string> key = node.key().take_key();
+        const std::string* key_ptr = key.get();
+        orphan_keys_.emplace(key_ptr, std::move(key));
+    }
+
+    // Evict the victim of the policy for the key of incoming_hash, return false if no key to evict
+    bool evict_one(const uint64_t incoming_hash)
+    {
+        const std::string* key = policy_.victim(incoming_hash);
+        if (key == nullptr)
+            return false;
+
+        const HeapKey stack_key(key);
+        const auto it = key_vals_.find(stack_key);
+        assert(it != key_vals_.end());
+        erase(it, true);
+        ++evicted_cnt_;
+
+        return true;
+    }
+
+    // Called before the value of key is changed or freed, so the answers in the near caches are invalid
+    void invalidate_near(const std::string& key)
+    {
+        if (versions_ != nullptr)
+            versions_->bump(key);
+    }
+};
+
+using SingleData = CacheData<SlruPolicy>;
+
+}   // namespace cmp_mem_engine
@@ -3,14 +3,32 @@
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+#include <cstdio>
 
 #include "const_and_share_struct.h"
+#include "cache_data.h"
 #include "single_thread.h"
 #include "multi_threads.h"
 #include "producer_consumer.h"
+#include "async_producer.h"
 #include "pc_signal.h"
 #include "pc_pure.h"
 #include "pc_lockless.h"
+#include "pc_ring.h"
+#include "pc_sharded.h"
+#include "policy_slru.h"
+#include "policy_s3fifo.h"
+#include "policy_arc.h"
+#include "policy_lirs.h"
+#include "live_stats.h"
+#include "write_behind.h"
+
+// The stats of the running producers and consumer are published here, watch them by stats_top
+cmp_mem_engine::LiveStats g_live_stats;
 
 std::string size_to_str(std::size_t num)
 {
@@ -74,6 +92,387 @@ void benchmark_single()
               << ", miss percentage = " << s.miss_percent() << "%\n";
 }
 
+// The number of lookups for each case of benchmark_miss_path()
+constexpr size_t kMissPathLookupNum = 1<<22;
+// The number of random keys to find the absent ones
+constexpr size_t kMissPathRandomKeyNum = 1<<16;
+
+// ns per lookup of keys in data, keys are looked up round robin
+double lookup_ns(cmp_mem_engine::SingleData& data, const std::vector<std::string>& keys)
+{
+    size_t found = 0;
+
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i != kMissPathLookupNum; ++i)
+    {
+        found += data.find_val(keys[i % keys.size()]) != nullptr;
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    // so the loop is not optimized out
+    if (found > kMissPathLookupNum)
+        std::cout << found;
+
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) 
+           / kMissPathLookupNum;
+}
+
+// The cost of the miss path (absent random keys, like the 10% random keys of producers) and the hit path (hot keys)
+// of one SingleData, without and with the Bloom filter
+void benchmark_miss_path()
+{
+    std::cout << "benchmark miss path, init starting ...\n";
+    std::vector<std::string> samples;
+    cmp_mem_engine::SingleData data(cmp_mem_engine::kKeySpace, cmp_mem_engine::kSampleSpace, samples);
+
+    // a short random key maybe exists, keep the absent ones only
+    cmp_mem_engine::RandomEngine re(kMissPathRandomKeyNum);
+    std::vector<std::string> absent_keys;
+    for (size_t i = 0; i != kMissPathRandomKeyNum; ++i)
+    {
+        std::string key = cmp_mem_engine::rand_str_scope(re, cmp_mem_engine::kKeyMinLen, cmp_mem_engine::kKeyMaxLen);
+        if (data.find_val(key) == nullptr)
+            absent_keys.push_back(std::move(key));
+    }
+    std::cout << "miss path init finish\n";
+
+    const double miss_ns = lookup_ns(data, absent_keys);
+    const double hit_ns = lookup_ns(data, samples);
+
+    data.set_bloom(true);
+    const double bloom_miss_ns = lookup_ns(data, absent_keys);
+    const double bloom_hit_ns = lookup_ns(data, samples);
+    const double false_positive = data.bloom_false_positive_percent();
+    data.set_bloom(false);
+
+    std::cout << "miss path (ns per lookup) = " << miss_ns << ", with bloom filter = " << bloom_miss_ns << '\n'
+              << "hit path (ns per lookup) = " << hit_ns << ", with bloom filter = " << bloom_hit_ns << '\n'
+              << "bloom filter false positive = " << false_positive << "%"
+              << ", bits per key = " << cmp_mem_engine::kBloomBitsPerKey << '\n';
+}
+
+// The key universe of benchmark_policies(), the cache holds kPolicyCapacityPercent of it
+constexpr size_t kPolicyUniverse = 1<<20;
+constexpr size_t kPolicyCapacityPercent = 10;
+constexpr size_t kPolicyTraceLen = 1<<23;
+// the first part of a trace warms the cache up, not counted
+constexpr size_t kPolicyWarmupLen = kPolicyTraceLen / 8;
+constexpr double kPolicyZipfAlpha = 0.9;
+// the scan workload: every kPolicyScanPeriod lookups, kPolicyScanLen keys never seen before
+constexpr size_t kPolicyScanPeriod = 1<<16;
+constexpr size_t kPolicyScanLen = 1<<13;
+
+// The trace of the key indexes of Zipf(kPolicyZipfAlpha) over kPolicyUniverse keys (and the scans if with_scan).
+// The scan keys are from kPolicyUniverse on, so keys must have them
+std::vector<uint32_t> make_policy_trace(const bool with_scan)
+{
+    std::vector<double> cdf(kPolicyUniverse);
+    double sum = 0;
+    for (size_t r = 0; r != kPolicyUniverse; ++r)
+    {
+        sum += 1.0 / std::pow(static_cast<double>(r + 1), kPolicyZipfAlpha);
+        cdf[r] = sum;
+    }
+
+    constexpr size_t kUniformScale = size_t(1) << 30;
+    cmp_mem_engine::RandomEngine re(kPolicyTraceLen);
+    std::vector<uint32_t> trace;
+    trace.reserve(kPolicyTraceLen);
+    size_t scan_key = kPolicyUniverse;
+    for (size_t i = 0; i != kPolicyTraceLen; ++i)
+    {
+        if (with_scan && i % kPolicyScanPeriod < kPolicyScanLen)
+        {
+            trace.push_back(static_cast<uint32_t>(scan_key++));
+            continue;
+        }
+
+        const double u = static_cast<double>(re.rand_size_scope(0, kUniformScale)) / kUniformScale * sum;
+        const size_t rank = static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        // the ranks are scattered over the keys, so a hot key is not always a short one
+        trace.push_back(static_cast<uint32_t>(std::min(rank, kPolicyUniverse - 1) * 7919 % kPolicyUniverse));
+    }
+
+    return trace;
+}
+
+// A read-through cache of Policy over trace: a miss inserts the key, the victims are evicted by the policy
+template <typename Policy>
+void run_policy(const char* workload, const std::vector<std::string>& keys, const std::vector<uint32_t>& trace)
+{
+    std::vector<std::string> no_samples;
+    cmp_mem_engine::CacheData<Policy> data(0, 0, no_samples);
+    data.set_capacity(kPolicyUniverse * kPolicyCapacityPercent / 100);
+
+    const std::string val(cmp_mem_engine::kValMinLen, 'v');
+    auto lookup = [&data, &val](const std::string& key)
+    {
+        if (data.find_val(key) == nullptr)
+            data.insert(key, std::string(val));
+    };
+
+    for (size_t i = 0; i != kPolicyWarmupLen; ++i)
+        lookup(keys[trace[i]]);
+    data.reset_hit_miss();
+    const cmp_mem_engine::PolicyTelemetry warm = data.telemetry();
+
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = kPolicyWarmupLen; i != trace.size(); ++i)
+        lookup(keys[trace[i]]);
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    auto [hit, miss] = data.hit_miss();
+    const cmp_mem_engine::PolicyTelemetry& t = data.telemetry();
+    uint64_t evict_age[cmp_mem_engine::kAgeBucketNum];
+    for (size_t b = 0; b != cmp_mem_engine::kAgeBucketNum; ++b)
+        evict_age[b] = t.evict_age[b] - warm.evict_age[b];
+    const size_t moves = t.promote_cnt - warm.promote_cnt + t.demote_cnt - warm.demote_cnt;
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    const std::streamsize precision = std::cout.precision();
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count())
+                      / static_cast<double>(trace.size() - kPolicyWarmupLen);
+    std::cout << std::left << std::setw(10) << Policy::kName << std::setw(14) << workload
+              << std::setw(12) << std::fixed << std::setprecision(2) 
+              << static_cast<double>(hit) * 100 / static_cast<double>(std::max<size_t>(hit + miss, 1))
+              << std::setw(10) << std::setprecision(1) << ns
+              << std::setw(10) << std::setprecision(3) << static_cast<double>(moves) / static_cast<double>(hit + miss)
+              << std::setw(16) << cmp_mem_engine::PolicyTelemetry::age_percentile(evict_age, 50)
+              << size_to_str(data.evicted_num()) << '\n';
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+// The hit ratio and ns per lookup (with the insert of a miss) of the eviction policies, 
+// the capacity is kPolicyCapacityPercent of the key universe
+void benchmark_policies()
+{
+    std::cout << "benchmark eviction policies, init starting ...\n";
+    std::vector<std::string> keys;
+    keys.reserve(kPolicyUniverse + kPolicyTraceLen / kPolicyScanPeriod * kPolicyScanLen);
+    for (size_t i = 0; i != keys.capacity(); ++i)
+        keys.push_back("key:" + std::to_string(i));
+
+    const std::vector<uint32_t> zipf = make_policy_trace(false);
+    const std::vector<uint32_t> zipf_scan = make_policy_trace(true);
+    std::cout << "eviction policies init finish, capacity = " 
+              << size_to_str(kPolicyUniverse * kPolicyCapacityPercent / 100) 
+              << " of " << size_to_str(kPolicyUniverse) << " keys\n";
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::left << std::setw(10) << "policy" << std::setw(14) << "workload"
+              << std::setw(12) << "hit%" << std::setw(10) << "ns/op" << std::setw(10) << "moves/op"
+              << std::setw(16) << "evict age p50" << "evicted" << '\n';
+    for (const auto& [workload, trace] : {std::pair{"zipf", &zipf}, std::pair{"zipf+scan", &zipf_scan}})
+    {
+        run_policy<cmp_mem_engine::SlruPolicy>(workload, keys, *trace);
+        run_policy<cmp_mem_engine::S3FifoPolicy>(workload, keys, *trace);
+        run_policy<cmp_mem_engine::ArcPolicy>(workload, keys, *trace);
+        run_policy<cmp_mem_engine::LirsPolicy>(workload, keys, *trace);
+    }
+    std::cout.flags(flags);
+}
+
+// The flush intervals and the dirty caps of benchmark_write_behind()
+constexpr long kWriteBehindIntervalMs[] = {10, 100, 1000};
+constexpr size_t kWriteBehindCaps[] = {1<<20, 16<<20};
+constexpr size_t kWriteBehindPutNum = 1<<21;
+// the puts of the write-through baseline, one sink write for each
+constexpr size_t kWriteThroughPutNum = 1<<16;
+constexpr size_t kWriteValLen = 100;
+const char* kWriteBehindPath = "cmp_write_behind.dat";
+
+// The puts of the zipf trace of benchmark_policies() to a cache written behind to a file, 
+// and the write-through baseline which writes the file for each put
+void benchmark_write_behind()
+{
+    std::cout << "benchmark write-behind, init starting ...\n";
+    std::vector<std::string> keys;
+    keys.reserve(kPolicyUniverse);
+    for (size_t i = 0; i != keys.capacity(); ++i)
+        keys.push_back("key:" + std::to_string(i));
+    const std::vector<uint32_t> trace = make_policy_trace(false);
+    const std::string val(kWriteValLen, 'v');
+    std::cout << "write-behind init finish\n";
+
+    {
+        // the puts without a backing store
+        std::vector<std::string> no_samples;
+        cmp_mem_engine::SingleData data(0, 0, no_samples);
+        const auto begin = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i != kWriteBehindPutNum; ++i)
+            data.put(keys[trace[i]], std::string(val));
+        const auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "cache only ns/put = " 
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / kWriteBehindPutNum << '\n';
+    }
+
+    {
+        cmp_mem_engine::FileSink sink(kWriteBehindPath);
+        if (!sink.is_open())
+            return;
+
+        std::vector<cmp_mem_engine::WriteRecord> one(1);
+        const auto begin = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i != kWriteThroughPutNum; ++i)
+        {
+            one[0] = cmp_mem_engine::WriteRecord{keys[trace[i]], val};
+            sink.write(one);
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "write-through ns/put = " 
+                  << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / kWriteThroughPutNum 
+                  << ", sink writes = " << size_to_str(kWriteThroughPutNum) << '\n';
+    }
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    const std::streamsize precision = std::cout.precision();
+    std::cout << std::left << std::setw(14) << "interval ms" << std::setw(12) << "dirty cap" << std::setw(10) << "ns/put"
+              << std::setw(12) << "records" << std::setw(10) << "batches" << std::setw(12) << "KB/batch"
+              << std::setw(10) << "write amp" << std::setw(10) << "MB/s" << "stalls" << '\n';
+
+    for (const long interval_ms : kWriteBehindIntervalMs)
+    {
+        for (const size_t cap : kWriteBehindCaps)
+        {
+            std::vector<std::string> no_samples;
+            cmp_mem_engine::SingleData data(0, 0, no_samples);
+            cmp_mem_engine::FileSink sink(kWriteBehindPath);
+            cmp_mem_engine::WriteBehind write_behind(sink, {std::chrono::milliseconds(interval_ms), cap});
+            data.set_write_behind(&write_behind);
+
+            const auto begin = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i != kWriteBehindPutNum; ++i)
+                data.put(keys[trace[i]], std::string(val));
+            const auto end = std::chrono::high_resolution_clock::now();
+
+            write_behind.sync();
+            data.set_write_behind(nullptr);
+
+            const cmp_mem_engine::WriteBehindStats stats = write_behind.stats();
+            std::cout << std::setw(14) << interval_ms << std::setw(12) << size_to_str(cap)
+                      << std::setw(10) << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() 
+                                          / kWriteBehindPutNum
+                      << std::setw(12) << size_to_str(stats.record_cnt) << std::setw(10) << stats.batch_cnt
+                      << std::setw(12) << stats.flush_bytes / std::max<size_t>(stats.batch_cnt, 1) / 1024
+                      << std::setw(10) << std::fixed << std::setprecision(3) << stats.write_amplification()
+                      << std::setw(10) << std::setprecision(1) << stats.flush_mb_per_sec()
+                      << stats.stall_cnt << '\n';
+        }
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+
+    std::remove(kWriteBehindPath);
+}
+
+// The lookups of one window of the hit ratio after a restart in benchmark_warm_restart(),
+// and the hit ratio is steady if it is no more than kRestartSteadyGap points below the one before the restart
+constexpr size_t kRestartWindowLen = 1<<15;
+constexpr double kRestartSteadyGap = 1.0;
+const char* kHotSetPath = "cmp_hot_set.dat";
+
+// The read-through cache of the zipf trace of benchmark_policies() is restarted: kPolicyCapacityPercent of the keys
+// are loaded in key order, so protected is of the insertion order, then it is rebuilt by the hot set dumped
+// before the restart or not. The time to the steady hit ratio includes the load and the warmup
+void benchmark_warm_restart()
+{
+    std::cout << "benchmark warm restart, init starting ...\n";
+    std::vector<std::string> keys;
+    keys.reserve(kPolicyUniverse);
+    for (size_t i = 0; i != keys.capacity(); ++i)
+        keys.push_back("key:" + std::to_string(i));
+    const std::vector<uint32_t> trace = make_policy_trace(false);
+    const size_t capacity = kPolicyUniverse * kPolicyCapacityPercent / 100;
+    const size_t restart_at = trace.size() / 2;
+
+    cmp_mem_engine::LatencyBackend backend(std::chrono::microseconds(0), 0, cmp_mem_engine::kValMinLen);
+    auto load = [&backend](const std::string& key, std::string& val)
+    {
+        return backend.load(key, val);
+    };
+    std::cout << "warm restart init finish\n";
+
+    std::vector<std::string> no_samples;
+    auto lookup = [&load](cmp_mem_engine::SingleData& data, const std::string& key)
+    {
+        std::string val;
+        if (data.find_val(key) == nullptr && load(key, val))
+            data.insert(key, std::move(val));
+    };
+    auto hit_percent = [](cmp_mem_engine::SingleData& data)
+    {
+        auto [hit, miss] = data.hit_miss();
+        return static_cast<double>(hit) * 100 / static_cast<double>(std::max<size_t>(hit + miss, 1));
+    };
+
+    // before the restart, the steady hit ratio is of the last quarter
+    double steady = 0;
+    {
+        cmp_mem_engine::SingleData data(0, 0, no_samples);
+        data.set_capacity(capacity);
+        for (size_t i = 0; i != restart_at * 3 / 4; ++i)
+            lookup(data, keys[trace[i]]);
+        data.reset_hit_miss();
+        for (size_t i = restart_at * 3 / 4; i != restart_at; ++i)
+            lookup(data, keys[trace[i]]);
+        steady = hit_percent(data);
+
+        const size_t dumped = data.dump_hot(kHotSetPath);
+        std::cout << "before restart: hit percent = " << steady << "%, hot set = " << size_to_str(dumped) << " keys\n";
+    }
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    const std::streamsize precision = std::cout.precision();
+    std::cout << std::left << std::setw(10) << "warmup" << std::setw(12) << "preloaded" << std::setw(12) << "restart ms"
+              << std::setw(14) << "first hit%" << std::setw(18) << "lookups to steady" << "ms to steady" << '\n';
+
+    for (const bool warm : {false, true})
+    {
+        cmp_mem_engine::SingleData data(0, 0, no_samples);
+        data.set_capacity(capacity);
+
+        const auto begin = std::chrono::high_resolution_clock::now();
+        std::string val;
+        for (size_t i = 0; i != capacity; ++i)
+        {
+            if (load(keys[i], val))
+                data.insert(keys[i], std::move(val));
+        }
+        const size_t preloaded = warm ? data.warm_up(kHotSetPath, load) : 0;
+        const auto ready = std::chrono::high_resolution_clock::now();
+
+        double first = -1;
+        size_t steady_lookups = 0;
+        for (size_t from = restart_at; from + kRestartWindowLen <= trace.size(); from += kRestartWindowLen)
+        {
+            data.reset_hit_miss();
+            for (size_t i = from; i != from + kRestartWindowLen; ++i)
+                lookup(data, keys[trace[i]]);
+
+            const double hit = hit_percent(data);
+            if (first < 0)
+                first = hit;
+            if (hit >= steady - kRestartSteadyGap)
+            {
+                steady_lookups = from + kRestartWindowLen - restart_at;
+                break;
+            }
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << std::setw(10) << (warm ? "yes" : "no") << std::setw(12) << size_to_str(preloaded)
+                  << std::setw(12) << std::chrono::duration_cast<std::chrono::milliseconds>(ready - begin).count()
+                  << std::setw(14) << std::fixed << std::setprecision(2) << first
+                  << std::setw(18) << (steady_lookups == 0 ? std::string("never") : size_to_str(steady_lookups))
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << '\n';
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+
+    std::remove(kHotSetPath);
+}
+
 void benchmark_multi()
 {
     std::cout << "benchmark multi test starting ...\n";
@@ -138,216 +537,876 @@ void benchmark_multi()
 }
 
 
-void benchmark_producer_consumer_signal()
+struct ProducerConsumerResult
 {
-    using namespace std::chrono_literals;
+    size_t producer_num;
+    size_t total_qps;
+    size_t producer_qps;        // the average of all producers
+    int consumer_util;          // percent of the consumer busy time in the benchmark time (the busiest one)
+    int producer_cpu;           // percent of one core, the average of all producers
+    int consumer_cpu;           // percent of one core, the sum of all consumers
+    cmp_mem_engine::LatencyHistogram latency;       // all producers, only for open loop
+    cmp_mem_engine::LatencyHistogram batch_sizes;   // the requests of each batch, all consumers
+    size_t load_cnt;            // the misses loaded by the loader, all consumers
+    size_t load_join_cnt;       // the misses which joined a load in flight, all consumers
+};
 
-    std::cout << "benchmark producer&consumer by signal, init starting ...\n";
-    std::vector<std::string> samples;
-    cmp_mem_engine::SingleData cache(cmp_mem_engine::kKeySpace, cmp_mem_engine::kSampleSpace, samples);
-    cmp_mem_engine::Tasks tasks;
-    std::cout << "producer&consumer init finish\n";
+// One SingleData for each consumer of Transport, which is a shard of the key space if more than one.
+// The samples are from the whole key space
+using Caches = std::vector<std::unique_ptr<cmp_mem_engine::SingleData>>;
+
+// The most frequent keys of each cache with their shares of the lookups,
+// the keys are long random strings so only the heads of them are printed
+void print_top_keys(Caches& caches)
+{
+    constexpr size_t kKeyHeadLen = 12;
 
-    // std::array<std::atomic<bool>, cmp_mem_engine::kFixProducerNumber> task_flags;
-    cmp_mem_engine::TaskFlags task_flags;
-    for (size_t i = 0; i != cmp_mem_engine::kFixProducerNumber; ++i)
+    for (size_t k = 0; k != caches.size(); ++k)
     {
-        // task_flags[i].store(false, std::memory_order_relaxed);
-        task_flags.flags[i].atomic_bool.store(false, std::memory_order_relaxed);
+        const cmp_mem_engine::HeavyHitters& hh = caches[k]->heavy_hitters();
+        cmp_mem_engine::HeavyHitter top[cmp_mem_engine::kHeavyHitterTopNum];
+        const size_t num = hh.top(top, cmp_mem_engine::kHeavyHitterTopNum);
+        const double total = static_cast<double>(std::max<uint64_t>(hh.total(), 1));
+
+        std::cout << "consumer " << (caches.size() == 1 ? "" : std::to_string(k) + " ")
+                  << "top keys of " << size_to_str(hh.total()) << " lookups:";
+        for (size_t i = 0; i != num; ++i)
+        {
+            std::cout << ' ' << top[i].head(kKeyHeadLen)
+                      << '(' << top[i].count << "±" << top[i].error 
+                      << ", " << static_cast<double>(top[i].count) * 100 / total << "%)";
+        }
+        std::cout << '\n';
     }
+}
+
+template <typename Transport>
+Caches make_caches(std::vector<std::string>& samples)
+{
+    constexpr size_t kConsumerNum = cmp_mem_engine::ConsumerSide<Transport>::kNum;
+
+    Caches caches;
+    for (size_t k = 0; k != kConsumerNum; ++k)
+    {
+        std::vector<std::string> shard_samples;
+        caches.push_back(std::make_unique<cmp_mem_engine::SingleData>(cmp_mem_engine::kKeySpace, cmp_mem_engine::kSampleSpace, 
+                                                                      k == 0 ? samples : shard_samples, k, kConsumerNum));
+    }
+
+    return caches;
+}
+
+// Run the consumer threads (one for each of caches) and producer_num producer threads 
+// (each looks up bench_num keys) with the transport of Transport and the wait strategies of ProducerWait and ConsumerWait.
+// If open_loop is not nullptr, the producers run in open loop by the config instead of bench_num.
+// If batching is not nullptr, the consumers grow their batches by the config (see adaptive_batch.h).
+// If near_cache, each producer (not AsyncProducer) has a near cache of the answers (see near_cache.h).
+// If loader is not nullptr, the consumers load their misses by it (see read_through.h).
+// ProducerTemplate is Producer (one transaction at a time) or AsyncProducer (many transactions by coroutines)
+template <typename Transport, typename ProducerWait, typename ConsumerWait,
+          template <typename, typename> class ProducerTemplate = cmp_mem_engine::Producer>
+ProducerConsumerResult run_producer_consumer(Caches& caches, const std::vector<std::string>& samples,
+                                             const size_t producer_num, const size_t bench_num, const bool verbose,
+                                             const cmp_mem_engine::OpenLoopConfig* open_loop = nullptr,
+                                             const cmp_mem_engine::BatchingConfig* batching = nullptr,
+                                             const bool near_cache = false,
+                                             cmp_mem_engine::Loader* loader = nullptr)
+{
+    using ConsumerSide = cmp_mem_engine::ConsumerSide<Transport>;
+    using ProducerType = ProducerTemplate<Transport, ProducerWait>;
+    using ConsumerType = cmp_mem_engine::Consumer<typename ConsumerSide::Transport, ConsumerWait>;
+
+    assert(caches.size() == ConsumerSide::kNum);
 
-    // First, start only one consumer thread
-    cmp_mem_engine::ConsumerSignal consumer(cache, tasks, task_flags);
-    consumer.start_thread_loop();
+    typename Transport::Channel channel(producer_num);
 
-    // then start kRunProducerNum producer threads
-    constexpr size_t kProducerThreadNum = cmp_mem_engine::kRunProducerNum;
-    std::vector<std::unique_ptr<cmp_mem_engine::ProducerSignal>> ps;
-    ps.reserve(kProducerThreadNum);
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+    cmp_mem_engine::VersionStripes versions;
+    if (near_cache)
     {
-        auto one = std::make_unique<cmp_mem_engine::ProducerSignal>(i+1, tasks, samples, task_flags);
+        for (auto& cache : caches)
+            cache->set_versions(&versions);
+    }
+
+    // the heavy hitters are of this run only
+    for (auto& cache : caches)
+        cache->heavy_hitters().clear();
+
+    // First, start the consumer threads
+    g_live_stats.reset();
+
+    std::vector<std::unique_ptr<ConsumerType>> cs;
+    cs.reserve(ConsumerSide::kNum);
+    for (size_t k = 0; k != ConsumerSide::kNum; ++k)
+    {
+        auto one = std::make_unique<ConsumerType>(*caches[k], ConsumerSide::channel(channel, k));
+        if (batching != nullptr)
+            one->set_batching(*batching);
+        if constexpr (requires { one->set_loader(*loader); })
+        {
+            if (loader != nullptr)
+                one->set_loader(*loader);
+        }
+        one->publish_stats(g_live_stats, k);
+        one->start_thread_loop();
+        cs.push_back(std::move(one));
+    }
+
+    // then start producer_num producer threads
+    std::vector<std::unique_ptr<ProducerType>> ps;
+    ps.reserve(producer_num);
+    for (size_t i = 0; i != producer_num; ++i)
+    {
+        auto one = std::make_unique<ProducerType>(i+1, channel, samples, bench_num);
+        if (open_loop != nullptr)
+            one->set_open_loop(*open_loop);
+        if constexpr (requires { one->set_near_cache(versions); })
+        {
+            if (near_cache)
+                one->set_near_cache(versions);
+        }
+        one->publish_stats(g_live_stats);
         ps.push_back(std::move(one));
     }
 
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+    for (size_t i = 0; i != producer_num; ++i)
     {
         ps[i]->start_thread();
     }
 
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+    for (size_t i = 0; i != producer_num; ++i)
     {
         ps[i]->wait_until_join();
     }
 
-    // std::cout << "main thread sleep 20s after producer exit.\n";
-    // std::this_thread::sleep_for(1s);
+    // consumer theads exit after the producer threads have exited
+    for (auto& c : cs)
+    {
+        c->set_exit_task();
+        c->wait_until_join();
+    }
 
-    // consumer thead exit after the producer threads have exited
-    consumer.set_exit_task();
-    consumer.wait_until_join();
+    for (auto& cache : caches)
+        cache->set_versions(nullptr);
 
     // output the results
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+    auto [min_time, max_time] = ps[0]->get_time_points(); 
+    size_t query_total = 0;
+    size_t producer_qps_total = 0;
+    size_t producer_cpu_total = 0;
+    size_t near_hit_total = 0;
+    size_t near_tx_total = 0;
+    for (size_t i = 0; i != producer_num; ++i)
     {
         auto& p = ps[i];
-        const size_t bench_cnt = p->get_bench_count();
+        const cmp_mem_engine::ProducerStats& stats = p->get_stats();
         auto [p_start, p_end] = p->get_time_points();
+        if (p_start < min_time)
+            min_time = p_start;
+        if (p_end > max_time)
+            max_time = p_end;
+
         const std::chrono::milliseconds duration_p = std::chrono::duration_cast<std::chrono::milliseconds>(p_end - p_start);
-        const size_t p_qps = bench_cnt * 1000 / duration_p.count();
-        auto [batch_fail_try_cnt, batch_fail_try_most] = p->get_batch_fail_try_stats();
+        const size_t p_qps = stats.bench_cnt * 1000 / std::max<long>(duration_p.count(), 1);
+        const size_t p_cpu = stats.cpu_ns * 100 / std::max<size_t>(
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(p_end - p_start).count(), 1);
+        query_total += stats.bench_cnt;
+        producer_qps_total += p_qps;
+        producer_cpu_total += p_cpu;
+        near_hit_total += stats.near_hit_cnt;
+        near_tx_total += stats.near_tx_cnt;
+
+        if (!verbose)
+            continue;
+
         std::cout << "producer id = " << i + 1
-                  << ", bench count = " << size_to_str(bench_cnt)
+                  << ", bench count = " << size_to_str(stats.bench_cnt)
                   << ", qps = " << size_to_str(p_qps)
-                  << ", miss percent = " << p->miss_percent() << "%"
-                  << ", sleep count = " << p->sleep_count() 
-                  << ", batch_fail_try_cnt = " << size_to_str(batch_fail_try_cnt)
-                  << ", batch_fail_try_most = " << size_to_str(batch_fail_try_most)
+                  << ", miss percent = " << stats.miss_percent() << "%"
+                  << ", sleep count = " << stats.sleep_cnt
+                  << ", request_wait_cnt = " << size_to_str(stats.request_wait_cnt)
+                  << ", request_wait_most = " << size_to_str(stats.request_wait_most)
+                  << ", result_wait_cnt = " << size_to_str(stats.result_wait_cnt)
+                  << ", result_wait_most = " << size_to_str(stats.result_wait_most)
+                  << ", cpu percent = " << p_cpu << "%"
+                  << (near_cache ? ", near hit percent = " + std::to_string(stats.near_hit_percent()) + "%" : "")
+                  << '\n';
+    }
+
+    const std::chrono::nanoseconds duration_all = std::chrono::duration_cast<std::chrono::nanoseconds>(max_time - min_time);
+    const size_t duration_ns = std::max<size_t>(duration_all.count(), 1);
+
+    ProducerConsumerResult res;
+    res.producer_num = producer_num;
+    res.total_qps = static_cast<size_t>(static_cast<double>(query_total) * 1'000'000'000 / duration_ns);
+    res.producer_qps = producer_qps_total / producer_num;
+    res.producer_cpu = static_cast<int>(producer_cpu_total / producer_num);
+    res.consumer_util = 0;
+    res.consumer_cpu = 0;
+    res.load_cnt = 0;
+    res.load_join_cnt = 0;
+    for (size_t i = 0; i != producer_num; ++i)
+    {
+        res.latency.merge(ps[i]->get_latency());
+    }
+
+    for (size_t k = 0; k != cs.size(); ++k)
+    {
+        const cmp_mem_engine::ConsumerStats& stats = cs[k]->get_stats();
+        const int util = static_cast<int>(std::min<size_t>(stats.busy_ns, duration_ns) * 100 / duration_ns);
+        const int cpu = static_cast<int>(stats.cpu_ns * 100 / duration_ns);
+        res.consumer_util = std::max(res.consumer_util, util);
+        res.consumer_cpu += cpu;
+        res.batch_sizes.merge(cs[k]->get_batch_sizes());
+        res.load_cnt += stats.load_cnt;
+        res.load_join_cnt += stats.load_join_cnt;
+
+        if (!verbose)
+            continue;
+
+        std::cout << "consumer " << (cs.size() == 1 ? "" : std::to_string(k) + " ")
+                  << "wait count = " << size_to_str(stats.wait_cnt) 
+                  << ", sleep count = " << size_to_str(stats.sleep_cnt) 
+                  << ", bench count = " << size_to_str(stats.bench_cnt)
+                  << ", busy percent = " << util << "%"
+                  << ", cpu percent = " << cpu << "%"
+                  << ", batch p50 = " << cs[k]->get_batch_sizes().percentile(50)
+                  << ", batch p99 = " << cs[k]->get_batch_sizes().percentile(99)
+                  << ", batch wait count = " << size_to_str(stats.batch_wait_cnt)
+                  << ", dedup percent = " << stats.dedup_percent() << "%"
+                  << ", expired count = " << size_to_str(stats.expired_cnt)
+                  << (loader != nullptr ? ", load count = " + size_to_str(stats.load_cnt) 
+                                          + ", load join count = " + size_to_str(stats.load_join_cnt) : "")
+                  << '\n';
+
+        // the policy of the cache counts since the cache is built, so it is of all runs
+        const cmp_mem_engine::PolicyTelemetry& policy = caches[k]->telemetry();
+        const size_t hits = policy.protected_hit_cnt + policy.probation_hit_cnt;
+        std::cout << "consumer " << (cs.size() == 1 ? "" : std::to_string(k) + " ")
+                  << "policy protected hit percent = " 
+                  << (hits == 0 ? 0 : policy.protected_hit_cnt * 100 / hits) << "%"
+                  << ", promote count = " << size_to_str(policy.promote_cnt)
+                  << ", demote count = " << size_to_str(policy.demote_cnt)
+                  << ", evict count = " << size_to_str(policy.evict_cnt)
+                  << ", protected/probation = " << size_to_str(policy.protected_num) 
+                  << "/" << size_to_str(policy.probation_num)
+                  << ", hit age p50 = " << cmp_mem_engine::PolicyTelemetry::age_percentile(policy.hit_age, 50)
+                  << ", hit age p99 = " << cmp_mem_engine::PolicyTelemetry::age_percentile(policy.hit_age, 99)
                   << '\n';
     }
 
-    auto [retry_cnt, sleep_cnt, bench_cnt] = consumer.get_stats();
-    std::cout << "consumer wait and retry count = " << size_to_str(retry_cnt) 
-              << ", sleep count = " << size_to_str(sleep_cnt) 
-              << ", bench count = " << size_to_str(bench_cnt)
-              << '\n';
+    if (verbose)
+        print_top_keys(caches);
+
+    if (verbose && near_cache)
+    {
+        // the keys and the round trips which the consumer did not see
+        std::cout << "near cache answered " << near_hit_total * 100 / std::max<size_t>(query_total, 1) << "% keys"
+                  << ", " << size_to_str(near_tx_total) << " transactions without round trip\n";
+    }
+
+    if (verbose)
+    {
+        std::cout << "Total " << producer_num << " producers, qps(total) = " << size_to_str(res.total_qps) << '\n';
+    }
+
+    return res;
 }
 
-void benchmark_producer_consumer_pure()
+template <typename Transport, typename ProducerWait, typename ConsumerWait,
+          template <typename, typename> class ProducerTemplate = cmp_mem_engine::Producer>
+void benchmark_producer_consumer(const char* transport_name, const bool near_cache = false)
 {
-    std::cout << "benchmark producer&consumer by pure, init starting ...\n";
+    std::cout << "benchmark producer&consumer by " << transport_name << ", init starting ...\n";
     std::vector<std::string> samples;
-    cmp_mem_engine::SingleData cache(cmp_mem_engine::kKeySpace, cmp_mem_engine::kSampleSpace, samples);
-    cmp_mem_engine::Tasks tasks;
+    Caches caches = make_caches<Transport>(samples);
     std::cout << "producer&consumer init finish\n";
 
-    // First, start only one consumer thread
-    cmp_mem_engine::ConsumerPure consumer(cache, tasks);
-    consumer.start_thread_loop();
+    run_producer_consumer<Transport, ProducerWait, ConsumerWait, ProducerTemplate>(caches, samples, 
+                                                                 cmp_mem_engine::kRunProducerNum, 
+                                                                 cmp_mem_engine::kBenchmarkCount, true, 
+                                                                 nullptr, nullptr, near_cache);
+}
+
+// The points of a printed miss ratio curve
+constexpr size_t kMrcPointNum = 10;
+
+void print_mrc(const cmp_mem_engine::ShardsMrc& mrc)
+{
+    std::cout << "MRC of " << size_to_str(mrc.ref_num()) << " lookups, sample rate = " << mrc.sample_rate() * 100 << "%\n"
+              << "  size:hit%";
+    for (const cmp_mem_engine::MrcPoint& point : mrc.curve(kMrcPointNum))
+        std::cout << ' ' << size_to_str(point.size) << ':' << point.hit_percent;
+    std::cout << "\n  SLRU protected%:hit%";
+    for (const cmp_mem_engine::MrcSplit& split : mrc.splits())
+        std::cout << ' ' << split.protect_percent << ':' << split.hit_percent;
+    std::cout << '\n';
+}
+
+// The miss ratio curve by SHARDS, offline over the Zipf trace of benchmark_policies() (compared with the real SLRU
+// of the capacity), and live beside the consumer of the ring mode
+void benchmark_mrc()
+{
+    std::cout << "benchmark miss ratio curve, init starting ...\n";
+    std::vector<std::string> keys;
+    keys.reserve(kPolicyUniverse);
+    for (size_t i = 0; i != kPolicyUniverse; ++i)
+        keys.push_back("key:" + std::to_string(i));
+    const std::vector<uint32_t> zipf = make_policy_trace(false);
+    std::cout << "miss ratio curve init finish\n";
+
+    const size_t capacity = kPolicyUniverse * kPolicyCapacityPercent / 100;
+    cmp_mem_engine::ShardsMrc mrc(kPolicyUniverse, capacity);
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (const uint32_t i : zipf)
+        mrc.add(keys[i], std::hash<std::string>()(keys[i]));
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "offline, ns per lookup (with hash) = " 
+              << static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / zipf.size()
+              << ", SLRU of " << size_to_str(capacity) << " keys\n";
+    print_mrc(mrc);
+    std::cout << "real SLRU (" << cmp_mem_engine::kProtectPercent << "% protected):\n";
+    run_policy<cmp_mem_engine::SlruPolicy>("zipf", keys, zipf);
+
+    std::cout << "live, init starting ...\n";
+    std::vector<std::string> samples;
+    Caches caches = make_caches<cmp_mem_engine::RingTransport>(samples);
+    for (auto& cache : caches)
+        cache->set_mrc(cmp_mem_engine::kKeySpace, cmp_mem_engine::kProtectSpace);
 
-    // then start kRunProducerNum producer threads
-    constexpr size_t kProducerThreadNum = cmp_mem_engine::kRunProducerNum;
-    std::vector<std::unique_ptr<cmp_mem_engine::ProducerPure>> ps;
-    ps.reserve(kProducerThreadNum);
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+    run_producer_consumer<cmp_mem_engine::RingTransport, 
+                          cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>(caches, samples, 
+                                                                                        cmp_mem_engine::kRunProducerNum, 
+                                                                                        cmp_mem_engine::kBenchmarkCount, true);
+    for (auto& cache : caches)
     {
-        auto one = std::make_unique<cmp_mem_engine::ProducerPure>(i+1, tasks, samples);
-        ps.push_back(std::move(one));
+        print_mrc(*cache->mrc());
+        cache->set_mrc(0, 0);
     }
+}
+
+// The backend latencies and the cache capacities of benchmark_read_through(). The working set is the samples
+// and the random keys of the producers, a smaller capacity evicts more of it, so more misses are loaded
+constexpr long kLoadLatencyUs[] = {10, 100, 1000};
+constexpr size_t kLoadCapacities[] = {cmp_mem_engine::kSampleSpace * 4, cmp_mem_engine::kSampleSpace * 2, 
+                                      cmp_mem_engine::kSampleSpace, cmp_mem_engine::kSampleSpace / 2};
+// The number of keys each producer looks up for one point of benchmark_read_through()
+constexpr size_t kLoadBenchmarkCount = 1<<20;
+
+// The ring mode with async producers, the misses are loaded from a stand-in backend of each latency.
+// The consumer parks the misses and keeps serving, so its throughput should hold until the loads in flight
+// are more than the transactions of the producers can wait for
+void benchmark_read_through()
+{
+    using Transport = cmp_mem_engine::RingTransport;
 
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+    std::cout << "benchmark read-through by ring (async), init starting ...\n";
+    std::vector<std::string> samples;
+    Caches caches = make_caches<Transport>(samples);
+    std::cout << "read-through init finish\n";
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::left << std::setw(12) << "latency us" << std::setw(12) << "capacity" << std::setw(8) << "miss%"
+              << std::setw(12) << "loads" << std::setw(12) << "joined" << std::setw(14) << "qps(total)"
+              << std::setw(8) << "util%" << "cpu%" << '\n';
+
+    auto run = [&caches, &samples](const char* latency, cmp_mem_engine::Loader* loader)
     {
-        ps[i]->start_thread();
+        caches[0]->reset_hit_miss();
+        const ProducerConsumerResult res = 
+            run_producer_consumer<Transport, cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>,
+                                  cmp_mem_engine::AsyncProducer>(caches, samples, cmp_mem_engine::kRunProducerNum, 
+                                                                 kLoadBenchmarkCount, false, 
+                                                                 nullptr, nullptr, false, loader);
+        auto [hit, miss] = caches[0]->hit_miss();
+        std::cout << std::setw(12) << latency << std::setw(12) << size_to_str(caches[0]->key_num()) 
+                  << std::setw(8) << miss * 100 / std::max<size_t>(hit + miss, 1)
+                  << std::setw(12) << size_to_str(res.load_cnt) << std::setw(12) << size_to_str(res.load_join_cnt)
+                  << std::setw(14) << size_to_str(res.total_qps) 
+                  << std::setw(8) << res.consumer_util << res.consumer_cpu << '\n';
+    };
+
+    // the misses are answered as not found at once
+    run("no loader", nullptr);
+
+    for (const size_t capacity : kLoadCapacities)
+    {
+        caches[0]->set_capacity(capacity);
+        for (const long latency_us : kLoadLatencyUs)
+        {
+            cmp_mem_engine::LatencyBackend backend(std::chrono::microseconds(latency_us), 0, cmp_mem_engine::kValMinLen);
+            run(std::to_string(latency_us).c_str(), &backend);
+        }
     }
+    std::cout.flags(flags);
+}
 
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+// The counters of benchmark_compute() and the increments of each producer
+constexpr size_t kComputeCounterNum = 16;
+constexpr size_t kComputeIncrNum = 1<<17;
+
+// Send one request by end and wait for its result
+template <typename Transport, typename Wait>
+void compute_call(typename Transport::ProducerEnd& end, Wait& wait, cmp_mem_engine::ComputeRequest& request)
+{
+    const std::vector<const std::string*> keys(1, cmp_mem_engine::compute_request_key(&request));
+
+    while (!end.can_send() || end.send(keys, 0) == 0)
+        wait.idle();
+    wait.reset();
+
+    while (end.receive([](const std::string*, const std::string*) {}) == 0)
+        wait.idle();
+    wait.reset();
+}
+
+// The producers increment the shared counters, by kIncr in one round trip, or by kGets and kCas in two
+// (and again if another producer wins the version). The consumer runs the requests one by one,
+// so each counter must be exactly the increments of it
+template <typename Transport, typename ProducerWait, typename ConsumerWait>
+void benchmark_compute(const char* transport_name)
+{
+    std::cout << "benchmark compute (counters) by " << transport_name << '\n';
+
+    std::vector<std::string> counters;
+    for (size_t i = 0; i != kComputeCounterNum; ++i)
+        counters.push_back("counter:" + std::to_string(i));
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    std::cout << std::left << std::setw(12) << "op" << std::setw(10) << "ms" << std::setw(14) << "incr/s"
+              << std::setw(14) << "trips/incr" << std::setw(12) << "cas retry" << "counters" << '\n';
+
+    for (const bool by_cas : {false, true})
     {
-        ps[i]->wait_until_join();
+        std::vector<std::string> no_samples;
+        cmp_mem_engine::SingleData data(0, 0, no_samples);
+        typename Transport::Channel channel(cmp_mem_engine::kRunProducerNum);
+
+        cmp_mem_engine::Consumer<Transport, ConsumerWait> consumer(data, channel);
+        consumer.start_thread_loop();
+
+        std::atomic<size_t> trip_cnt{0};
+        std::atomic<size_t> retry_cnt{0};
+        auto produce = [&channel, &counters, &trip_cnt, &retry_cnt, by_cas](const size_t pid)
+        {
+            typename Transport::ProducerEnd end(pid, channel);
+            ProducerWait wait;
+            wait.bind(end.parker());
+
+            cmp_mem_engine::ComputeRequest request;
+            size_t trips = 0;
+            size_t retries = 0;
+            for (size_t n = 0; n != kComputeIncrNum; ++n)
+            {
+                request.key = counters[(n * cmp_mem_engine::kRunProducerNum + pid) % counters.size()];
+                if (!by_cas)
+                {
+                    request.op = cmp_mem_engine::ComputeOp::kIncr;
+                    request.delta = 1;
+                    compute_call<Transport>(end, wait, request);
+                    ++trips;
+                    continue;
+                }
+
+                while (true)
+                {
+                    request.op = cmp_mem_engine::ComputeOp::kGets;
+                    compute_call<Transport>(end, wait, request);
+
+                    const bool found = request.status == cmp_mem_engine::ComputeStatus::kOk;
+                    request.op = cmp_mem_engine::ComputeOp::kCas;
+                    request.expected_version = found ? request.version : 0;
+                    request.operand = std::to_string((found ? std::stoll(request.result) : 0) + 1);
+                    compute_call<Transport>(end, wait, request);
+                    trips += 2;
+
+                    if (request.status == cmp_mem_engine::ComputeStatus::kOk)
+                        break;
+                    ++retries;
+                }
+            }
+
+            trip_cnt.fetch_add(trips, std::memory_order_relaxed);
+            retry_cnt.fetch_add(retries, std::memory_order_relaxed);
+        };
+
+        const auto begin = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> ps;
+        for (size_t i = 0; i != cmp_mem_engine::kRunProducerNum; ++i)
+            ps.emplace_back(produce, i + 1);
+        for (auto& p : ps)
+            p.join();
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        consumer.set_exit_task();
+        consumer.wait_until_join();
+
+        size_t total = 0;
+        for (const std::string& counter : counters)
+        {
+            const std::string* val = data.find_val(counter);
+            total += val == nullptr ? 0 : std::stoull(*val);
+        }
+
+        const size_t incr_num = kComputeIncrNum * cmp_mem_engine::kRunProducerNum;
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        std::cout << std::setw(12) << (by_cas ? "gets + cas" : "incr") << std::setw(10) << ms
+                  << std::setw(14) << size_to_str(incr_num * 1000 / std::max<size_t>(ms, 1))
+                  << std::setw(14) << static_cast<double>(trip_cnt.load()) / static_cast<double>(incr_num)
+                  << std::setw(12) << size_to_str(retry_cnt.load())
+                  << (total == incr_num ? "exact" : "LOST " + std::to_string(incr_num - total)) << '\n';
     }
+    std::cout.flags(flags);
+}
 
-    // consumer thead exit after the producer threads have exited
-    consumer.set_exit_task();
-    consumer.wait_until_join();
+// The mixed TTLs of benchmark_ttl(), in percent of the keys: no TTL, short (a few runs of the wheel level 1) and long
+constexpr int kTtlNonePercent = 50;
+constexpr int kTtlShortPercent = 30;
+constexpr uint32_t kTtlShortMs = 200;
+constexpr uint32_t kTtlLongMs = 20'000;
 
-    // output the results
-    for (size_t i = 0; i != kProducerThreadNum; ++i)
+// The ring mode with the mixed TTLs on all keys, the expired keys are misses at once (lazy)
+// and removed by the timer wheel when the consumer is idle
+void benchmark_ttl()
+{
+    std::cout << "benchmark TTL by ring, init starting ...\n";
+    std::vector<std::string> samples;
+    Caches caches = make_caches<cmp_mem_engine::RingTransport>(samples);
+
+    cmp_mem_engine::RandomEngine re(kTtlLongMs);
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (auto& cache : caches)
     {
-        auto& p = ps[i];
-        const size_t bench_cnt = p->get_bench_count();
-        auto [p_start, p_end] = p->get_time_points();
-        const std::chrono::milliseconds duration_p = std::chrono::duration_cast<std::chrono::milliseconds>(p_end - p_start);
-        const size_t p_qps = bench_cnt * 1000 / duration_p.count();
-        auto [batch_fail_try_cnt, batch_fail_try_most] = p->get_batch_fail_try_stats();
-        std::cout << "producer id = " << i + 1
-                  << ", bench count = " << size_to_str(bench_cnt)
-                  << ", qps = " << size_to_str(p_qps)
-                  << ", miss percent = " << p->miss_percent() << "%"
-                  << ", sleep count = " << p->sleep_count() 
-                  << ", batch_fail_try_cnt = " << size_to_str(batch_fail_try_cnt)
-                  << ", batch_fail_try_most = " << size_to_str(batch_fail_try_most)
-                  << '\n';
+        cache->set_ttl_all([&re](const std::string&) -> uint32_t
+        {
+            const int dice = re.rand_int_scope(0, 99);
+            if (dice < kTtlNonePercent)
+                return 0;
+            if (dice < kTtlNonePercent + kTtlShortPercent)
+                return static_cast<uint32_t>(re.rand_int_scope(1, kTtlShortMs));
+            return static_cast<uint32_t>(re.rand_int_scope(kTtlShortMs, kTtlLongMs));
+        });
     }
+    const auto end = std::chrono::high_resolution_clock::now();
+    const size_t key_num = caches[0]->key_num();
+    std::cout << "producer&consumer init finish, set TTL of " << size_to_str(key_num) << " keys in " 
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms\n";
+
+    run_producer_consumer<cmp_mem_engine::RingTransport, 
+                          cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>(caches, samples, 
+                                                                                        cmp_mem_engine::kRunProducerNum, 
+                                                                                        cmp_mem_engine::kBenchmarkCount, true);
 
-    auto [retry_cnt, sleep_cnt, bench_cnt] = consumer.get_stats();
-    std::cout << "consumer wait and retry count = " << size_to_str(retry_cnt) 
-              << ", sleep count = " << size_to_str(sleep_cnt) 
-              << ", bench count = " << size_to_str(bench_cnt)
-              << '\n';
+    auto [expired, lazy_expired] = caches[0]->expired_lazy_expired();
+    std::cout << "keys = " << size_to_str(key_num) << " -> " << size_to_str(caches[0]->key_num())
+              << ", removed by timer wheel = " << size_to_str(expired) 
+              << ", lookups of expired keys not removed = " << size_to_str(lazy_expired) << '\n';
 }
 
-void benchmark_producer_consumer_lockless()
+// The number of keys each producer looks up for one point of the scaling sweep
+constexpr size_t kSweepBenchmarkCount = 1<<20;
+// The consumer is thought to be saturated when its busy time reaches the percent
+constexpr int kSaturatedConsumerUtil = 90;
+// or the total qps grows less than the percent when the producers double
+constexpr int kSaturatedQpsGrowth = 10;
+
+// Run the mode with N = 1, 2, 4, ..., up to the number of cores of producers,
+// report the efficiency curve and the knee point where the consumer saturates
+template <typename Transport, typename ProducerWait, typename ConsumerWait>
+void benchmark_scaling_sweep(const char* transport_name)
 {
-    std::cout << "benchmark producer&consumer by lockless, init starting ...\n";
+    std::cout << "scaling sweep of producer&consumer by " << transport_name << ", init starting ...\n";
     std::vector<std::string> samples;
-    cmp_mem_engine::SingleData cache(cmp_mem_engine::kKeySpace, cmp_mem_engine::kSampleSpace, samples);
-    std::array<cmp_mem_engine::LocklessTasks, cmp_mem_engine::kRunProducerNum> producers_tasks;
+    Caches caches = make_caches<Transport>(samples);
 
-    // First, start only one consumer thread
-    cmp_mem_engine::ConsumerLockless consumer(cache, producers_tasks);
-    consumer.start_thread_loop();
+    const size_t core_num = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::vector<size_t> producer_nums;
+    for (size_t n = 1; n < core_num; n *= 2)
+    {
+        producer_nums.push_back(n);
+    }
+    producer_nums.push_back(core_num);
 
-    // then start kRunProducerNum producer threads
-    std::vector<std::unique_ptr<cmp_mem_engine::ProducerLockless>> ps;
-    ps.reserve(cmp_mem_engine::kRunProducerNum);
-    for (size_t i = 0; i != cmp_mem_engine::kRunProducerNum; ++i)
+    std::vector<ProducerConsumerResult> results;
+    for (const size_t n : producer_nums)
     {
-        auto one = std::make_unique<cmp_mem_engine::ProducerLockless>(i+1, producers_tasks[i], samples);
-        // one->debug_address_of_tasks();
-        ps.push_back(std::move(one));
+        results.push_back(run_producer_consumer<Transport, ProducerWait, ConsumerWait>(
+                            caches, samples, n, kSweepBenchmarkCount, false));
     }
-    // exit(1);
 
-    for (size_t i = 0; i != cmp_mem_engine::kRunProducerNum; ++i)
+    std::cout << "cores = " << core_num << '\n';
+    std::cout << "producers, total qps, producer qps, consumer busy, efficiency\n";
+    size_t knee = 0;
+    for (size_t i = 0; i != results.size(); ++i)
     {
-        ps[i]->start_thread();
+        const ProducerConsumerResult& r = results[i];
+        // parallel efficiency compares to N times of one producer 
+        const size_t efficiency = results[0].total_qps == 0 ? 0 
+                                  : r.total_qps * 100 / (r.producer_num * results[0].total_qps);
+        std::cout << r.producer_num 
+                  << ", " << size_to_str(r.total_qps)
+                  << ", " << size_to_str(r.producer_qps)
+                  << ", " << r.consumer_util << "%"
+                  << ", " << efficiency << "%"
+                  << '\n';
+
+        if (knee != 0)
+            continue;
+
+        if (r.consumer_util >= kSaturatedConsumerUtil)
+        {
+            knee = r.producer_num;
+        }
+        else if (i != 0 && 
+                 r.total_qps * 100 < results[i-1].total_qps * (100 + kSaturatedQpsGrowth))
+        {
+            knee = results[i-1].producer_num;
+        }
     }
 
-    for (size_t i = 0; i != cmp_mem_engine::kRunProducerNum; ++i)
+    if (knee == 0)
     {
-        ps[i]->wait_until_join();
+        std::cout << "knee point: not reached, one consumer serves " << results.back().producer_num << " producers\n";
+    }
+    else
+    {
+        std::cout << "knee point: the consumer saturates at " << knee << " producers\n";
     }
+}
 
-    // consumer thead exit after the producer threads have exited
-    consumer.set_exit_task();
-    consumer.wait_until_join();
+// The offered loads of the open loop sweep, in percent of the closed loop qps
+constexpr int kOpenLoopLoads[] = {10, 20, 30, 40, 50, 60, 70, 80, 90, 95, 100, 110, 120};
 
-    // output the results
-    for (size_t i = 0; i != cmp_mem_engine::kRunProducerNum; ++i)
+// Find the saturation qps by closed loop first, 
+// then run open loop (Poisson arrival) with the offered load up to and over the saturation.
+// Output the curve of throughput vs. latency which is measured from the intended send time,
+// and the batch sizes of the consumer. If batching is not nullptr, the consumer runs with adaptive batching
+template <typename Transport, typename ProducerWait, typename ConsumerWait,
+          template <typename, typename> class ProducerTemplate = cmp_mem_engine::Producer>
+void benchmark_open_loop_sweep(const char* transport_name, const cmp_mem_engine::BatchingConfig* batching = nullptr)
+{
+    std::cout << "open loop sweep of producer&consumer by " << transport_name << ", init starting ...\n";
+    std::vector<std::string> samples;
+    Caches caches = make_caches<Transport>(samples);
+
+    constexpr size_t kProducerNum = cmp_mem_engine::kRunProducerNum;
+    const ProducerConsumerResult closed = run_producer_consumer<Transport, ProducerWait, ConsumerWait, ProducerTemplate>(
+                                            caches, samples, kProducerNum, kSweepBenchmarkCount, false, nullptr, batching);
+    std::cout << "closed loop qps(total) = " << size_to_str(closed.total_qps) << '\n';
+
+    constexpr double kAvgKeysOneTransaction = 
+        (cmp_mem_engine::kTransactionOneStepLeastKeys + cmp_mem_engine::kTransactionOneStepMostKeys) / 2.0;
+
+    std::cout << "offered qps, achieved qps, p50(us), p90(us), p99(us), p999(us), max(us), producer cpu, consumer cpu"
+                 ", batch p50, batch p99\n";
+    for (const int load : kOpenLoopLoads)
     {
-        auto& p = ps[i];
-        const size_t bench_cnt = p->get_bench_count();
-        auto [p_start, p_end] = p->get_time_points();
-        const std::chrono::milliseconds duration_p = std::chrono::duration_cast<std::chrono::milliseconds>(p_end - p_start);
-        const size_t p_qps = bench_cnt * 1000 / duration_p.count();
-        auto [request_wait_cnt, request_wait_most, result_wait_cnt, ressult_wait_most] = p->get_batch_stats();
-        std::cout << "producer id = " << i + 1
-                  << ", bench count = " << size_to_str(bench_cnt)
-                  << ", qps = " << size_to_str(p_qps)
-                  << ", miss percent = " << p->miss_percent() << "%"
-                  << ", request_wait_cnt = " << size_to_str(request_wait_cnt)
-                  << ", request_wait_most = " << size_to_str(request_wait_most)
-                  << ", result_wait_cnt = " << size_to_str(result_wait_cnt)
-                  << ", ressult_wait_most = " << size_to_str(ressult_wait_most)
+        const double offered_qps = static_cast<double>(closed.total_qps) * load / 100;
+
+        cmp_mem_engine::OpenLoopConfig config;
+        config.arrival = cmp_mem_engine::Arrival::kPoisson;
+        config.tx_per_sec = offered_qps / kAvgKeysOneTransaction / kProducerNum;
+
+        const ProducerConsumerResult r = run_producer_consumer<Transport, ProducerWait, ConsumerWait, ProducerTemplate>(
+                                            caches, samples, kProducerNum, 0, false, &config, batching);
+
+        std::cout << size_to_str(static_cast<size_t>(offered_qps))
+                  << " (" << load << "%)"
+                  << ", " << size_to_str(r.total_qps)
+                  << ", " << r.latency.percentile(50) / 1000
+                  << ", " << r.latency.percentile(90) / 1000
+                  << ", " << r.latency.percentile(99) / 1000
+                  << ", " << r.latency.percentile(99.9) / 1000
+                  << ", " << r.latency.max() / 1000
+                  << ", " << r.producer_cpu << "%"
+                  << ", " << r.consumer_cpu << "%"
+                  << ", " << r.batch_sizes.percentile(50)
+                  << ", " << r.batch_sizes.percentile(99)
                   << '\n';
     }
+}
+
+// Wait no more than 2 us for a batch of 32
+constexpr cmp_mem_engine::BatchingConfig kAdaptiveBatching{2000, 32, 1.0};
+
+void benchmark_open_loop_sweep_all()
+{
+    benchmark_open_loop_sweep<cmp_mem_engine::PureTransport, 
+                              cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("pure");
 
-    auto [batch_cnt, wait_cnt] = consumer.get_stats();
-    std::cout << "consumer waiit count = " << size_to_str(wait_cnt) 
-              << ", bench count = " << size_to_str(batch_cnt)
-              << '\n';
+    benchmark_open_loop_sweep<cmp_mem_engine::SignalTransport, 
+                              cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("signal");
+
+    benchmark_open_loop_sweep<cmp_mem_engine::LocklessTransport, 
+                              cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("lockless");
+
+    benchmark_open_loop_sweep<cmp_mem_engine::RingTransport, 
+                              cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("ring");
+
+    benchmark_open_loop_sweep<cmp_mem_engine::RingTransport, 
+                              cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("ring (adaptive batch)", 
+                                                                                             &kAdaptiveBatching);
+
+    benchmark_open_loop_sweep<cmp_mem_engine::RingTransport, 
+                              cmp_mem_engine::ParkWait<>, cmp_mem_engine::ParkWait<>>("ring (park)");
+
+    benchmark_open_loop_sweep<cmp_mem_engine::ShardedTransport<cmp_mem_engine::RingTransport, cmp_mem_engine::kRunConsumerNum>, 
+                              cmp_mem_engine::ParkWait<>, cmp_mem_engine::ParkWait<>>("sharded ring (park)");
+
+    benchmark_open_loop_sweep<cmp_mem_engine::RingTransport, 
+                              cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>, 
+                              cmp_mem_engine::AsyncProducer>("ring (async)");
 }
 
-int main()
+void benchmark_scaling_sweep_all()
 {
-    benchmark_producer_consumer_lockless();
+    benchmark_scaling_sweep<cmp_mem_engine::PureTransport, 
+                            cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("pure");
+
+    benchmark_scaling_sweep<cmp_mem_engine::SignalTransport, 
+                            cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("signal");
+
+    benchmark_scaling_sweep<cmp_mem_engine::LocklessTransport, 
+                            cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("lockless");
 
-    // benchmark_producer_consumer_pure();
+    benchmark_scaling_sweep<cmp_mem_engine::RingTransport, 
+                            cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("ring");
+
+    benchmark_scaling_sweep<cmp_mem_engine::ShardedTransport<cmp_mem_engine::RingTransport, cmp_mem_engine::kRunConsumerNum>, 
+                            cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("sharded ring");
+}
+
+// The benchmarks which can be selected by name, e.g. ./a.out ring ttl mrc (all for each one of them).
+// Only lockless runs without a name
+struct NamedBenchmark
+{
+    const char* name;
+    void (*run)();
+};
+
+const NamedBenchmark kBenchmarks[] =
+{
+    {"lockless", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::LocklessTransport, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("lockless");
+    }},
+
+    {"ring", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::RingTransport, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("ring");
+    }},
+
+    {"sharded_ring", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::ShardedTransport<cmp_mem_engine::RingTransport, cmp_mem_engine::kRunConsumerNum>, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("sharded ring");
+    }},
+
+    {"async", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::RingTransport, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>, 
+                                    cmp_mem_engine::AsyncProducer>("ring (async)");
+    }},
+
+    {"near_cache", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::RingTransport, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("ring (near cache)", true);
+    }},
+
+    {"lockless_park", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::LocklessTransport, 
+                                    cmp_mem_engine::ParkWait<>, cmp_mem_engine::ParkWait<>>("lockless (park)");
+    }},
+
+    {"pure", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::PureTransport, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("pure");
+    }},
+
+    {"signal", []
+    {
+        benchmark_producer_consumer<cmp_mem_engine::SignalTransport, 
+                                    cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("signal");
+    }},
+
+    {"scaling", benchmark_scaling_sweep_all},
+
+    {"open_loop", benchmark_open_loop_sweep_all},
+
+    {"miss_path", benchmark_miss_path},
+
+    {"ttl", benchmark_ttl},
+
+    {"read_through", benchmark_read_through},
+
+    {"compute", []
+    {
+        benchmark_compute<cmp_mem_engine::LocklessTransport, 
+                          cmp_mem_engine::SpinWait, cmp_mem_engine::BusyThenSleepWait<>>("lockless");
+    }},
+
+    {"policies", benchmark_policies},
+
+    {"write_behind", benchmark_write_behind},
+
+    {"warm_restart", benchmark_warm_restart},
+
+    {"mrc", benchmark_mrc},
+
+    {"multi", benchmark_multi},
+
+    {"single", benchmark_single},
+};
+
+const NamedBenchmark* find_benchmark(const std::string& name)
+{
+    for (const NamedBenchmark& benchmark : kBenchmarks)
+    {
+        if (name == benchmark.name)
+            return &benchmark;
+    }
+
+    return nullptr;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<const NamedBenchmark*> selected;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "all")
+        {
+            for (const NamedBenchmark& benchmark : kBenchmarks)
+                selected.push_back(&benchmark);
+            continue;
+        }
+
+        const NamedBenchmark* benchmark = find_benchmark(argv[i]);
+        if (benchmark == nullptr)
+        {
+            std::cerr << "unknown benchmark " << argv[i] << ", the benchmarks are: all";
+            for (const NamedBenchmark& known : kBenchmarks)
+                std::cerr << ' ' << known.name;
+            std::cerr << '\n';
+            return 1;
+        }
+        selected.push_back(benchmark);
+    }
 
-    // benchmark_producer_consumer_signal();
+    if (selected.empty())
+        selected.push_back(find_benchmark("lockless"));
 
-    // benchmark_multi();
+    g_live_stats.open();
+    cmp_mem_engine::Tracer::enable_by_env();
 
-    // benchmark_single();
+    for (const NamedBenchmark* benchmark : selected)
+        benchmark->run();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Compute requests: a read-modify-write of one key which runs in the consumer, in one round trip.
+ *
+ * A producer fills a ComputeRequest (the op, the key and the operands) in its own memory and sends
+ * compute_request_key(&request) instead of a key pointer. The pointer is tagged by the low bit,
+ * so the transports carry it as any key (use request_key() if they need the key), and the consumer
+ * runs it by CacheData::apply() instead of a lookup, not deduplicated with the other requests of the batch.
+ * The status, the version and the value are written back to the request before it is delivered,
+ * so the producer reads them after the result of its tagged pointer comes (the val of the result is
+ * &request.result, or kNotFound if the status is kNotFound). The request must live until then.
+ *
+ * The consumer owns the cache and runs the requests one by one, so each one is atomic,
+ * and all of them (with the plain lookups) are linearizable in the order the consumer takes them
+ * (a lookup after a write in the same batch is not deduplicated with one before it).
+ *
+ * Each entry has a version, bumped by every write of its value (from 1, 0 is an absent key for kCas).
+ */
+
+namespace cmp_mem_engine
+{
+
+enum class ComputeOp : uint8_t
+{
+    kGets,          // the value and its version
+    kIncr,          // add delta to the decimal value, an absent key is 0, result is the new value
+    kDecr,          // subtract delta, like kIncr
+    kCas,           // set operand if the version is expected_version (0 for adding an absent key)
+    kAppend,        // append operand to the value of a present key
+    kGetAndTouch,   // the value, and set the TTL of the key to ttl_ms from now (0 for no TTL)
+};
+
+enum class ComputeStatus : uint8_t
+{
+    kOk,
+    kNotFound,
+    kVersionMismatch,   // kCas only, version and result are of the current value
+    kNotNumber,         // kIncr and kDecr, the value is not a decimal int64
+    kOverflow,          // kIncr and kDecr, the value is not changed
+};
+
+struct ComputeRequest
+{
+    // by the producer
+    ComputeOp op = ComputeOp::kGets;
+    std::string key;
+    std::string operand;            // of kCas and kAppend
+    int64_t delta = 0;              // of kIncr and kDecr
+    uint32_t expected_version = 0;  // of kCas
+    uint32_t ttl_ms = 0;            // of kGetAndTouch
+
+    // by the consumer. result is the value after the op (before it if failed), empty for kAppend and a done kCas
+    ComputeStatus status = ComputeStatus::kOk;
+    uint32_t version = 0;
+    std::string result;
+};
+
+constexpr uintptr_t kComputeTag = 1;
+static_assert(alignof(ComputeRequest) > kComputeTag);
+
+// The pointer of request to send as a key
+inline const std::string* compute_request_key(ComputeRequest* request)
+{
+    return reinterpret_cast<const std::string*>(reinterpret_cast<uintptr_t>(request) | kComputeTag);
+}
+
+// The request of a sent key pointer, nullptr if it is a plain lookup
+inline ComputeRequest* as_compute_request(const std::string* key)
+{
+    const uintptr_t bits = reinterpret_cast<uintptr_t>(key);
+    return (bits & kComputeTag) == 0 ? nullptr : reinterpret_cast<ComputeRequest*>(bits & ~kComputeTag);
+}
+
+// The key of a sent key pointer, a plain lookup or a compute request
+inline const std::string& request_key(const std::string* key)
+{
+    const ComputeRequest* request = as_compute_request(key);
+    return request == nullptr ? *key : request->key;
+}
+
+}   // namespace cmp_mem_engine
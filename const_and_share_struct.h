@@ -1,31 +1,32 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
-#include <list>
+#include <array>
+#include <vector>
+#include <tuple>
+#include <limits>
 #include <memory>
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
 #include <unordered_map>
 #include <jemalloc/jemalloc.h>
 #include <new>
 #include <atomic>
+#include <ctime>
 #include <string>
 #include <new>
 
 #include "random_str.h"
+#include "eviction_policy.h"
 
 
-#ifdef __cpp_lib_hardware_interference_size
-    using std::hardware_constructive_interference_size;
-    using std::hardware_destructive_interference_size;
-#else
-    // 64 bytes on x86-64 │ L1_CACHE_BYTES │ L1_CACHE_SHIFT │ __cacheline_aligned │ ...
-    constexpr std::size_t hardware_constructive_interference_size = 64;
-    constexpr std::size_t hardware_destructive_interference_size = 64;
-#endif
-
-
-// #define USE_SPINLOCK_FOR_TASKS      // please use for pure only for compare spinlock and mutext difference
+// The alignment of the shared atomics: 64 bytes on x86-64 │ L1_CACHE_BYTES │ L1_CACHE_SHIFT │ __cacheline_aligned │ ...
+// Fixed, not std::hardware_destructive_interference_size, so it is the same for all translation units
+constexpr std::size_t kCacheLineSize = 64;
 
 namespace cmp_mem_engine
 {
@@ -40,7 +41,9 @@ constexpr size_t kHotSpace = 1<<10;
 constexpr size_t kRandSpace = 1<<12;
 constexpr size_t kSampleSpace = 1<<12;
 
-constexpr size_t kProtectSpace = kKeySpace * 90 / 100;
+// the protected segment of SLRU (see policy_slru.h), in percent of the capacity
+constexpr size_t kProtectPercent = 90;
+constexpr size_t kProtectSpace = kKeySpace * kProtectPercent / 100;
 
 constexpr int kHotHit = 90;
 
@@ -57,32 +60,39 @@ constexpr size_t kTransactionOneStepMostKeys = 20;
 
 static_assert(kTransactionOneStepLeastKeys <= kTransactionOneStepMostKeys);
 
-constexpr size_t kFixProducerNumber = 8;
 constexpr size_t kRunProducerNum = 2;
-static_assert(kRunProducerNum > 0 && kRunProducerNum <= kFixProducerNumber);
+static_assert(kRunProducerNum > 0);
+// the number of consumers (i.e., shards) for the sharded mode
+constexpr size_t kRunConsumerNum = 2;
+static_assert(kRunConsumerNum > 0);
 
 extern const char* kNotFound;
 extern const char* kExitConsumerThreadTask;
 
-constexpr size_t kLockLessArrayNum = 1 * (hardware_destructive_interference_size/sizeof(std::atomic<std::string*>));
+constexpr size_t kLockLessArrayNum = 1 * (kCacheLineSize/sizeof(std::atomic<std::string*>));
 
 struct CombinedVal
 {
-    CombinedVal(std::string&& _val) : val(std::move(_val)), is_protected(true)
+    CombinedVal(std::string&& _val) : val(std::move(_val)), in_wheel(false), expire_ms(0), policy_link(kPolicyNil),
+                                      version(1)
     {}
 
-    void set_list_iter(const bool _is_protected, std::list<const std::string*>::iterator _it_list)
-    {
-        is_protected = _is_protected;
-        it_list = _it_list;
-    }
-
     std::string val;
 
-    bool is_protected;
-    std::list<const std::string*>::iterator it_list;
+    bool in_wheel;          // the key has one timer in the timer wheel (maybe of an earlier expire_ms)
+    uint32_t expire_ms;     // in the ms of CacheData::now_ms(), 0 for no TTL
+    PolicyLink policy_link; // the node of the key in the eviction policy (see eviction_policy.h)
+    uint32_t version;       // bumped by each write of val, never 0 (see compute_op.h)
+
+    void bump_version()
+    {
+        if (++version == 0)
+            version = 1;
+    }
 };
 
+static_assert(sizeof(CombinedVal) == sizeof(std::string) + 16);
+
 class HeapKey
 {
 public:
@@ -128,6 +138,13 @@ public:
         return *wrap_key_;
     }
 
+    // Take the key out of a heap key (e.g., of a node extracted from the map), so it lives longer than the entry
+    std::unique_ptr<const std::string> take_key()
+    {
+        assert(!key_in_stack_);
+        return std::move(wrap_key_);
+    }
+
     bool operator==(const HeapKey& other) const
     {
         return this->real_key() == other.real_key();
@@ -156,126 +173,12 @@ namespace std
 namespace cmp_mem_engine
 {
 
-// Own by one single threead, no lock using
-class SingleData
+// The shard of key when the key space is partitioned to shard_num SingleData.
+// The hash is mixed, so the keys of one shard still spread over the buckets of its hash map
+inline size_t shard_of(const std::string& key, const size_t shard_num)
 {
-private:
-    RandomEngine re_;
-
-    std::unordered_map<HeapKey, CombinedVal> key_vals_;
-    // lists of cold(head) -> warm(tail)
-    std::list<const std::string*> protected_list_;
-    std::list<const std::string*> probationary_list_;
-
-    size_t hit_cnt_;
-    size_t miss_cnt_;
-
-public:
-    SingleData() = delete;
-    SingleData(const SingleData&) = delete;
-    SingleData(SingleData&&) = delete;
-    SingleData& operator=(const SingleData&) = delete;
-    SingleData& operator=(SingleData&&) = delete;
-
-    explicit SingleData(const size_t init_key_num, const size_t sample_num, std::vector<std::string>& samples)
-        : re_(1), hit_cnt_(0), miss_cnt_(0)
-    {
-        assert(sample_num <= init_key_num && samples.empty());
-
-        key_vals_.reserve(init_key_num);
-
-        size_t sample_cnt = 0, protected_cnt = 0;
-
-        for (size_t i = 0; i != init_key_num; ++i)
-        {
-            std::string key = rand_str_scope(re_, kKeyMinLen, kKeyMaxLen);
-            std::string val = rand_str_scope(re_, kValMinLen, kValMaxLlen);
-
-            if (sample_cnt < sample_num)
-            {
-                samples.push_back(key);
-                ++sample_cnt;
-            }
-            
-            // add key and value to HashMap and 2Q list
-            auto [it_map, inserted] = 
-                key_vals_.insert({HeapKey(std::make_unique<std::string>(std::move(key))), CombinedVal(std::move(val))});
-            if (inserted)
-            {
-                const std::string* key = &(it_map->first.real_key()); 
-                if (protected_cnt < kProtectSpace)
-                {
-                    // insert to protected list
-                    auto it_list = protected_list_.insert(protected_list_.end(), key);
-                    it_map->second.set_list_iter(true, it_list);
-                    ++protected_cnt;
-                }
-                else
-                {
-                    // insert to probationary lisst
-                    auto it_list = probationary_list_.insert(probationary_list_.end(), key);
-                    it_map->second.set_list_iter(false, it_list);
-                }
-            }
-        }
-    }
-
-    // Return nullptr if not found, else the value of std::sttring.
-    // It will refresh the 2Q list for each lookup
-    std::string* find_val(const std::string& key)
-    {
-        const HeapKey stack_key(&key);      // construct a stack-memory(pseduo) HeapKey
-
-        const auto it = key_vals_.find(stack_key);  // hash find
-
-        if (it == key_vals_.end())
-        {
-            ++miss_cnt_;
-
-            return nullptr;
-        }
-        else
-        {
-            ++hit_cnt_;
-
-            bool is_protect = it->second.is_protected;
-            auto it_hit = it->second.it_list;
-
-            if (is_protect)
-            {
-                // if it_hit happens in protection 
-                // promote it_hit to the warmest in protection
-                protected_list_.splice(protected_list_.end(), protected_list_, it_hit);
-            }
-            else
-            {
-                // else it_hit happens in probation
-                if (protected_list_.size() < kProtectSpace)
-                {
-                    // if protection is not full
-                    // promote it_list from probation to the coldest in protection
-                    protected_list_.splice(protected_list_.begin(), probationary_list_, it_hit);
-                }
-                else
-                {
-                    // else protection is full
-                    // demote the coldest in protection to the warmest in probation
-                    auto it_coldest_in_protect = protected_list_.begin();
-                    assert(it_coldest_in_protect != protected_list_.end());
-                    probationary_list_.splice(probationary_list_.end(), protected_list_, it_coldest_in_protect);
-                    // then promote it_hit from probation to the coldest in protection
-                    protected_list_.splice(protected_list_.begin(), probationary_list_, it_hit);
-                }
-            }
-
-            return &it->second.val;
-        }
-    }
-
-    std::tuple<size_t, size_t> hit_miss() const
-    {
-        return {hit_cnt_, miss_cnt_};
-    }
-};
+    const uint64_t h = std::hash<std::string>()(key) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h >> 32) % shard_num;
+}
 
 }   // cmp_mem_engine
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <vector>
+
+#include "const_and_share_struct.h"
+
+namespace cmp_mem_engine
+{
+
+/* The producers ring the doorbell after publishing requests,
+ * and the consumer drains it to know which producers to poll,
+ * so the cost of polling is for the active producers only, not for all producers.
+ *
+ * Two levels: bit j of groups_[g] is for the producer index (g * 64 + j),
+ * and bit g of summary_ is set if groups_[g] maybe not zero.
+ * With no more than 64 producers, there is only groups_[0] and summary_ is not used.
+ *
+ * A producer sets its group bit before the summary bit, and the consumer clears the summary bit
+ * before the group, so a ring is never lost (but the consumer maybe finds an empty group).
+ */
+class Doorbell
+{
+private:
+    struct alignas(kCacheLineSize) Group
+    {
+        std::atomic<uint64_t> bits{0};
+    };
+
+    static constexpr size_t kGroupBits = 64;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> summary_{0};
+    std::vector<Group> groups_;
+
+public:
+    Doorbell() = delete;
+    Doorbell(const Doorbell&) = delete;
+    Doorbell(Doorbell&&) = delete;
+    Doorbell& operator=(const Doorbell&) = delete;
+    Doorbell& operator=(Doorbell&&) = delete;
+
+    explicit Doorbell(const size_t producer_num) : groups_((producer_num + kGroupBits - 1) / kGroupBits)
+    {
+        assert(producer_num > 0 && producer_num <= kGroupBits * kGroupBits);
+    }
+
+    // Called by the producer of index (i.e., pid-1) after its requests are published
+    void ring(const size_t index)
+    {
+        const size_t g = index / kGroupBits;
+        const uint64_t bit = uint64_t(1) << (index % kGroupBits);
+
+        const uint64_t old = groups_[g].bits.fetch_or(bit, std::memory_order_release);
+
+        // if the group was not empty, the one who made it not empty has set (or will set) the summary
+        if (old == 0 && groups_.size() > 1)
+            summary_.fetch_or(uint64_t(1) << g, std::memory_order_release);
+    }
+
+    // Called by the consumer. Call on_ring(index) for each producer which has rung since last drain,
+    // return the number of them
+    template <typename F>
+    size_t drain(F&& on_ring)
+    {
+        if (groups_.size() == 1)
+            return drain_group(0, on_ring);
+
+        if (summary_.load(std::memory_order_relaxed) == 0)
+            return 0;
+
+        size_t cnt = 0;
+        for (uint64_t s = summary_.exchange(0, std::memory_order_acquire); s != 0; s &= s - 1)
+            cnt += drain_group(static_cast<size_t>(__builtin_ctzll(s)), on_ring);
+
+        return cnt;
+    }
+
+private:
+    template <typename F>
+    size_t drain_group(const size_t g, F& on_ring)
+    {
+        // read first, so the idle consumer does not write the cache line
+        if (groups_[g].bits.load(std::memory_order_relaxed) == 0)
+            return 0;
+
+        const uint64_t bits = groups_[g].bits.exchange(0, std::memory_order_acquire);
+
+        size_t cnt = 0;
+        for (uint64_t b = bits; b != 0; b &= b - 1)
+        {
+            on_ring(g * kGroupBits + static_cast<size_t>(__builtin_ctzll(b)));
+            ++cnt;
+        }
+
+        return cnt;
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+#include "policy_telemetry.h"
+
+/* The eviction policy of a cache (CacheData<Policy> in cache_data.h) is a compile-time parameter.
+ * A policy keeps its own nodes of the resident keys (and of the ghosts, i.e., the recently evicted keys, if it has),
+ * an entry of the cache only keeps the link (the index of its node). A policy is like:
+ *
+ *   class XxxPolicy
+ *   {
+ *   public:
+ *       static constexpr const char* kName = "xxx";
+ *
+ *       // capacity is the number of resident keys the policy is tuned for (e.g., the size of a segment)
+ *       explicit XxxPolicy(const size_t capacity);
+ *       void set_capacity(const size_t capacity);
+ *
+ *       // key is resident now, hash is std::hash<std::string> of it. Return the link of the entry
+ *       PolicyLink on_insert(const std::string* key, const uint64_t hash);
+ *
+ *       void on_hit(const PolicyLink link);
+ *
+ *       // Choose one resident key to evict for the key of incoming_hash, and remove it from the policy
+ *       // (it maybe becomes a ghost). Return nullptr if no resident key
+ *       const std::string* victim(const uint64_t incoming_hash);
+ *
+ *       // the key is removed not by victim(), e.g., expired
+ *       void on_erase(const PolicyLink link);
+ *   };
+ *
+ * and it counts its moves by PolicyTelemetryRef (see policy_telemetry.h).
+ *
+ * The implementations: SlruPolicy (policy_slru.h), S3FifoPolicy (policy_s3fifo.h), ArcPolicy (policy_arc.h)
+ * and LirsPolicy (policy_lirs.h). None of them is thread safe.
+ */
+
+namespace cmp_mem_engine
+{
+
+using PolicyLink = uint32_t;
+constexpr uint32_t kPolicyNil = UINT32_MAX;
+
+// The telemetry of a policy, its own one by default, or published somewhere (e.g., in LiveStats)
+class PolicyTelemetryRef
+{
+protected:
+    PolicyTelemetry own_telemetry_;
+    PolicyTelemetry* telemetry_ = &own_telemetry_;
+
+public:
+    // nullptr for its own one, the counters so far are copied to the new one
+    void set_telemetry(PolicyTelemetry* telemetry)
+    {
+        PolicyTelemetry* to = telemetry == nullptr ? &own_telemetry_ : telemetry;
+        if (to == telemetry_)
+            return;
+
+        *to = *telemetry_;
+        telemetry_ = to;
+    }
+
+    PolicyTelemetry& telemetry()
+    {
+        return *telemetry_;
+    }
+
+    const PolicyTelemetry& telemetry() const
+    {
+        return *telemetry_;
+    }
+};
+
+// The nodes of a policy in a vector, a freed node is reused by the next alloc(), so the indexes are stable
+template <typename Node>
+class NodePool
+{
+private:
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_;
+
+public:
+    uint32_t alloc()
+    {
+        if (!free_.empty())
+        {
+            const uint32_t i = free_.back();
+            free_.pop_back();
+            nodes_[i] = Node{};
+            return i;
+        }
+
+        nodes_.emplace_back();
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+
+    void free(const uint32_t i)
+    {
+        free_.push_back(i);
+    }
+
+    void reserve(const size_t n)
+    {
+        nodes_.reserve(n);
+    }
+
+    Node& operator[](const uint32_t i)
+    {
+        return nodes_[i];
+    }
+
+    const Node& operator[](const uint32_t i) const
+    {
+        return nodes_[i];
+    }
+};
+
+// A doubly linked list of the nodes of a NodePool by the members Prev and Next of Node (a node can be in
+// more than one list by different members), front is the oldest (LRU, or the head of FIFO)
+template <typename Node, uint32_t Node::*Prev = &Node::prev, uint32_t Node::*Next = &Node::next>
+class NodeList
+{
+private:
+    uint32_t front_ = kPolicyNil;
+    uint32_t back_ = kPolicyNil;
+    size_t size_ = 0;
+
+public:
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    uint32_t front() const
+    {
+        return front_;
+    }
+
+    uint32_t back() const
+    {
+        return back_;
+    }
+
+    void push_back(NodePool<Node>& pool, const uint32_t i)
+    {
+        pool[i].*Prev = back_;
+        pool[i].*Next = kPolicyNil;
+        if (back_ != kPolicyNil)
+            pool[back_].*Next = i;
+        else
+            front_ = i;
+        back_ = i;
+        ++size_;
+    }
+
+    void push_front(NodePool<Node>& pool, const uint32_t i)
+    {
+        pool[i].*Prev = kPolicyNil;
+        pool[i].*Next = front_;
+        if (front_ != kPolicyNil)
+            pool[front_].*Prev = i;
+        else
+            back_ = i;
+        front_ = i;
+        ++size_;
+    }
+
+    void remove(NodePool<Node>& pool, const uint32_t i)
+    {
+        const uint32_t prev = pool[i].*Prev;
+        const uint32_t next = pool[i].*Next;
+
+        if (prev != kPolicyNil)
+            pool[prev].*Next = next;
+        else
+            front_ = next;
+
+        if (next != kPolicyNil)
+            pool[next].*Prev = prev;
+        else
+            back_ = prev;
+
+        --size_;
+    }
+
+    uint32_t pop_front(NodePool<Node>& pool)
+    {
+        const uint32_t i = front_;
+        if (i != kPolicyNil)
+            remove(pool, i);
+        return i;
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,244 @@
+#include "heavy_hitters.h"
+
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+
+namespace cmp_mem_engine
+{
+
+std::string HeavyHitter::head(const size_t len) const
+{
+    const size_t key_len = std::strlen(key);
+    const bool printable = std::all_of(key, key + key_len, [](const char c)
+    {
+        return std::isprint(static_cast<unsigned char>(c)) != 0;
+    });
+
+    if (printable)
+        return std::string(key, std::min(key_len, len));
+
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = 0; i != key_len && hex.size() + 2 <= len; ++i)
+    {
+        hex.push_back(kHex[static_cast<unsigned char>(key[i]) >> 4]);
+        hex.push_back(kHex[static_cast<unsigned char>(key[i]) & 0xf]);
+    }
+    return hex;
+}
+
+HeavyHitters::HeavyHitters(const size_t counter_num)
+    : counters_(counter_num), keys_(counter_num), buckets_(counter_num)
+{
+    // no more than half of the index is used
+    size_t index_size = 16;
+    while (index_size < counter_num * 2)
+        index_size *= 2;
+
+    index_.resize(index_size);
+
+    clear();
+}
+
+void HeavyHitters::clear()
+{
+    used_ = 0;
+    total_ = 0;
+
+    for (size_t b = 0; b != buckets_.size(); ++b)
+        buckets_[b].next = b + 1 == buckets_.size() ? kNil : static_cast<uint32_t>(b + 1);
+    free_bucket_ = 0;
+    min_bucket_ = kNil;
+    max_bucket_ = kNil;
+
+    std::fill(index_.begin(), index_.end(), kNil);
+}
+
+void HeavyHitters::add(const std::string& key, const uint64_t hash)
+{
+    ++total_;
+
+    size_t pos = find(hash);
+
+    if (index_[pos] != kNil)
+    {
+        increase(index_[pos]);
+        return;
+    }
+
+    uint32_t c;
+    if (used_ != counters_.size())
+    {
+        // a free counter, the count is 1
+        c = static_cast<uint32_t>(used_++);
+        counters_[c].hash = hash;
+        counters_[c].error = 0;
+
+        if (min_bucket_ != kNil && buckets_[min_bucket_].count == 1)
+            link(c, min_bucket_);
+        else
+            link(c, new_bucket(1, kNil, min_bucket_));
+    }
+    else
+    {
+        // take over a counter of the least count
+        c = buckets_[min_bucket_].first;
+        erase_index(find(counters_[c].hash));
+        pos = find(hash);
+
+        counters_[c].hash = hash;
+        counters_[c].error = buckets_[min_bucket_].count;
+        increase(c);
+    }
+
+    index_[pos] = c;
+
+    const size_t len = std::min(key.size(), kHeavyHitterKeyLen);
+    std::memcpy(keys_[c].data(), key.data(), len);
+    keys_[c][len] = '\0';
+}
+
+size_t HeavyHitters::top(HeavyHitter* out, const size_t n) const
+{
+    size_t cnt = 0;
+
+    for (uint32_t b = max_bucket_; b != kNil && cnt != n; b = buckets_[b].prev)
+    {
+        for (uint32_t c = buckets_[b].first; c != kNil && cnt != n; c = counters_[c].next)
+        {
+            std::memcpy(out[cnt].key, keys_[c].data(), sizeof(out[cnt].key));
+            out[cnt].count = buckets_[b].count;
+            out[cnt].error = counters_[c].error;
+            ++cnt;
+        }
+    }
+
+    return cnt;
+}
+
+size_t HeavyHitters::find(const uint64_t hash) const
+{
+    const size_t mask = index_.size() - 1;
+
+    size_t pos = home_of(hash);
+    while (index_[pos] != kNil && counters_[index_[pos]].hash != hash)
+        pos = (pos + 1) & mask;
+
+    return pos;
+}
+
+// backward shift deletion, so no tombstone for linear probing
+void HeavyHitters::erase_index(size_t pos)
+{
+    const size_t mask = index_.size() - 1;
+
+    index_[pos] = kNil;
+
+    for (size_t next = (pos + 1) & mask; index_[next] != kNil; next = (next + 1) & mask)
+    {
+        const size_t home = home_of(counters_[index_[next]].hash);
+
+        // the counter stays if its home is cyclically in (pos, next]
+        const bool stay = pos <= next ? (pos < home && home <= next) : (pos < home || home <= next);
+        if (stay)
+            continue;
+
+        index_[pos] = index_[next];
+        index_[next] = kNil;
+        pos = next;
+    }
+}
+
+// a bucket of count between prev and next (kNil for the ends)
+uint32_t HeavyHitters::new_bucket(const uint64_t count, const uint32_t prev, const uint32_t next)
+{
+    const uint32_t b = free_bucket_;
+    free_bucket_ = buckets_[b].next;
+
+    buckets_[b] = Bucket{count, kNil, prev, next};
+
+    if (prev != kNil)
+        buckets_[prev].next = b;
+    else
+        min_bucket_ = b;
+
+    if (next != kNil)
+        buckets_[next].prev = b;
+    else
+        max_bucket_ = b;
+
+    return b;
+}
+
+void HeavyHitters::link(const uint32_t c, const uint32_t b)
+{
+    Counter& counter = counters_[c];
+    counter.bucket = b;
+    counter.prev = kNil;
+    counter.next = buckets_[b].first;
+
+    if (counter.next != kNil)
+        counters_[counter.next].prev = c;
+    buckets_[b].first = c;
+}
+
+// unlink c from its bucket, and free the bucket if it is empty
+void HeavyHitters::unlink(const uint32_t c)
+{
+    const Counter& counter = counters_[c];
+    const uint32_t b = counter.bucket;
+
+    if (counter.prev != kNil)
+        counters_[counter.prev].next = counter.next;
+    else
+        buckets_[b].first = counter.next;
+
+    if (counter.next != kNil)
+        counters_[counter.next].prev = counter.prev;
+
+    if (buckets_[b].first != kNil)
+        return;
+
+    const Bucket& bucket = buckets_[b];
+    if (bucket.prev != kNil)
+        buckets_[bucket.prev].next = bucket.next;
+    else
+        min_bucket_ = bucket.next;
+
+    if (bucket.next != kNil)
+        buckets_[bucket.next].prev = bucket.prev;
+    else
+        max_bucket_ = bucket.prev;
+
+    buckets_[b].next = free_bucket_;
+    free_bucket_ = b;
+}
+
+// count + 1 for the counter c, O(1)
+void HeavyHitters::increase(const uint32_t c)
+{
+    const uint32_t b = counters_[c].bucket;
+    const uint64_t count = buckets_[b].count + 1;
+    const uint32_t next = buckets_[b].next;
+
+    if (next != kNil && buckets_[next].count == count)
+    {
+        unlink(c);
+        link(c, next);
+        return;
+    }
+
+    // the only one in its bucket, and the next bucket has more than count
+    if (counters_[c].prev == kNil && counters_[c].next == kNil)
+    {
+        buckets_[b].count = count;
+        return;
+    }
+
+    // the bucket b has other counters so it is not freed by unlink()
+    unlink(c);
+    link(c, new_bucket(count, b, next));
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <string>
+
+/* The Space-Saving sketch of the most frequent keys of a lookup stream (Metwally et al.).
+ *
+ * kHeavyHitterCounterNum counters, each one is (key, count, error). A key with a counter increases its count.
+ * A new key takes the counter of the least count c, its count is c + 1 and its error is c.
+ * So count - error <= the real count <= count, and any key more frequent than total / kHeavyHitterCounterNum has a counter.
+ *
+ * The counters of the same count are linked in one bucket, and the buckets are linked in the order of count
+ * (the Stream-Summary), so the least counter and one increase are O(1).
+ * The counters are found by the 64-bit hash of key (an open addressing index), the text of key is kept only for report.
+ * All memory is allocated in the constructor, add() never allocates.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kHeavyHitterCounterNum = 1024;
+// the keys longer than it are truncated in the report
+constexpr size_t kHeavyHitterKeyLen = 64;
+// the number of keys in LiveStats and in the report of a benchmark
+constexpr size_t kHeavyHitterTopNum = 8;
+
+// One key in the report, trivially copyable so it can be in LiveStats
+struct HeavyHitter
+{
+    char key[kHeavyHitterKeyLen + 1];   // NUL terminated
+    uint64_t count;                     // estimated
+    uint64_t error;                     // the estimation is over by no more than it
+
+    // the head of key for print, in hex if it is not all printable
+    std::string head(const size_t len) const;
+};
+
+class HeavyHitters
+{
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Counter
+    {
+        uint64_t hash;
+        uint64_t error;
+        uint32_t bucket;
+        uint32_t prev;                  // in the bucket
+        uint32_t next;
+    };
+
+    struct Bucket
+    {
+        uint64_t count;
+        uint32_t first;                 // counter
+        uint32_t prev;                  // the bucket of less count
+        uint32_t next;                  // the bucket of more count
+    };
+
+    std::vector<Counter> counters_;
+    std::vector<std::array<char, kHeavyHitterKeyLen + 1>> keys_;
+    size_t used_ = 0;
+
+    std::vector<Bucket> buckets_;
+    uint32_t free_bucket_ = kNil;
+    uint32_t min_bucket_ = kNil;
+    uint32_t max_bucket_ = kNil;
+
+    std::vector<uint32_t> index_;       // the counter of a hash, or kNil
+    uint64_t total_ = 0;
+
+public:
+    HeavyHitters(const HeavyHitters&) = delete;
+    HeavyHitters(HeavyHitters&&) = delete;
+    HeavyHitters& operator=(const HeavyHitters&) = delete;
+    HeavyHitters& operator=(HeavyHitters&&) = delete;
+
+    explicit HeavyHitters(const size_t counter_num = kHeavyHitterCounterNum);
+
+    // hash is std::hash<std::string> of key
+    void add(const std::string& key, const uint64_t hash);
+
+    void clear();
+
+    // the number of add()
+    uint64_t total() const
+    {
+        return total_;
+    }
+
+    // Write the top n keys by the estimated count to out (descending), return the number of them
+    size_t top(HeavyHitter* out, const size_t n) const;
+
+private:
+    size_t home_of(const uint64_t hash) const
+    {
+        return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> 32) & (index_.size() - 1);
+    }
+
+    size_t find(const uint64_t hash) const;
+    void erase_index(size_t pos);
+
+    uint32_t new_bucket(const uint64_t count, const uint32_t prev, const uint32_t next);
+    void link(const uint32_t c, const uint32_t b);
+    void unlink(const uint32_t c);
+    void increase(const uint32_t c);
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,110 @@
+#include "hot_set.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+namespace cmp_mem_engine
+{
+
+namespace
+{
+
+template <typename T>
+void append(std::vector<char>& buf, const T value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buf.insert(buf.end(), bytes, bytes + sizeof(value));
+}
+
+template <typename T>
+bool take(const std::vector<char>& buf, size_t& pos, T& value)
+{
+    if (buf.size() - pos < sizeof(value))
+        return false;
+
+    std::memcpy(&value, buf.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+}   // namespace
+
+bool write_hot_set(const char* path, const std::vector<const std::string*>& keys)
+{
+    std::vector<char> buf;
+    append(buf, kHotSetMagic);
+    append(buf, kHotSetVersion);
+    append(buf, static_cast<uint32_t>(keys.size()));
+    for (const std::string* key : keys)
+    {
+        append(buf, static_cast<uint32_t>(key->size()));
+        buf.insert(buf.end(), key->begin(), key->end());
+    }
+
+    const std::string tmp_path = std::string(path) + ".tmp";
+    FILE* file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cerr << "hot set open " << tmp_path << " failed, reason = " << std::strerror(errno) << '\n';
+        return false;
+    }
+
+    const bool written = std::fwrite(buf.data(), 1, buf.size(), file) == buf.size();
+    const bool closed = std::fclose(file) == 0;
+    if (!written || !closed || std::rename(tmp_path.c_str(), path) != 0)
+    {
+        std::cerr << "hot set write " << path << " failed, reason = " << std::strerror(errno) << '\n';
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool read_hot_set(const char* path, std::vector<std::string>& keys)
+{
+    keys.clear();
+
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    std::vector<char> buf;
+    char chunk[1<<16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) != 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+    std::fclose(file);
+
+    size_t pos = 0;
+    uint64_t magic = 0;
+    uint32_t version = 0;
+    uint32_t num = 0;
+    if (!take(buf, pos, magic) || magic != kHotSetMagic || !take(buf, pos, version) || version != kHotSetVersion
+        || !take(buf, pos, num))
+    {
+        std::cerr << "hot set " << path << " is not of version " << kHotSetVersion << '\n';
+        return false;
+    }
+
+    keys.reserve(num);
+    for (uint32_t i = 0; i != num; ++i)
+    {
+        uint32_t len = 0;
+        if (!take(buf, pos, len) || buf.size() - pos < len)
+        {
+            std::cerr << "hot set " << path << " is truncated at key " << i << '\n';
+            keys.clear();
+            return false;
+        }
+
+        keys.emplace_back(buf.data() + pos, len);
+        pos += len;
+    }
+
+    return true;
+}
+
+}   // namespace cmp_mem_engine
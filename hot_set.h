@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* The hot set of a cache for a warm restart: the hottest keys (the warm end of the SLRU protected segment)
+ * from the warmest, in a compact file of
+ *
+ *   kHotSetMagic (8 bytes), kHotSetVersion (4 bytes), the number of keys (4 bytes)
+ *   each key: its length (4 bytes) and its bytes
+ *
+ * No value is dumped, the values come from the cache itself or its backend at the next startup.
+ * The file is written to a temporary one then renamed, so a crash while dumping keeps the last one.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr uint64_t kHotSetMagic = 0x5453544f48504d43;     // "CMPHOTST"
+constexpr uint32_t kHotSetVersion = 1;
+constexpr size_t kHotSetMaxKeyNum = 1<<16;
+
+// Write keys (the warmest first) to path, return false if failed
+bool write_hot_set(const char* path, const std::vector<const std::string*>& keys);
+
+// Read the keys (the warmest first) of path to keys, return false if no file or it is not a hot set
+bool read_hot_set(const char* path, std::vector<std::string>& keys);
+
+}   // namespace cmp_mem_engine
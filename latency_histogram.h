@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+namespace cmp_mem_engine
+{
+
+// Log-linear histogram of nanoseconds (like HdrHistogram).
+// Each power of 2 is split to kSubBucketNum buckets, so the relative error of a value is less than 1/kSubBucketNum.
+// Fixed memory, record() is O(1) and never allocates, so it can be used in the hot loop.
+class LatencyHistogram
+{
+public:
+    static constexpr size_t kSubBucketBits = 4;
+    static constexpr size_t kSubBucketNum = 1 << kSubBucketBits;
+    static constexpr size_t kBucketNum = (64 - kSubBucketBits + 1) * kSubBucketNum;
+
+private:
+    std::array<uint64_t, kBucketNum> counts_;
+    uint64_t total_;
+    uint64_t max_;
+
+public:
+    LatencyHistogram()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        counts_.fill(0);
+        total_ = 0;
+        max_ = 0;
+    }
+
+    void record(const uint64_t ns)
+    {
+        ++counts_[index_of(ns)];
+        ++total_;
+        if (ns > max_)
+            max_ = ns;
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i != kBucketNum; ++i)
+        {
+            counts_[i] += other.counts_[i];
+        }
+
+        total_ += other.total_;
+        if (other.max_ > max_)
+            max_ = other.max_;
+    }
+
+    uint64_t count() const
+    {
+        return total_;
+    }
+
+    uint64_t max() const
+    {
+        return max_;
+    }
+
+    // p is in [0, 100], return the upper bound of the bucket where the percentile falls
+    uint64_t percentile(const double p) const
+    {
+        if (total_ == 0)
+            return 0;
+
+        uint64_t rank = static_cast<uint64_t>(p / 100 * static_cast<double>(total_));
+        if (rank == 0)
+            rank = 1;
+
+        uint64_t cnt = 0;
+        for (size_t i = 0; i != kBucketNum; ++i)
+        {
+            cnt += counts_[i];
+            if (cnt >= rank)
+                return value_of(i) < max_ ? value_of(i) : max_;
+        }
+
+        return max_;
+    }
+
+private:
+    static size_t index_of(const uint64_t v)
+    {
+        if (v < kSubBucketNum)
+            return static_cast<size_t>(v);
+
+        const size_t msb = 63 - static_cast<size_t>(__builtin_clzll(v));     // msb >= kSubBucketBits
+        const size_t shift = msb - kSubBucketBits;
+        const size_t sub = static_cast<size_t>(v >> shift) & (kSubBucketNum - 1);
+        return (shift + 1) * kSubBucketNum + sub;
+    }
+
+    // the largest value in the bucket of index
+    static uint64_t value_of(const size_t index)
+    {
+        if (index < kSubBucketNum)
+            return index;
+
+        const size_t shift = index / kSubBucketNum - 1;
+        const size_t sub = index % kSubBucketNum;
+        return ((static_cast<uint64_t>(kSubBucketNum + sub + 1)) << shift) - 1;
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,117 @@
+#include "live_stats.h"
+
+#include <iostream>
+#include <new>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace cmp_mem_engine
+{
+
+const char* kLiveStatsName = "/cmp_mem_engine_stats";
+
+LiveStats::~LiveStats()
+{
+    if (addr_ != nullptr)
+    {
+        munmap(addr_, size_);
+        shm_unlink(name_.c_str());
+    }
+}
+
+bool LiveStats::open(const char* name, const size_t max_block_num)
+{
+    assert(addr_ == nullptr && max_block_num > 0);
+
+    const size_t size = sizeof(LiveStatsHeader) + max_block_num * sizeof(LiveStatsBlock);
+
+    shm_unlink(name);       // the segment of the last process maybe has another layout
+
+    const int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd == -1)
+    {
+        std::cerr << "LiveStats shm_open " << name << " failed, reason = " << std::strerror(errno) << '\n';
+        return false;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        std::cerr << "LiveStats ftruncate failed, reason = " << std::strerror(errno) << '\n';
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        std::cerr << "LiveStats mmap failed, reason = " << std::strerror(errno) << '\n';
+        shm_unlink(name);
+        return false;
+    }
+
+    name_ = name;
+    addr_ = addr;
+    size_ = size;
+
+    // the segment is zero filled by ftruncate
+    LiveStatsHeader* h = new (addr_) LiveStatsHeader;
+    h->version = kLiveStatsVersion;
+    h->block_size = sizeof(LiveStatsBlock);
+    h->max_block_num = static_cast<uint32_t>(max_block_num);
+    h->block_num.store(0, std::memory_order_relaxed);
+    h->generation.store(0, std::memory_order_relaxed);
+    // the magic is the last one, the reader checks it first
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = kLiveStatsMagic;
+
+    return true;
+}
+
+void LiveStats::reset()
+{
+    if (addr_ == nullptr)
+        return;
+
+    header()->block_num.store(0, std::memory_order_release);
+    header()->generation.fetch_add(1, std::memory_order_release);
+}
+
+LiveStatsBlock* LiveStats::add_block(const LiveStatsRole role, const size_t id)
+{
+    if (addr_ == nullptr)
+        return nullptr;
+
+    LiveStatsHeader* h = header();
+    const uint32_t index = h->block_num.load(std::memory_order_relaxed);
+    if (index == h->max_block_num)
+        return nullptr;
+
+    LiveStatsBlock* blocks = reinterpret_cast<LiveStatsBlock*>(static_cast<char*>(addr_) + sizeof(LiveStatsHeader));
+    LiveStatsBlock* block = new (&blocks[index]) LiveStatsBlock;
+    block->role = role;
+    block->id = static_cast<uint32_t>(id);
+
+    h->block_num.store(index + 1, std::memory_order_release);
+
+    return block;
+}
+
+ProducerStats* LiveStats::add_producer(const size_t pid)
+{
+    LiveStatsBlock* block = add_block(LiveStatsRole::kProducer, pid);
+    return block == nullptr ? nullptr : &block->producer;
+}
+
+ConsumerStats* LiveStats::add_consumer(const size_t index)
+{
+    LiveStatsBlock* block = add_block(LiveStatsRole::kConsumer, index);
+    return block == nullptr ? nullptr : &block->consumer;
+}
+
+}   // namespace cmp_mem_engine
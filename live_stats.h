@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+#include "const_and_share_struct.h"
+#include "heavy_hitters.h"
+#include "policy_telemetry.h"
+
+/* The stats of producers and consumers can be published in a named shared memory segment,
+ * so a reader process (see stats_top.cc) can watch a running engine without stopping it.
+ *
+ * Layout (kLiveStatsVersion):
+ *   LiveStatsHeader                       one cache line
+ *   LiveStatsBlock[max_block_num]         each one is cache-line padded and owned by one thread
+ *
+ * The owner thread writes its stats by plain (non-atomic) stores as before.
+ * The reader only reads, so it may see a counter a little late, but never a torn one (aligned 8 bytes).
+ * If the layout of the structs below changes, kLiveStatsVersion must be increased.
+ */
+
+namespace cmp_mem_engine
+{
+
+struct ProducerStats
+{
+    size_t hit_cnt = 0;
+    size_t miss_cnt = 0;
+    size_t sleep_cnt = 0;
+    size_t request_wait_cnt = 0;
+    size_t request_wait_most = 0;
+    size_t result_wait_cnt = 0;
+    size_t result_wait_most = 0;
+    size_t bench_cnt = 0;
+    size_t cpu_ns = 0;          // the CPU time of the thread, written when the benchmark ends
+    size_t near_hit_cnt = 0;    // the keys answered by the near cache, without the consumer
+    size_t near_tx_cnt = 0;     // the transactions all answered by the near cache, without a round trip
+
+    int miss_percent() const
+    {
+        const size_t total = hit_cnt + miss_cnt;
+
+        return total == 0 ? 0 : static_cast<int>(miss_cnt * 100 / total);
+    }
+
+    int near_hit_percent() const
+    {
+        const size_t total = hit_cnt + miss_cnt;
+
+        return total == 0 ? 0 : static_cast<int>(near_hit_cnt * 100 / total);
+    }
+};
+
+struct ConsumerStats
+{
+    size_t bench_cnt = 0;
+    size_t hit_cnt = 0;
+    size_t miss_cnt = 0;
+    size_t wait_cnt = 0;
+    size_t sleep_cnt = 0;
+    // the time between the first request after idle and the next idle,
+    // so busy_ns / (elapsed time) is the utilization of the consumer
+    size_t busy_ns = 0;
+    size_t cpu_ns = 0;          // the CPU time of the thread, written when the thread exits
+    size_t batch_cnt = 0;       // the batches served, so bench_cnt / batch_cnt is the average batch size
+    size_t batch_wait_cnt = 0;  // the batches which waited to grow (see adaptive_batch.h)
+    size_t batch_wait_ns = 0;   // the total time of the waits
+    size_t dedup_cnt = 0;       // the requests served by the lookup of the same key in the batch
+    size_t expired_cnt = 0;     // the keys removed by the timer wheel when idle (see timer_wheel.h)
+    size_t load_cnt = 0;        // the misses loaded by the loader (see read_through.h)
+    size_t load_join_cnt = 0;   // the misses which joined a load of the same key in flight
+    size_t compute_cnt = 0;     // the compute requests (see compute_op.h), not counted in hit_cnt or miss_cnt
+    size_t compute_fail_cnt = 0;    // the compute requests not kOk, e.g., a kCas of an old version
+
+    // the most frequent keys of the cache (see heavy_hitters.h), refreshed now and then.
+    // top_seq is odd when the writer is refreshing, the reader should retry if it is odd or changed
+    uint64_t top_seq = 0;
+    size_t top_num = 0;
+    HeavyHitter top_keys[kHeavyHitterTopNum];
+
+    // the segments, moves and ages of the eviction policy of the cache (see policy_telemetry.h)
+    PolicyTelemetry policy;
+
+    // usually a few percent, so it is not rounded to int
+    double dedup_percent() const
+    {
+        return bench_cnt == 0 ? 0 : static_cast<double>(dedup_cnt) * 100 / static_cast<double>(bench_cnt);
+    }
+};
+
+constexpr uint64_t kLiveStatsMagic = 0x434d505354415453;     // "CMPSTATS"
+constexpr uint32_t kLiveStatsVersion = 10;
+constexpr size_t kLiveStatsMaxBlockNum = 1024;
+extern const char* kLiveStatsName;
+
+enum class LiveStatsRole : uint32_t
+{
+    kEmpty = 0, kProducer = 1, kConsumer = 2,
+};
+
+struct alignas(kCacheLineSize) LiveStatsHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t block_size;                // sizeof(LiveStatsBlock), the reader checks it
+    uint32_t max_block_num;
+    std::atomic<uint32_t> block_num;    // the number of published blocks
+    std::atomic<uint64_t> generation;   // increased for each run, the reader restarts its rates
+};
+
+struct alignas(kCacheLineSize) LiveStatsBlock
+{
+    LiveStatsRole role;
+    uint32_t id;                        // pid for producer, the index for consumer
+    ProducerStats producer;
+    ConsumerStats consumer;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the atomics in shared memory must be lock free");
+
+// The writer side, owned by main thread.
+// If open() fails (or is not called), add_xxx() returns nullptr and the threads keep their local stats.
+class LiveStats
+{
+private:
+    std::string name_;
+    void* addr_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    LiveStats() = default;
+    LiveStats(const LiveStats&) = delete;
+    LiveStats(LiveStats&&) = delete;
+    LiveStats& operator=(const LiveStats&) = delete;
+    LiveStats& operator=(LiveStats&&) = delete;
+
+    ~LiveStats() noexcept;
+
+    // create (or recreate) the shared memory segment of name, return false if failed
+    bool open(const char* name = kLiveStatsName, const size_t max_block_num = kLiveStatsMaxBlockNum);
+    bool is_open() const
+    {
+        return addr_ != nullptr;
+    }
+
+    // remove all blocks for a new run
+    void reset();
+
+    // Called by main thread before the thread starts, return nullptr if not open or full
+    ProducerStats* add_producer(const size_t pid);
+    ConsumerStats* add_consumer(const size_t index);
+
+private:
+    LiveStatsHeader* header() const
+    {
+        return static_cast<LiveStatsHeader*>(addr_);
+    }
+
+    LiveStatsBlock* add_block(const LiveStatsRole role, const size_t id);
+};
+
+}   // namespace cmp_mem_engine
@@ -9,6 +9,7 @@ namespace cmp_mem_engine
 {
 
 ShareData::ShareData(const size_t init_key_num, const size_t sample_key_num, std::vector<std::string>& samples)
+    : policy_(init_key_num)
 {
     assert(samples.empty());
 
@@ -17,7 +18,7 @@ ShareData::ShareData(const size_t init_key_num, const size_t sample_key_num, std
     key_vals_.reserve(init_key_num);
     samples.reserve(sample_key_num);
 
-    size_t sample_cnt = 0, protected_cnt = 0;
+    size_t sample_cnt = 0;
 
     for (size_t i = 0; i != init_key_num; ++i)
     {
@@ -35,19 +36,7 @@ ShareData::ShareData(const size_t init_key_num, const size_t sample_key_num, std
         if (inserted)
         {
             const std::string* key = &(it_map->first.real_key()); 
-            if (protected_cnt < kProtectSpace)
-            {
-                // insert to protected list
-                auto it_list = protected_list_.insert(protected_list_.end(), key);
-                it_map->second.set_list_iter(true, it_list);
-                ++protected_cnt;
-            }
-            else
-            {
-                // insert to probationary lisst
-                auto it_list = probationary_list_.insert(probationary_list_.end(), key);
-                it_map->second.set_list_iter(false, it_list);
-            }
+            it_map->second.policy_link = policy_.on_insert(key, std::hash<std::string>()(*key));
         }
     }
 }
@@ -72,35 +61,7 @@ std::string* ShareData::find_val(const std::string& key)
     }
     else
     {
-        bool is_protect = it->second.is_protected;
-        auto it_hit = it->second.it_list;
-
-        if (is_protect)
-        {
-            // if it_hit happens in protection 
-            // promote it_hit to the warmest in protection
-            protected_list_.splice(protected_list_.end(), protected_list_, it_hit);
-        }
-        else
-        {
-            // else it_hit happens in probation
-            if (protected_list_.size() < kProtectSpace)
-            {
-                // if protection is not full
-                // promote it_list from probation to the coldest in protection
-                protected_list_.splice(protected_list_.begin(), probationary_list_, it_hit);
-            }
-            else
-            {
-                // else protection is full
-                // demote the coldest in protection to the warmest in probation
-                auto it_coldest_in_protect = protected_list_.begin();
-                assert(it_coldest_in_protect != protected_list_.end());
-                probationary_list_.splice(probationary_list_.end(), protected_list_, it_coldest_in_protect);
-                // then promote it_hit from probation to the coldest in protection
-                protected_list_.splice(protected_list_.begin(), probationary_list_, it_hit);
-            }
-        }
+        policy_.on_hit(it->second.policy_link);
 
         return &it->second.val;
     }
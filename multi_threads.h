@@ -9,6 +9,7 @@
 
 #include "const_and_share_struct.h"
 #include "random_str.h"
+#include "policy_slru.h"
 
 namespace cmp_mem_engine
 {
@@ -17,9 +18,7 @@ class ShareData
 {
 private:
     std::unordered_map<HeapKey, CombinedVal> key_vals_;
-    // lists of cold(head) -> warm(tail)
-    std::list<const std::string*> protected_list_;
-    std::list<const std::string*> probationary_list_;
+    SlruPolicy policy_;
 
     mutable std::mutex mutex_;
 
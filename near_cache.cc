@@ -0,0 +1,123 @@
+#include "near_cache.h"
+
+namespace cmp_mem_engine
+{
+
+NearCache::NearCache(const VersionStripes& versions)
+    : versions_(versions), entries_(kNearCacheEntryNum)
+{
+    // no more than half of the index is used
+    size_t index_size = 16;
+    while (index_size < kNearCacheEntryNum * 2)
+        index_size *= 2;
+
+    index_.assign(index_size, kNil);
+}
+
+size_t NearCache::find(const std::string* key) const
+{
+    const size_t mask = index_.size() - 1;
+
+    size_t pos = home_of(key);
+    while (index_[pos] != kNil && entries_[index_[pos]].key != key)
+        pos = (pos + 1) & mask;
+
+    return pos;
+}
+
+const std::string* NearCache::lookup(const std::string* key)
+{
+    const uint32_t e = index_[find(key)];
+    if (e == kNil)
+        return nullptr;
+
+    Entry& entry = entries_[e];
+    if (entry.val == nullptr || versions_.version(entry.stripe) != entry.version)
+        return nullptr;
+
+    entry.referenced = true;
+    return entry.val;
+}
+
+void NearCache::reserve(const std::string* key)
+{
+    size_t pos = find(key);
+    if (index_[pos] != kNil)
+    {
+        Entry& entry = entries_[index_[pos]];
+
+        // keep the version of the earlier send which is not answered
+        if (entry.val != nullptr)
+        {
+            entry.val = nullptr;
+            entry.version = versions_.version(entry.stripe);
+        }
+        return;
+    }
+
+    uint32_t e;
+    if (used_ != entries_.size())
+    {
+        e = static_cast<uint32_t>(used_++);
+    }
+    else
+    {
+        e = evict_one();
+        pos = find(key);        // the index maybe shifted by the eviction
+    }
+
+    const uint32_t stripe = VersionStripes::stripe_of(*key);
+    entries_[e] = Entry{key, nullptr, stripe, versions_.version(stripe), false};
+    index_[pos] = e;
+}
+
+void NearCache::fill(const std::string* key, const std::string* val)
+{
+    const uint32_t e = index_[find(key)];
+    if (e != kNil)
+        entries_[e].val = val;
+}
+
+// CLOCK, return the free entry
+uint32_t NearCache::evict_one()
+{
+    while (true)
+    {
+        Entry& entry = entries_[hand_];
+        const size_t victim = hand_;
+        hand_ = (hand_ + 1) % entries_.size();
+
+        if (entry.referenced)
+        {
+            entry.referenced = false;
+            continue;
+        }
+
+        erase_index(find(entry.key));
+        return static_cast<uint32_t>(victim);
+    }
+}
+
+// backward shift deletion, so no tombstone for linear probing
+void NearCache::erase_index(size_t pos)
+{
+    const size_t mask = index_.size() - 1;
+
+    index_[pos] = kNil;
+
+    for (size_t next = (pos + 1) & mask; index_[next] != kNil; next = (next + 1) & mask)
+    {
+        const size_t home = home_of(entries_[index_[next]].key);
+
+        // the entry stays if its home is cyclically in (pos, next]
+        const bool stay = pos <= next ? (pos < home && home <= next) : (pos < home || home <= next);
+        if (stay)
+            continue;
+
+        index_[pos] = index_[next];
+        index_[next] = kNil;
+        pos = next;
+    }
+}
+
+}   // namespace cmp_mem_engine
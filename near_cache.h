@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <functional>
+
+/* A producer asks the consumer for the same hot keys again and again, each one is a cross-thread round trip.
+ * With a near cache, the producer keeps the recent answers (key -> value pointer) of its own,
+ * and sends only the keys which are not in it.
+ *
+ * The answers are invalidated by versions. The key space is split to kVersionStripeNum stripes by the hash of key,
+ * and the consumer bumps the version of the stripe when it writes or evicts a key of it,
+ * and when a key of it expires (its expired lookup, its removal by the timer wheel, or a shorter TTL).
+ * A near cache entry is valid only if its version is the same as the stripe's.
+ * The producer reads the version when it sends the key (not when the answer comes),
+ * so a write between the lookup of the consumer and the answer makes the entry invalid.
+ *
+ * A value pointer from the near cache has the same lifetime as a value pointer from the transport
+ * (see the lifetime of a result value in producer_consumer.h), a producer can not tell when it is freed.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kVersionStripeNum = 4096;
+static_assert((kVersionStripeNum & (kVersionStripeNum - 1)) == 0);
+
+// The entries of one near cache
+constexpr size_t kNearCacheEntryNum = 4096;
+
+// Shared by the consumers (writers) and the producers (readers) of one run
+class VersionStripes
+{
+private:
+    std::atomic<uint32_t> versions_[kVersionStripeNum] = {};
+
+public:
+    VersionStripes() = default;
+    VersionStripes(const VersionStripes&) = delete;
+    VersionStripes(VersionStripes&&) = delete;
+    VersionStripes& operator=(const VersionStripes&) = delete;
+    VersionStripes& operator=(VersionStripes&&) = delete;
+
+    static uint32_t stripe_of(const std::string& key)
+    {
+        return static_cast<uint32_t>((std::hash<std::string>()(key) * 0x9E3779B97F4A7C15ull) >> 32)
+                & (kVersionStripeNum - 1);
+    }
+
+    uint32_t version(const uint32_t stripe) const
+    {
+        return versions_[stripe].load(std::memory_order_acquire);
+    }
+
+    // Called by the consumer before the key is written or evicted
+    void bump(const std::string& key)
+    {
+        versions_[stripe_of(key)].fetch_add(1, std::memory_order_acq_rel);
+    }
+};
+
+/* The near cache of one producer, only touched by the producer thread.
+ *
+ * kNearCacheEntryNum entries evicted by CLOCK, and an open addressing index of the key pointers
+ * (the keys of a producer are its own strings, so the pointers are stable).
+ * An entry is reserved (no value) when the key is sent, and filled when the answer comes.
+ */
+class NearCache
+{
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Entry
+    {
+        const std::string* key = nullptr;
+        const std::string* val = nullptr;       // nullptr if reserved and not answered
+        uint32_t stripe = 0;
+        uint32_t version = 0;
+        bool referenced = false;
+    };
+
+    const VersionStripes& versions_;
+
+    std::vector<Entry> entries_;
+    size_t used_ = 0;
+    size_t hand_ = 0;
+
+    std::vector<uint32_t> index_;               // the entry of a key pointer, or kNil
+
+public:
+    NearCache() = delete;
+    NearCache(const NearCache&) = delete;
+    NearCache(NearCache&&) = delete;
+    NearCache& operator=(const NearCache&) = delete;
+    NearCache& operator=(NearCache&&) = delete;
+
+    explicit NearCache(const VersionStripes& versions);
+
+    // Return the value (kNotFound for a negative answer) if key has a valid answer, else nullptr
+    const std::string* lookup(const std::string* key);
+
+    // Called when key is sent to the consumer
+    void reserve(const std::string* key);
+
+    // Called when the answer of key comes, the reserved entry maybe has been evicted
+    void fill(const std::string* key, const std::string* val);
+
+private:
+    size_t home_of(const std::string* key) const
+    {
+        return static_cast<size_t>((reinterpret_cast<uintptr_t>(key) * 0x9E3779B97F4A7C15ull) >> 32)
+                & (index_.size() - 1);
+    }
+
+    // the position of key in index_, or the empty one where it should be
+    size_t find(const std::string* key) const;
+    uint32_t evict_one();
+    void erase_index(size_t pos);
+};
+
+}   // namespace cmp_mem_engine
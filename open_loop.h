@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+/* Open loop load: a producer issues its transactions on a schedule of a target rate,
+ * no matter how long the last transaction took.
+ * The latency of a transaction is measured from its intended send time (not the real send time),
+ * so the queueing delay when the consumer stalls is not hidden (i.e., no coordinated omission).
+ */
+
+namespace cmp_mem_engine
+{
+
+enum class Arrival
+{
+    kConstant, kPoisson,
+};
+
+struct OpenLoopConfig
+{
+    Arrival arrival = Arrival::kPoisson;
+    double tx_per_sec = 0;          // the target rate of transactions for one producer, 0 meaning closed loop
+    std::chrono::milliseconds duration = std::chrono::milliseconds(1000);
+};
+
+// The intended send time of the transactions, owned by one producer thread
+class ArrivalSchedule
+{
+private:
+    const Arrival arrival_;
+    const double mean_interval_ns_;
+
+    std::mt19937_64 generator_;
+    std::exponential_distribution<double> distribute_;
+
+    std::chrono::high_resolution_clock::time_point next_;
+
+public:
+    ArrivalSchedule(const size_t seed, const OpenLoopConfig& config,
+                    const std::chrono::high_resolution_clock::time_point start)
+        : arrival_(config.arrival), mean_interval_ns_(1e9 / config.tx_per_sec),
+          generator_(seed), distribute_(1.0), next_(start)
+    {}
+
+    // The intended send time of the next transaction
+    std::chrono::high_resolution_clock::time_point next()
+    {
+        const std::chrono::high_resolution_clock::time_point res = next_;
+
+        const double interval = arrival_ == Arrival::kConstant ? mean_interval_ns_
+                                                               : mean_interval_ns_ * distribute_(generator_);
+        next_ += std::chrono::nanoseconds(static_cast<long>(interval));
+
+        return res;
+    }
+
+    // Sleep if it is far away from intended, then spin for the accuracy.
+    // If it is already late, return immediately (the latency will include the lateness)
+    static void wait_until(const std::chrono::high_resolution_clock::time_point intended)
+    {
+        using namespace std::chrono_literals;
+
+        constexpr std::chrono::microseconds kSpinUs = 100us;
+
+        while (true)
+        {
+            const auto now = std::chrono::high_resolution_clock::now();
+            if (now >= intended)
+                return;
+
+            if (intended - now > kSpinUs)
+                std::this_thread::sleep_for(intended - now - kSpinUs);
+        }
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,30 @@
+#include "parker.h"
+
+#include <ctime>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace cmp_mem_engine
+{
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the futex word is a plain uint32_t");
+
+void Parker::park()
+{
+    constexpr long kTimeoutNs = std::chrono::nanoseconds(kParkTimeoutMs).count();
+    const timespec timeout{kTimeoutNs / 1'000'000'000, kTimeoutNs % 1'000'000'000};
+
+    // return immediately if a waker has cleared the word (EAGAIN)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sleeping_), FUTEX_WAIT_PRIVATE, 1, &timeout, nullptr, 0);
+
+    sleeping_.store(0, std::memory_order_relaxed);
+}
+
+void Parker::wake()
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sleeping_), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+}   // namespace cmp_mem_engine
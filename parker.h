@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+#include "const_and_share_struct.h"
+
+namespace cmp_mem_engine
+{
+
+// The longest time of one park, so a missed wakeup (e.g., the exit of the consumer) costs no more than it
+constexpr std::chrono::milliseconds kParkTimeoutMs = std::chrono::milliseconds(10);
+
+/* A futex word which one thread parks on, and the others unpark it.
+ *
+ * The waiter announces that it is going to sleep, polls once more, then parks.
+ * The waker publishes its work, then issues the wakeup only if the waiter has announced.
+ * Both sides have a full fence between their store and their load,
+ * so either the waiter sees the work in its last poll, or the waker sees the announcement.
+ *
+ * If no parking wait strategy is bound to the parker (see wait_strategy.h), unpark() does nothing,
+ * so the spinning modes do not pay for the fence.
+ */
+class alignas(kCacheLineSize) Parker
+{
+private:
+    std::atomic<uint32_t> sleeping_{0};
+    std::atomic<bool> enabled_{false};
+
+public:
+    Parker() = default;
+    Parker(const Parker&) = delete;
+    Parker(Parker&&) = delete;
+    Parker& operator=(const Parker&) = delete;
+    Parker& operator=(Parker&&) = delete;
+
+    // Called by the waiter before the threads of the others start
+    void enable()
+    {
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    // Called by the waiter, then it must poll once more before park()
+    void announce()
+    {
+        sleeping_.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    // Called by the waiter when it finds work after announce()
+    void cancel()
+    {
+        sleeping_.store(0, std::memory_order_relaxed);
+    }
+
+    // Called by the waiter after announce() and one more poll without work.
+    // Return when unparked or timeout, the announcement is cleared
+    void park();
+
+    // Called by the wakers after their work is published
+    void unpark()
+    {
+        if (!enabled_.load(std::memory_order_relaxed))
+            return;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed) != 0 && sleeping_.exchange(0, std::memory_order_relaxed) != 0)
+            wake();
+    }
+
+private:
+    void wake();
+};
+
+}   // namespace cmp_mem_engine
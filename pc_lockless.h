@@ -1,9 +1,10 @@
 #pragma once
 
 #include <string>
-#include <thread>
+#include <array>
 
-#include "const_and_share_struct.h"
+#include "producer_consumer.h"
+#include "doorbell.h"
 
 namespace cmp_mem_engine
 {
@@ -20,102 +21,207 @@ struct LocklessTasks
         }
     }
 
-    alignas(hardware_destructive_interference_size) std::atomic<const std::string*> request_keys[kLockLessArrayNum];
-    alignas(hardware_destructive_interference_size) std::atomic<const std::string*> result_vals[kLockLessArrayNum];
+    alignas(kCacheLineSize) std::atomic<const std::string*> request_keys[kLockLessArrayNum];
+    alignas(kCacheLineSize) std::atomic<const std::string*> result_vals[kLockLessArrayNum];
 };
 
-class ProducerLockless
+// One LocklessTasks for each producer, the producer pid uses producer_tasks[pid-1],
+// rings the doorbell of index pid-1 and parks on producer_parkers[pid-1]
+struct LocklessChannel
 {
-private:
-    RandomEngine re_;
-    std::thread thread_;
-
-    LocklessTasks& tasks_;
-
-    std::vector<std::string> hot_keys_;
-    std::vector<std::string> random_keys_;
-
-    size_t hit_cnt_ = 0;
-    size_t miss_cnt_ = 0;
-    std::chrono::high_resolution_clock::time_point time_start_;
-    std::chrono::high_resolution_clock::time_point time_end_;
-
-    size_t batch_request_wait_cnt_ = 0;
-    size_t batch_request_most_ = 0;
-    size_t batch_ressult_wait_cnt_ = 0;
-    size_t batch_result_most_ = 0;
-    size_t bench_cnt_ = 0;
-
-public:
-    ProducerLockless() = delete;
-    ProducerLockless(const ProducerLockless&) = delete;
-    ProducerLockless(ProducerLockless&&) = delete;
-    ProducerLockless& operator=(const ProducerLockless&) = delete;
-    ProducerLockless& operator=(ProducerLockless&&) = delete;
-
-    explicit ProducerLockless(const size_t pid, LocklessTasks& tasks, const std::vector<std::string>& samples);
-    ~ProducerLockless() noexcept;
-
-    int miss_percent() const;
-
-    void start_thread();
-    void wait_until_join();    
-
-    size_t get_bench_count() const;
-    std::tuple<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>
-    get_time_points() const;
-    std::tuple<size_t, size_t, size_t, size_t> get_batch_stats() const;
-
-    void debug_address_of_tasks() const;
-
-private:
-    void benchmark();
-    std::vector<const std::string*> prepare_input_keys(const size_t num);
-    void batch_keys(std::vector<const std::string*>& keys, const size_t debug_loop_no);
-
-    size_t fill_requests(std::vector<const std::string*>& keys, 
-                         std::array<bool, kLockLessArrayNum>& is_processing,
-                         std::array<const std::string*, kLockLessArrayNum>& processing_keys);
-    size_t avail_slot_in_requests(const std::array<bool, kLockLessArrayNum>& is_processing, const size_t start_slot) const;
-    size_t get_results(std::array<bool, kLockLessArrayNum>& is_processing,
-                       std::array<const std::string*, kLockLessArrayNum>& processing_keys);
+    explicit LocklessChannel(const size_t producer_num)
+        : producer_tasks(producer_num), doorbell(producer_num), producer_parkers(producer_num)
+    {}
+
+    std::vector<LocklessTasks> producer_tasks;
+    Doorbell doorbell;
+    Parker consumer_parker;
+    std::vector<Parker> producer_parkers;
 };
 
-class ConsumerLockless
+// Transport without lock, each producer has its own LocklessTasks.
+// A producer stores a key to a free slot of request_keys, 
+// the consumer takes it (clear the slot) and stores the result to the same slot of result_vals.
+struct LocklessTransport
 {
-private:
-    std::thread thread_;
+    using Channel = LocklessChannel;
 
-    SingleData& cache_;
-    std::array<LocklessTasks, kRunProducerNum>& producer_tasks_;
+    class ProducerEnd
+    {
+    private:
+        const size_t index_;
+        LocklessTasks& tasks_;
+        Doorbell& doorbell_;
+        Parker& consumer_parker_;
+        Parker& parker_;
+
+        // because consumer thread will clear tasks_.request_keys,
+        // remember the slots in processing and their keys
+        std::array<bool, kLockLessArrayNum> is_processing_;
+        std::array<const std::string*, kLockLessArrayNum> processing_keys_;
+
+    public:
+        ProducerEnd() = delete;
+        ProducerEnd(const ProducerEnd&) = delete;
+        ProducerEnd(ProducerEnd&&) = delete;
+        ProducerEnd& operator=(const ProducerEnd&) = delete;
+        ProducerEnd& operator=(ProducerEnd&&) = delete;
+
+        ProducerEnd(const size_t pid, LocklessChannel& channel);
+
+        Parker& parker()
+        {
+            return parker_;
+        }
+
+        bool can_send() const
+        {
+            return true;
+        }
 
-    size_t batch_cnt_ = 0;
-    size_t wait_cnt_ = 0;
+        // find some free slots in tasks_ and add some task (from keys[from]) to the tasks_
+        // return how many task have benn added for this turn
+        size_t send(const std::vector<const std::string*>& keys, const size_t from)
+        {
+            size_t cnt = 0;
+            size_t index = from;
 
-public:
-    ConsumerLockless() = delete;
-    ConsumerLockless(const ConsumerLockless&) = delete;
-    ConsumerLockless(ConsumerLockless&&) = delete;
-    ConsumerLockless& operator=(const ConsumerLockless&) = delete;
-    ConsumerLockless& operator=(ConsumerLockless&&) = delete;
+            for (size_t slot = 0; slot != kLockLessArrayNum && index != keys.size(); ++slot)
+            {
+                if (is_processing_[slot])
+                    continue;
 
-    ~ConsumerLockless() noexcept;
+                assert(tasks_.request_keys[slot].load(std::memory_order_relaxed) == nullptr);
 
-    ConsumerLockless(SingleData& cache, std::array<LocklessTasks, kRunProducerNum>& tasks);
+                const std::string* key = keys[index];
+                assert(key != nullptr);
+                tasks_.request_keys[slot].store(key, std::memory_order_release);    // for consumer thread
+                is_processing_[slot] = true;
+                processing_keys_[slot] = key;
 
-    void start_thread_loop();
-    void wait_until_join();
-    // called by main thread to signal consumer thread need to exit
-    void set_exit_task();
+                ++index;
+                ++cnt;
+            }
 
-    std::tuple<size_t, size_t> get_stats() const;
+            if (cnt != 0)
+            {
+                doorbell_.ring(index_);
+                consumer_parker_.unpark();
+            }
 
-private:
-    void consumer_thread_loop();
-    void clear_before_get_tasks(std::array<std::array<const std::string*, kLockLessArrayNum>, kRunProducerNum>& tasks) const;
-    size_t get_requests(std::array<std::array<const std::string*, kLockLessArrayNum>, kRunProducerNum>& tasks);
-    void procees_requests(const std::array<std::array<const std::string*, kLockLessArrayNum>, kRunProducerNum>& tasks);
-};
+            return cnt;
+        }
+
+        // Get results for those processing keys (check tasks_ which is served in consumer thread)
+        // After retrieve the results, free the slots for next round of send()
+        // Return how many requests have benn servered (i.e., have results)
+        template <typename F>
+        size_t receive(F&& on_result)
+        {
+            size_t cnt = 0;
+
+            for (size_t i = 0; i != kLockLessArrayNum; ++i)
+            {
+                if (!is_processing_[i])
+                    continue;
+
+                const std::string* result = tasks_.result_vals[i].load(std::memory_order_acquire);
+
+                if (result == nullptr)
+                    continue;   // consumer thread has not servered the tasks
+
+                on_result(processing_keys_[i], result);
+
+                // for next send()
+                assert(tasks_.request_keys[i].load(std::memory_order_relaxed) == nullptr);
+                is_processing_[i] = false;
+                processing_keys_[i] = nullptr;
+                tasks_.result_vals[i].store(nullptr, std::memory_order_relaxed);
+                ++cnt;
+            }
 
+            return cnt;
+        }
+    };
+
+    class ConsumerEnd
+    {
+    private:
+        std::vector<LocklessTasks>& producer_tasks_;
+        Doorbell& doorbell_;
+        Parker& parker_;
+        std::vector<Parker>& producer_parkers_;
+
+    public:
+        ConsumerEnd() = delete;
+        ConsumerEnd(const ConsumerEnd&) = delete;
+        ConsumerEnd(ConsumerEnd&&) = delete;
+        ConsumerEnd& operator=(const ConsumerEnd&) = delete;
+        ConsumerEnd& operator=(ConsumerEnd&&) = delete;
+
+        explicit ConsumerEnd(LocklessChannel& channel);
+
+        Parker& parker()
+        {
+            return parker_;
+        }
+
+        size_t capacity() const
+        {
+            return producer_tasks_.size() * kLockLessArrayNum;
+        }
+
+        // the handle is (i * kLockLessArrayNum + j) for the slot j of the producer i
+        size_t collect(ConsumerBatch& batch)
+        {
+            // check exit task first
+            if (producer_tasks_[0].request_keys[0].load(std::memory_order_relaxed) == 
+                reinterpret_cast<const std::string*>(kExitConsumerThreadTask))
+                return kPidMaxMeaninngExit;
+
+            size_t cnt = 0;
+
+            // only the producers which have rung
+            doorbell_.drain([this, &batch, &cnt](const size_t i)
+            {
+                for (size_t j = 0; j != kLockLessArrayNum; ++j)
+                {
+                    const std::string* task = producer_tasks_[i].request_keys[j].load(std::memory_order_acquire);
+                    if (task != nullptr)
+                    {
+                        batch.add(task, i * kLockLessArrayNum + j);
+                        producer_tasks_[i].request_keys[j].store(nullptr, std::memory_order_relaxed);
+                        ++cnt;
+                    }
+                }
+            });
+
+            return cnt;
+        }
+
+        void deliver(const ConsumerBatch& batch)
+        {
+            size_t last = producer_tasks_.size();
+            for (size_t k = 0; k != batch.size(); ++k)
+            {
+                const size_t i = batch.handles[k] / kLockLessArrayNum;
+                const size_t j = batch.handles[k] % kLockLessArrayNum;
+
+                assert(producer_tasks_[i].result_vals[j].load(std::memory_order_relaxed) == nullptr);
+                producer_tasks_[i].result_vals[j].store(batch.vals[k], std::memory_order_release);
+
+                // the slots of one producer are contiguous in the batch
+                if (i != last && last != producer_tasks_.size())
+                    producer_parkers_[last].unpark();
+                last = i;
+            }
+
+            if (last != producer_tasks_.size())
+                producer_parkers_[last].unpark();
+        }
+
+        void set_exit();
+    };
+};
 
-}   // end of namespace cmp_mem_engine
\ No newline at end of file
+}   // end of namespace cmp_mem_engine
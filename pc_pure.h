@@ -5,60 +5,103 @@
 namespace cmp_mem_engine
 {
 
-class ConsumerPure : public Consumer
+// Transport by the shared Tasks with lock.
+// Producers put keys to Tasks and loop to check whether the results come back.
+// The consumer loops to check Tasks for any unfinished task.
+struct PureTransport
 {
-private:
-    size_t sleep_cnt_ = 0;
-    size_t bench_cnt_ = 0;
-    size_t wait_try_cnt_ = 0;
-
-public:
-    ConsumerPure() = delete;
-    ConsumerPure(const ConsumerPure&) = delete;
-    ConsumerPure(ConsumerPure&&) = delete;
-    ConsumerPure& operator=(const ConsumerPure&) = delete;
-    ConsumerPure& operator=(ConsumerPure&&) = delete;
-
-    virtual ~ConsumerPure() = default;
-
-    ConsumerPure(SingleData& cache, Tasks& tasks);
-
-    std::tuple<size_t, size_t, size_t> get_stats() const;
-
-private:
-    void consumer_thread_loop_impl() override;
-    void set_exit_task_more() override;
-
-};
-
-class ProducerPure : public Producer
-{
-private:
-    const size_t pid_;
-
-    size_t hit_cnt_ = 0;
-    size_t miss_cnt_ = 0;
-    size_t sleep_cnt_ = 0;
-    size_t batch_fail_try_cnt_ = 0;
-    size_t batch_fail_try_most_ = 0;
-
-public:
-    ProducerPure() = delete;
-    ProducerPure(const ProducerPure&) = delete;
-    ProducerPure(ProducerPure&&) = delete;
-    ProducerPure& operator=(const ProducerPure&) = delete;
-    ProducerPure& operator=(ProducerPure&&) = delete;
-
-    virtual ~ProducerPure() = default;
-
-    explicit ProducerPure(const size_t pid, Tasks& tasks, const std::vector<std::string>& samples);
-
-    int miss_percent() const;
-    size_t sleep_count() const;
-    std::tuple<size_t, size_t> get_batch_fail_try_stats() const;
-
-private:
-    void batch_keys(std::vector<std::string*>& keys) override;    
+    using Channel = Tasks;
+
+    class ProducerEnd
+    {
+    private:
+        const size_t pid_;
+        Tasks& tasks_;
+
+        std::vector<Tasks::Output> outputs_;
+        size_t in_flight_ = 0;
+
+    public:
+        ProducerEnd() = delete;
+        ProducerEnd(const ProducerEnd&) = delete;
+        ProducerEnd(ProducerEnd&&) = delete;
+        ProducerEnd& operator=(const ProducerEnd&) = delete;
+        ProducerEnd& operator=(ProducerEnd&&) = delete;
+
+        ProducerEnd(const size_t pid, Tasks& tasks);
+
+        // the consumer unparks it when the results are ready
+        Parker& parker()
+        {
+            return tasks_.producer_parker(pid_);
+        }
+
+        // wait for all the answers of the last sending before sending more
+        bool can_send() const
+        {
+            return in_flight_ == 0;
+        }
+
+        size_t send(const std::vector<const std::string*>& keys, const size_t from)
+        {
+            const size_t input_num = tasks_.producer_process(pid_, keys, from);
+            in_flight_ += input_num;
+            return input_num;
+        }
+
+        template <typename F>
+        size_t receive(F&& on_result)
+        {
+            outputs_.clear();
+            tasks_.producer_process(pid_, outputs_);
+
+            for (const auto& output : outputs_)
+            {
+                on_result(output.key, output.val);
+            }
+
+            assert(outputs_.size() <= in_flight_);
+            in_flight_ -= outputs_.size();
+            return outputs_.size();
+        }
+    };
+
+    class ConsumerEnd
+    {
+    private:
+        Tasks& tasks_;
+
+    public:
+        ConsumerEnd() = delete;
+        ConsumerEnd(const ConsumerEnd&) = delete;
+        ConsumerEnd(ConsumerEnd&&) = delete;
+        ConsumerEnd& operator=(const ConsumerEnd&) = delete;
+        ConsumerEnd& operator=(ConsumerEnd&&) = delete;
+
+        explicit ConsumerEnd(Tasks& tasks);
+
+        Parker& parker()
+        {
+            return tasks_.consumer_parker();
+        }
+
+        size_t capacity() const
+        {
+            return kTaskLen;
+        }
+
+        size_t collect(ConsumerBatch& batch)
+        {
+            return tasks_.consumer_collect(batch);
+        }
+
+        void deliver(const ConsumerBatch& batch)
+        {
+            tasks_.consumer_deliver(batch, nullptr);
+        }
+
+        void set_exit();
+    };
 };
 
-}   // namespace of cmp_mem_engine
\ No newline at end of file
+}   // namespace of cmp_mem_engine
@@ -0,0 +1,49 @@
+#include "pc_ring.h"
+
+namespace cmp_mem_engine
+{
+
+RingChannel::RingChannel(const size_t producer_num, const size_t _depth)
+    : depth(_depth), doorbell(producer_num), own_producer_parkers(producer_num), producer_parkers(own_producer_parkers)
+{
+    producer_rings.reserve(producer_num);
+    for (size_t i = 0; i != producer_num; ++i)
+        producer_rings.push_back(std::make_unique<ProducerRings>(depth));
+}
+
+RingChannel::RingChannel(const size_t producer_num, std::vector<Parker>& shared_producer_parkers, const size_t _depth)
+    : depth(_depth), doorbell(producer_num), producer_parkers(shared_producer_parkers)
+{
+    assert(shared_producer_parkers.size() == producer_num);
+
+    producer_rings.reserve(producer_num);
+    for (size_t i = 0; i != producer_num; ++i)
+        producer_rings.push_back(std::make_unique<ProducerRings>(depth));
+}
+
+RingTransport::ProducerEnd::ProducerEnd(const size_t pid, RingChannel& channel)
+    : index_(pid-1), rings_(*channel.producer_rings.at(pid-1)), doorbell_(channel.doorbell),
+      consumer_parker_(channel.consumer_parker), parker_(channel.producer_parkers.at(pid-1)),
+      in_flight_keys_(channel.depth, nullptr)
+{
+    free_tags_.reserve(channel.depth);
+    for (size_t tag = channel.depth; tag != 0; --tag)
+        free_tags_.push_back(static_cast<uint32_t>(tag - 1));
+
+    requests_.reserve(channel.depth);
+}
+
+RingTransport::ConsumerEnd::ConsumerEnd(RingChannel& channel)
+    : channel_(channel)
+{
+    responses_.reserve(channel.depth);
+}
+
+// called by main thread after all producer threads exit
+void RingTransport::ConsumerEnd::set_exit()
+{
+    channel_.exit.store(true, std::memory_order_relaxed);
+    channel_.consumer_parker.unpark();
+}
+
+}   // end of namespace cmp_mem_engine
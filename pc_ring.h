@@ -0,0 +1,213 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "producer_consumer.h"
+#include "spsc_ring.h"
+#include "doorbell.h"
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kRingDepth = 64;      // the default depth, so one producer can have some transactions in flight
+static_assert((kRingDepth & (kRingDepth - 1)) == 0);
+
+// The tag is the index of the key in the in-flight table of the producer,
+// so the results can come back in any order
+struct RingRequest
+{
+    const std::string* key;
+    uint32_t tag;
+};
+
+struct RingResponse
+{
+    const std::string* val;
+    uint32_t tag;
+};
+
+// Every producer (thread) has one request ring and one response ring
+struct ProducerRings
+{
+    explicit ProducerRings(const size_t depth) : requests(depth), responses(depth)
+    {}
+
+    SpscRing<RingRequest> requests;
+    SpscRing<RingResponse> responses;
+};
+
+// The producer pid uses producer_rings[pid-1], rings the doorbell of index pid-1
+// and parks on producer_parkers[pid-1]
+struct RingChannel
+{
+    explicit RingChannel(const size_t producer_num, const size_t depth = kRingDepth);
+    // the producers park on shared_producer_parkers which the consumers of other channels unpark too
+    // (e.g., all shards of ShardedTransport), it must live longer than the channel
+    RingChannel(const size_t producer_num, std::vector<Parker>& shared_producer_parkers, const size_t depth = kRingDepth);
+
+    const size_t depth;
+    std::vector<std::unique_ptr<ProducerRings>> producer_rings;
+    Doorbell doorbell;
+    Parker consumer_parker;
+    std::vector<Parker> own_producer_parkers;       // empty if shared
+    std::vector<Parker>& producer_parkers;
+    alignas(kCacheLineSize) std::atomic<bool> exit{false};
+};
+
+// Transport by SPSC rings, each producer has its own request ring and response ring.
+// A producer has at most depth requests in flight, so the response ring is never full.
+// Compared to LocklessTransport (one slot for one key), each side publishes a batch at once.
+struct RingTransport
+{
+    using Channel = RingChannel;
+
+    class ProducerEnd
+    {
+    private:
+        const size_t index_;
+        ProducerRings& rings_;
+        Doorbell& doorbell_;
+        Parker& consumer_parker_;
+        Parker& parker_;
+
+        // the key of each tag in flight, and the free tags
+        std::vector<const std::string*> in_flight_keys_;
+        std::vector<uint32_t> free_tags_;
+
+        std::vector<RingRequest> requests_;
+
+    public:
+        ProducerEnd() = delete;
+        ProducerEnd(const ProducerEnd&) = delete;
+        ProducerEnd(ProducerEnd&&) = delete;
+        ProducerEnd& operator=(const ProducerEnd&) = delete;
+        ProducerEnd& operator=(ProducerEnd&&) = delete;
+
+        ProducerEnd(const size_t pid, RingChannel& channel);
+
+        Parker& parker()
+        {
+            return parker_;
+        }
+
+        bool can_send() const
+        {
+            return !free_tags_.empty();
+        }
+
+        // publish the keys from keys[from] as many as free tags and ring room, return the number sent
+        size_t send(const std::vector<const std::string*>& keys, const size_t from)
+        {
+            const size_t num = std::min(keys.size() - from, free_tags_.size());
+
+            requests_.clear();
+            for (size_t i = 0; i != num; ++i)
+            {
+                const uint32_t tag = free_tags_[free_tags_.size() - 1 - i];
+                requests_.push_back({keys[from + i], tag});
+            }
+
+            const size_t cnt = rings_.requests.push(requests_.data(), requests_.size());
+
+            for (size_t i = 0; i != cnt; ++i)
+            {
+                in_flight_keys_[requests_[i].tag] = requests_[i].key;
+                free_tags_.pop_back();
+            }
+
+            if (cnt != 0)
+            {
+                doorbell_.ring(index_);
+                consumer_parker_.unpark();
+            }
+
+            return cnt;
+        }
+
+        template <typename F>
+        size_t receive(F&& on_result)
+        {
+            return rings_.responses.pop(rings_.responses.depth(), [this, &on_result](const RingResponse& response)
+            {
+                on_result(in_flight_keys_[response.tag], response.val);
+                in_flight_keys_[response.tag] = nullptr;
+                free_tags_.push_back(response.tag);
+            });
+        }
+    };
+
+    class ConsumerEnd
+    {
+    private:
+        RingChannel& channel_;
+
+        std::vector<RingResponse> responses_;
+
+    public:
+        ConsumerEnd() = delete;
+        ConsumerEnd(const ConsumerEnd&) = delete;
+        ConsumerEnd(ConsumerEnd&&) = delete;
+        ConsumerEnd& operator=(const ConsumerEnd&) = delete;
+        ConsumerEnd& operator=(ConsumerEnd&&) = delete;
+
+        explicit ConsumerEnd(RingChannel& channel);
+
+        Parker& parker()
+        {
+            return channel_.consumer_parker;
+        }
+
+        size_t capacity() const
+        {
+            return channel_.producer_rings.size() * channel_.depth;
+        }
+
+        // the handle is (i * depth + tag) for the producer i,
+        // the requests of one producer are contiguous in the batch
+        size_t collect(ConsumerBatch& batch)
+        {
+            if (channel_.exit.load(std::memory_order_relaxed))
+                return kPidMaxMeaninngExit;
+
+            size_t cnt = 0;
+
+            // only the producers which have rung
+            channel_.doorbell.drain([this, &batch, &cnt](const size_t i)
+            {
+                const size_t base = i * channel_.depth;
+                cnt += channel_.producer_rings[i]->requests.pop(channel_.depth, [&batch, base](const RingRequest& request)
+                {
+                    batch.add(request.key, base + request.tag);
+                });
+            });
+
+            return cnt;
+        }
+
+        // one push for the responses of each producer
+        void deliver(const ConsumerBatch& batch)
+        {
+            size_t k = 0;
+            while (k != batch.size())
+            {
+                const size_t i = batch.handles[k] / channel_.depth;
+
+                responses_.clear();
+                for (; k != batch.size() && batch.handles[k] / channel_.depth == i; ++k)
+                    responses_.push_back({batch.vals[k], static_cast<uint32_t>(batch.handles[k] % channel_.depth)});
+
+                const size_t cnt = channel_.producer_rings[i]->responses.push(responses_.data(), responses_.size());
+                assert(cnt == responses_.size());
+                (void)cnt;
+
+                channel_.producer_parkers[i].unpark();
+            }
+        }
+
+        void set_exit();
+    };
+};
+
+}   // end of namespace cmp_mem_engine
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+#include "producer_consumer.h"
+
+namespace cmp_mem_engine
+{
+
+// kShardNum channels of Inner, the consumer k serves the keys of shard k by its own SingleData.
+// The producer pid parks on producer_parkers[pid-1] which the consumers of all shards unpark,
+// so Inner::Channel is constructed with the shared parkers (e.g., RingChannel)
+template <typename Inner, size_t kShardNum>
+struct ShardedChannel
+{
+    static_assert(std::is_constructible_v<typename Inner::Channel, size_t, std::vector<Parker>&>);
+
+    explicit ShardedChannel(const size_t producer_num) : producer_parkers(producer_num)
+    {
+        shards.reserve(kShardNum);
+        for (size_t k = 0; k != kShardNum; ++k)
+            shards.push_back(std::make_unique<typename Inner::Channel>(producer_num, producer_parkers));
+    }
+
+    std::vector<Parker> producer_parkers;
+    std::vector<std::unique_ptr<typename Inner::Channel>> shards;
+};
+
+// Shared-nothing mode: kShardNum consumer threads, each one owns the keys of shard_of(key, kShardNum).
+// A producer splits the keys of a transaction by shard and sends them to all consumers at once
+// by the Inner transport, then gathers the results.
+// Each consumer is the plain Consumer<Inner, Wait> on its own shard channel (see ConsumerSide below),
+// so every lookup is still single-threaded without lock.
+template <typename Inner, size_t kShardNum>
+struct ShardedTransport
+{
+    static_assert(kShardNum > 0);
+
+    using Channel = ShardedChannel<Inner, kShardNum>;
+
+    class ProducerEnd
+    {
+    private:
+        std::vector<std::unique_ptr<typename Inner::ProducerEnd>> ends_;
+
+        // the keys accepted but not sent yet of each shard, pending_[k][pending_from_[k], ...)
+        std::array<std::vector<const std::string*>, kShardNum> pending_;
+        std::array<size_t, kShardNum> pending_from_;
+        size_t pending_num_ = 0;
+
+    public:
+        ProducerEnd() = delete;
+        ProducerEnd(const ProducerEnd&) = delete;
+        ProducerEnd(ProducerEnd&&) = delete;
+        ProducerEnd& operator=(const ProducerEnd&) = delete;
+        ProducerEnd& operator=(ProducerEnd&&) = delete;
+
+        ProducerEnd(const size_t pid, Channel& channel)
+        {
+            ends_.reserve(kShardNum);
+            for (size_t k = 0; k != kShardNum; ++k)
+            {
+                ends_.push_back(std::make_unique<typename Inner::ProducerEnd>(pid, *channel.shards[k]));
+                pending_[k].reserve(kTransactionOneStepMostKeys);
+            }
+            pending_from_.fill(0);
+        }
+
+        // the same parker of all shards
+        Parker& parker()
+        {
+            return ends_[0]->parker();
+        }
+
+        bool can_send() const
+        {
+            return pending_num_ == 0;
+        }
+
+        // accept all keys (split by shard), and send as many as possible
+        size_t send(const std::vector<const std::string*>& keys, const size_t from)
+        {
+            for (size_t i = from; i != keys.size(); ++i)
+                pending_[shard_of(request_key(keys[i]), kShardNum)].push_back(keys[i]);
+
+            pending_num_ = keys.size() - from;
+            flush();
+
+            return keys.size() - from;
+        }
+
+        // send the pending keys first, then gather the results of all shards
+        template <typename F>
+        size_t receive(F&& on_result)
+        {
+            if (pending_num_ != 0)
+                flush();
+
+            size_t cnt = 0;
+            for (size_t k = 0; k != kShardNum; ++k)
+                cnt += ends_[k]->receive(on_result);
+
+            return cnt;
+        }
+
+    private:
+        void flush()
+        {
+            for (size_t k = 0; k != kShardNum; ++k)
+            {
+                if (pending_from_[k] == pending_[k].size() || !ends_[k]->can_send())
+                    continue;
+
+                const size_t sent = ends_[k]->send(pending_[k], pending_from_[k]);
+                pending_from_[k] += sent;
+                pending_num_ -= sent;
+
+                if (pending_from_[k] == pending_[k].size())
+                {
+                    pending_[k].clear();
+                    pending_from_[k] = 0;
+                }
+            }
+        }
+    };
+};
+
+template <typename Inner, size_t kShardNum>
+struct ConsumerSide<ShardedTransport<Inner, kShardNum>>
+{
+    using Transport = Inner;
+    static constexpr size_t kNum = kShardNum;
+
+    static typename Inner::Channel& channel(ShardedChannel<Inner, kShardNum>& channel, const size_t index)
+    {
+        return *channel.shards[index];
+    }
+};
+
+}   // namespace cmp_mem_engine
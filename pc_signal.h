@@ -1,83 +1,190 @@
 #pragma once
 
+#include <algorithm>
+
 #include "producer_consumer.h"
+#include "doorbell.h"
 
 namespace cmp_mem_engine
 {
 
 struct AlignAtomicBool
 {
-    // alignas(hardware_destructive_interference_size) std::atomic<bool> atomic_bool;
+    // alignas(kCacheLineSize) std::atomic<bool> atomic_bool;
     std::atomic<bool> atomic_bool;
 };
 
 struct TaskFlags
 {
-    std::array<AlignAtomicBool, cmp_mem_engine::kFixProducerNumber> flags;
-};
+    explicit TaskFlags(const size_t producer_num) : flags(producer_num)
+    {}
 
+    std::vector<AlignAtomicBool> flags;
+};
 
-class ConsumerSignal : public Consumer
+struct SignalChannel
 {
-private:
-    TaskFlags& task_flags_;
-
-    size_t wait_try_cnt_ = 0;
-    size_t sleep_cnt_ = 0;
-    size_t bench_cnt_ = 0;
-
-public:
-    ConsumerSignal() = delete;
-    ConsumerSignal(const ConsumerSignal&) = delete;
-    ConsumerSignal(ConsumerSignal&&) = delete;
-    ConsumerSignal& operator=(const ConsumerSignal&) = delete;
-    ConsumerSignal& operator=(ConsumerSignal&&) = delete;
-
-    virtual ~ConsumerSignal() = default;
-
-    ConsumerSignal(SingleData& cache, Tasks& tasks, TaskFlags& task_flags);
-
-    std::tuple<size_t, size_t, size_t> get_stats() const;
+    explicit SignalChannel(const size_t producer_num);
 
-private:
-    void consumer_thread_loop_impl() override;
-    void set_exit_task_more() override;
-
-private:
-    bool has_task_possible();
+    Tasks tasks;
+    TaskFlags task_flags;
+    Doorbell doorbell;
 };
 
-class ProducerSignal : public Producer
+// Transport by the shared Tasks with lock, plus one flag for each producer.
+// A producer sets its flag before putting keys in Tasks, 
+// rings the doorbell after that, then waits for the consumer to clear the flag which means the results are ready.
+// The consumer only checks Tasks if the doorbell has rung.
+struct SignalTransport
 {
-private:
-    const size_t pid_;
-
-    TaskFlags& task_flags_;
-
-    size_t hit_cnt_ = 0;
-    size_t miss_cnt_ = 0;
-    size_t sleep_cnt_ = 0;
-    size_t batch_fail_try_cnt_ = 0;
-    size_t batch_fail_try_most_ = 0;
-
-public:
-    ProducerSignal() = delete;
-    ProducerSignal(const ProducerSignal&) = delete;
-    ProducerSignal(ProducerSignal&&) = delete;
-    ProducerSignal& operator=(const ProducerSignal&) = delete;
-    ProducerSignal& operator=(ProducerSignal&&) = delete;
-
-    virtual ~ProducerSignal() = default;
-
-    ProducerSignal(const size_t pid, Tasks& tasks, const std::vector<std::string>& samples, 
-                  TaskFlags& task_flags);
-
-    int miss_percent() const;
-    size_t sleep_count() const;
-    std::tuple<size_t, size_t> get_batch_fail_try_stats() const;
-
-private:
-    void batch_keys(std::vector<std::string*>& keys) override;    
+    using Channel = SignalChannel;
+
+    // the flag of a producer is cleared once for all the results of its sending
+    static constexpr bool kWholeDelivery = true;
+
+    class ProducerEnd
+    {
+    private:
+        const size_t pid_;
+        Tasks& tasks_;
+        TaskFlags& task_flags_;
+        Doorbell& doorbell_;
+
+        std::vector<Tasks::Output> outputs_;
+        size_t in_flight_ = 0;
+
+    public:
+        ProducerEnd() = delete;
+        ProducerEnd(const ProducerEnd&) = delete;
+        ProducerEnd(ProducerEnd&&) = delete;
+        ProducerEnd& operator=(const ProducerEnd&) = delete;
+        ProducerEnd& operator=(ProducerEnd&&) = delete;
+
+        ProducerEnd(const size_t pid, SignalChannel& channel);
+
+        Parker& parker()
+        {
+            return tasks_.producer_parker(pid_);
+        }
+
+        // The flag can not tell which part of the sent keys are finished,
+        // so wait for all the answers of the last sending before sending more
+        bool can_send() const
+        {
+            return in_flight_ == 0;
+        }
+
+        size_t send(const std::vector<const std::string*>& keys, const size_t from)
+        {
+            // before put key in tasks, we need to set the flag to true to signal consumer thread
+            // the consumer thread maybe get no task associated with the produceer thread
+            // but it does not matter (because consumer is looping for the check)
+            assert(!task_flags_.flags[pid_-1].atomic_bool.load(std::memory_order_relaxed));     // init value must be false indicating no taks needs to be consumed
+            task_flags_.flags[pid_-1].atomic_bool.store(true, std::memory_order_relaxed);       // signal consumer thread
+
+            const size_t input_num = tasks_.producer_process(pid_, keys, from);
+
+            if (input_num == 0)
+            {
+                // the tasks are full (maybe by other producer or myself's previous part of batch keys)
+                task_flags_.flags[pid_-1].atomic_bool.store(false, std::memory_order_relaxed);
+            }
+            else
+            {
+                doorbell_.ring(pid_-1);
+            }
+
+            in_flight_ += input_num;
+            return input_num;
+        }
+
+        template <typename F>
+        size_t receive(F&& on_result)
+        {
+            // because we set task_flags_[pid_-1] of true before producer_process()
+            // so we can check it now for consumer signal backs
+            const bool signal_by_consumer = !task_flags_.flags[pid_-1].atomic_bool.load(std::memory_order_relaxed);
+            if (!signal_by_consumer)
+                return 0;
+
+            outputs_.clear();
+            tasks_.producer_process(pid_, outputs_);
+            assert(outputs_.size() == in_flight_);
+
+            for (const auto& output : outputs_)
+            {
+                on_result(output.key, output.val);
+            }
+
+            in_flight_ -= outputs_.size();
+            return outputs_.size();
+        }
+    };
+
+    class ConsumerEnd
+    {
+    private:
+        Tasks& tasks_;
+        TaskFlags& task_flags_;
+        Doorbell& doorbell_;
+
+        std::vector<bool> pids_;
+
+    public:
+        ConsumerEnd() = delete;
+        ConsumerEnd(const ConsumerEnd&) = delete;
+        ConsumerEnd(ConsumerEnd&&) = delete;
+        ConsumerEnd& operator=(const ConsumerEnd&) = delete;
+        ConsumerEnd& operator=(ConsumerEnd&&) = delete;
+
+        explicit ConsumerEnd(SignalChannel& channel);
+
+        Parker& parker()
+        {
+            return tasks_.consumer_parker();
+        }
+
+        size_t capacity() const
+        {
+            return kTaskLen;
+        }
+
+        size_t collect(ConsumerBatch& batch)
+        {
+            if (!has_task_possible())
+                return 0;
+
+            // NOTE: maybe no task for consumeer in tasks even has_task_possible() return true
+            return tasks_.consumer_collect(batch);
+        }
+
+        void deliver(const ConsumerBatch& batch)
+        {
+            std::fill(pids_.begin(), pids_.end(), false);
+            tasks_.consumer_deliver(batch, &pids_);
+
+            // deal with pids to let the producer know the tasks are finished by the consumer
+            for (size_t i = 0; i != pids_.size(); ++i)
+            {
+                if (pids_[i])
+                {
+                    // this producer need to be notified
+                    assert(task_flags_.flags[i].atomic_bool.load(std::memory_order_relaxed));
+                    task_flags_.flags[i].atomic_bool.store(false, std::memory_order_relaxed);
+                    tasks_.producer_parker(i+1).unpark();
+                }
+            }
+        }
+
+        void set_exit();
+
+    private:
+        // drain the doorbell, the requests of all producers which have rung are in tasks_ now
+        bool has_task_possible()
+        {
+            return doorbell_.drain([](const size_t) {}) != 0;
+        }
+    };
 };
 
-}   // namespace of cmp_mem_engine
\ No newline at end of file
+}   // namespace of cmp_mem_engine
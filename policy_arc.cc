@@ -0,0 +1,189 @@
+#include "policy_arc.h"
+
+#include <algorithm>
+
+namespace cmp_mem_engine
+{
+
+ArcPolicy::ArcPolicy(const size_t capacity)
+    : capacity_(capacity)
+{
+    nodes_.reserve(capacity * 2);
+}
+
+void ArcPolicy::set_capacity(const size_t capacity)
+{
+    capacity_ = capacity;
+    p_ = std::min(p_, capacity_);
+}
+
+ArcPolicy::ListId ArcPolicy::ghost_list_of(const uint64_t hash) const
+{
+    const auto it = ghosts_.find(hash);
+
+    return it == ghosts_.end() ? kT1 : nodes_[it->second].list;
+}
+
+void ArcPolicy::adapt(const ListId ghost)
+{
+    const size_t b1 = lists_[kB1].size();
+    const size_t b2 = lists_[kB2].size();
+
+    if (ghost == kB1)
+    {
+        const size_t delta = b1 >= b2 ? 1 : b2 / b1;
+        p_ = std::min(p_ + delta, capacity_);
+    }
+    else if (ghost == kB2)
+    {
+        const size_t delta = b2 >= b1 ? 1 : b1 / b2;
+        p_ = p_ - std::min(p_, delta);
+    }
+}
+
+void ArcPolicy::drop_ghost(const ListId ghost)
+{
+    const uint32_t i = lists_[ghost].pop_front(nodes_);
+    if (i == kPolicyNil)
+        return;
+
+    ghosts_.erase(nodes_[i].hash);
+    nodes_.free(i);
+}
+
+const std::string* ArcPolicy::evict(const ListId from, const bool to_ghost)
+{
+    const uint32_t i = lists_[from].pop_front(nodes_);
+    Node& node = nodes_[i];
+    const std::string* key = node.key;
+
+    ++telemetry_->evict_cnt;
+    count_sizes();
+
+    if (!to_ghost)
+    {
+        nodes_.free(i);
+        return key;
+    }
+
+    // a ghost of the same hash (a collision) is replaced
+    const ListId ghost = from == kT1 ? kB1 : kB2;
+    const auto [it, inserted] = ghosts_.insert({node.hash, i});
+    if (!inserted)
+    {
+        lists_[nodes_[it->second].list].remove(nodes_, it->second);
+        nodes_.free(it->second);
+        it->second = i;
+    }
+
+    node.key = nullptr;
+    node.list = ghost;
+    lists_[ghost].push_back(nodes_, i);
+    return key;
+}
+
+const std::string* ArcPolicy::replace(const bool in_b2)
+{
+    const size_t t1 = lists_[kT1].size();
+
+    if (t1 != 0 && (t1 > p_ || (in_b2 && t1 == p_) || lists_[kT2].empty()))
+        return evict(kT1, true);
+
+    return evict(kT2, true);
+}
+
+const std::string* ArcPolicy::victim(const uint64_t incoming_hash)
+{
+    if (lists_[kT1].empty() && lists_[kT2].empty())
+        return nullptr;
+
+    const ListId ghost = ghost_list_of(incoming_hash);
+    if (!adapted_ || adapted_hash_ != incoming_hash)
+    {
+        adapt(ghost);
+        adapted_ = true;
+        adapted_hash_ = incoming_hash;
+    }
+
+    if (ghost == kT1 && lists_[kT1].size() + lists_[kB1].size() >= capacity_)
+    {
+        // a new key and L1 is full
+        if (lists_[kT1].size() < capacity_)
+        {
+            drop_ghost(kB1);
+            return replace(false);
+        }
+
+        return evict(kT1, false);
+    }
+
+    return replace(ghost == kB2);
+}
+
+PolicyLink ArcPolicy::on_insert(const std::string* key, const uint64_t hash)
+{
+    const ListId ghost = ghost_list_of(hash);
+    if (!adapted_ || adapted_hash_ != hash)
+        adapt(ghost);
+    adapted_ = false;
+
+    if (ghost != kT1)
+    {
+        // a ghost hit, the node of the ghost is the node of the key in T2
+        const auto it = ghosts_.find(hash);
+        const uint32_t i = it->second;
+        ghosts_.erase(it);
+
+        lists_[ghost].remove(nodes_, i);
+        nodes_[i].key = key;
+        nodes_[i].list = kT2;
+        lists_[kT2].push_back(nodes_, i);
+        ++telemetry_->insert_cnt;
+        ++telemetry_->promote_cnt;
+        count_sizes();
+        return i;
+    }
+
+    // a new key, keep the directory no more than 2c
+    while (lists_[kB1].size() != 0 && lists_[kT1].size() + lists_[kB1].size() >= capacity_)
+        drop_ghost(kB1);
+    while (lists_[kB2].size() != 0 &&
+           lists_[kT1].size() + lists_[kT2].size() + lists_[kB1].size() + lists_[kB2].size() >= 2 * capacity_)
+        drop_ghost(kB2);
+
+    const uint32_t i = nodes_.alloc();
+    nodes_[i].key = key;
+    nodes_[i].hash = hash;
+    nodes_[i].list = kT1;
+    lists_[kT1].push_back(nodes_, i);
+    ++telemetry_->insert_cnt;
+    count_sizes();
+    return i;
+}
+
+void ArcPolicy::on_hit(const PolicyLink link)
+{
+    if (nodes_[link].list == kT2)
+    {
+        ++telemetry_->protected_hit_cnt;
+    }
+    else
+    {
+        ++telemetry_->probation_hit_cnt;
+        ++telemetry_->promote_cnt;
+    }
+
+    lists_[nodes_[link].list].remove(nodes_, link);
+    nodes_[link].list = kT2;
+    lists_[kT2].push_back(nodes_, link);
+    count_sizes();
+}
+
+void ArcPolicy::on_erase(const PolicyLink link)
+{
+    lists_[nodes_[link].list].remove(nodes_, link);
+    nodes_.free(link);
+    count_sizes();
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include "eviction_policy.h"
+
+/* ARC (Megiddo and Modha, FAST'03): T1 of the keys seen once recently, T2 of the keys seen at least twice,
+ * and their ghosts B1 and B2 (the hashes of the keys evicted from them), all LRU.
+ * The target size p of T1 adapts by the ghost hits: a hit in B1 means T1 should be larger, in B2 smaller.
+ * The victim is from T1 if it is over p, else from T2. |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c.
+ *
+ * The hit of a ghost is known when the key is inserted again, so victim() takes the hash of the incoming key
+ * (the adaptation must be done before the replacement), and on_insert() does it if victim() is not called.
+ */
+
+namespace cmp_mem_engine
+{
+
+class ArcPolicy : public PolicyTelemetryRef
+{
+private:
+    enum ListId : uint8_t
+    {
+        kT1, kT2, kB1, kB2,
+    };
+
+    struct Node
+    {
+        const std::string* key = nullptr;       // nullptr for a ghost
+        uint64_t hash = 0;
+        uint32_t prev = kPolicyNil;
+        uint32_t next = kPolicyNil;
+        ListId list = kT1;
+    };
+
+    size_t capacity_;
+    size_t p_ = 0;                              // the target size of T1
+
+    NodePool<Node> nodes_;
+    // LRU(front) -> MRU(back)
+    NodeList<Node> lists_[4];
+    std::unordered_map<uint64_t, uint32_t> ghosts_;     // hash -> the node in B1 or B2
+
+    bool adapted_ = false;                      // victim() has adapted p for adapted_hash_
+    uint64_t adapted_hash_ = 0;
+
+public:
+    static constexpr const char* kName = "arc";
+
+    ArcPolicy() = delete;
+    ArcPolicy(const ArcPolicy&) = delete;
+    ArcPolicy(ArcPolicy&&) = delete;
+    ArcPolicy& operator=(const ArcPolicy&) = delete;
+    ArcPolicy& operator=(ArcPolicy&&) = delete;
+
+    explicit ArcPolicy(const size_t capacity);
+    void set_capacity(const size_t capacity);
+
+    PolicyLink on_insert(const std::string* key, const uint64_t hash);
+    void on_hit(const PolicyLink link);
+    const std::string* victim(const uint64_t incoming_hash);
+    void on_erase(const PolicyLink link);
+
+private:
+    // the ghost list of hash, or kT1 if not a ghost
+    ListId ghost_list_of(const uint64_t hash) const;
+    void adapt(const ListId ghost);
+    void drop_ghost(const ListId ghost);
+    const std::string* replace(const bool in_b2);
+    const std::string* evict(const ListId from, const bool to_ghost);
+
+    void count_sizes()
+    {
+        telemetry_->protected_num = lists_[kT2].size();
+        telemetry_->probation_num = lists_[kT1].size();
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,216 @@
+#include "policy_lirs.h"
+
+#include <algorithm>
+
+namespace cmp_mem_engine
+{
+
+LirsPolicy::LirsPolicy(const size_t capacity)
+{
+    set_capacity(capacity);
+    nodes_.reserve(capacity * 2);
+}
+
+void LirsPolicy::set_capacity(const size_t capacity)
+{
+    capacity_ = capacity;
+    // at least one HIR key if the capacity is more than 1
+    lir_space_ = std::min(capacity * kLirsLirPercent / 100, std::max<size_t>(capacity, 2) - 1);
+
+    // a shrunk capacity demotes the LIR keys over it from the bottom of S, as an erase does
+    while (lir_num_ > lir_space_ && !stack_.empty())
+        demote_bottom();
+    count_sizes();
+}
+
+// move i to the top of S
+void LirsPolicy::push_top(const uint32_t i)
+{
+    if (nodes_[i].in_s)
+        stack_.remove(nodes_, i);
+
+    nodes_[i].in_s = true;
+    stack_.push_back(nodes_, i);
+}
+
+// the bottom LIR key becomes a resident HIR key at the end of Q
+void LirsPolicy::demote_bottom()
+{
+    const uint32_t bottom = stack_.front();
+    if (bottom == kPolicyNil)
+        return;
+
+    Node& node = nodes_[bottom];
+    node.state = kHir;
+    --lir_num_;
+    queue_.push_back(nodes_, bottom);
+    ++telemetry_->demote_cnt;
+    prune();
+}
+
+// remove the HIR keys at the bottom of S, so the bottom is a LIR key
+void LirsPolicy::prune()
+{
+    while (!stack_.empty())
+    {
+        const uint32_t bottom = stack_.front();
+        Node& node = nodes_[bottom];
+        if (node.state == kLir)
+            return;
+
+        stack_.remove(nodes_, bottom);
+        node.in_s = false;
+        if (node.state == kGhost)
+            drop_ghost(bottom);
+    }
+}
+
+void LirsPolicy::drop_ghost(const uint32_t i)
+{
+    Node& node = nodes_[i];
+    if (node.in_s)
+        stack_.remove(nodes_, i);
+
+    ghosts_.remove(nodes_, i);
+    ghost_index_.erase(node.hash);
+    nodes_.free(i);
+}
+
+PolicyLink LirsPolicy::on_insert(const std::string* key, const uint64_t hash)
+{
+    uint32_t i = kPolicyNil;
+
+    const auto it = ghost_index_.find(hash);
+    if (it != ghost_index_.end())
+    {
+        // a ghost in S, its IRR is less than the recency of the bottom LIR
+        i = it->second;
+        ghost_index_.erase(it);
+        ghosts_.remove(nodes_, i);
+    }
+    else
+    {
+        i = nodes_.alloc();
+        nodes_[i].hash = hash;
+    }
+
+    Node& node = nodes_[i];
+    node.key = key;
+    ++telemetry_->insert_cnt;
+
+    if (lir_num_ < lir_space_)
+    {
+        // not full of LIR keys yet
+        node.state = kLir;
+        ++lir_num_;
+        push_top(i);
+        count_sizes();
+        return i;
+    }
+
+    if (node.in_s)
+    {
+        node.state = kLir;
+        ++lir_num_;
+        push_top(i);
+        ++telemetry_->promote_cnt;
+        demote_bottom();
+        count_sizes();
+        return i;
+    }
+
+    node.state = kHir;
+    push_top(i);
+    queue_.push_back(nodes_, i);
+    count_sizes();
+    return i;
+}
+
+void LirsPolicy::on_hit(const PolicyLink link)
+{
+    Node& node = nodes_[link];
+
+    if (node.state == kLir)
+    {
+        ++telemetry_->protected_hit_cnt;
+        const bool was_bottom = stack_.front() == link;
+        push_top(link);
+        if (was_bottom)
+            prune();
+        return;
+    }
+
+    // a resident HIR key
+    ++telemetry_->probation_hit_cnt;
+    if (node.in_s)
+    {
+        node.state = kLir;
+        ++lir_num_;
+        queue_.remove(nodes_, link);
+        push_top(link);
+        ++telemetry_->promote_cnt;
+        demote_bottom();
+        count_sizes();
+        return;
+    }
+
+    push_top(link);
+    queue_.remove(nodes_, link);
+    queue_.push_back(nodes_, link);
+}
+
+const std::string* LirsPolicy::victim(const uint64_t)
+{
+    if (queue_.empty())
+    {
+        // all LIR, e.g., the capacity is decreased
+        if (stack_.empty())
+            return nullptr;
+        demote_bottom();
+    }
+
+    const uint32_t i = queue_.pop_front(nodes_);
+    Node& node = nodes_[i];
+    const std::string* key = node.key;
+    ++telemetry_->evict_cnt;
+    count_sizes();
+
+    if (!node.in_s)
+    {
+        nodes_.free(i);
+        return key;
+    }
+
+    // still in S, it becomes a ghost
+    node.key = nullptr;
+    node.state = kGhost;
+    const auto it = ghost_index_.find(node.hash);
+    if (it != ghost_index_.end())
+        drop_ghost(it->second);         // a ghost of the same hash (a collision) is replaced
+    ghost_index_.insert({node.hash, i});
+    ghosts_.push_back(nodes_, i);
+
+    while (ghosts_.size() > capacity_)
+        drop_ghost(ghosts_.front());
+
+    return key;
+}
+
+void LirsPolicy::on_erase(const PolicyLink link)
+{
+    Node& node = nodes_[link];
+
+    if (node.state == kLir)
+        --lir_num_;
+    else
+        queue_.remove(nodes_, link);
+
+    if (node.in_s)
+        stack_.remove(nodes_, link);
+
+    nodes_.free(link);
+    prune();
+    count_sizes();
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include "eviction_policy.h"
+
+/* LIRS (Jiang and Zhang, SIGMETRICS'02): the keys of low inter-reference recency (LIR, kLirsLirPercent of capacity)
+ * are kept, and the victims are from the resident keys of high IRR (HIR) only.
+ *
+ * The stack S is in the recency order of the LIR keys, the resident HIR keys and the non-resident HIR keys (ghosts),
+ * its bottom is always a LIR key (pruned). The queue Q is of the resident HIR keys, the victim is its front.
+ * A HIR key hit in S (its IRR is less than the recency of the bottom LIR) becomes LIR, and the bottom LIR becomes HIR.
+ * The ghosts are no more than capacity, the oldest one is dropped.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kLirsLirPercent = 99;
+
+class LirsPolicy : public PolicyTelemetryRef
+{
+private:
+    enum State : uint8_t
+    {
+        kLir, kHir, kGhost,
+    };
+
+    struct Node
+    {
+        const std::string* key = nullptr;       // nullptr for a ghost
+        uint64_t hash = 0;
+        uint32_t s_prev = kPolicyNil;           // in S
+        uint32_t s_next = kPolicyNil;
+        uint32_t q_prev = kPolicyNil;           // in Q if kHir, or in ghosts_ if kGhost
+        uint32_t q_next = kPolicyNil;
+        State state = kLir;
+        bool in_s = false;
+    };
+
+    using StackList = NodeList<Node, &Node::s_prev, &Node::s_next>;
+    using QueueList = NodeList<Node, &Node::q_prev, &Node::q_next>;
+
+    size_t capacity_;
+    size_t lir_space_;
+    size_t lir_num_ = 0;
+
+    NodePool<Node> nodes_;
+    StackList stack_;                           // bottom(front) -> top(back)
+    QueueList queue_;                           // front is the next victim
+    QueueList ghosts_;                          // oldest(front)
+    std::unordered_map<uint64_t, uint32_t> ghost_index_;
+
+public:
+    static constexpr const char* kName = "lirs";
+
+    LirsPolicy() = delete;
+    LirsPolicy(const LirsPolicy&) = delete;
+    LirsPolicy(LirsPolicy&&) = delete;
+    LirsPolicy& operator=(const LirsPolicy&) = delete;
+    LirsPolicy& operator=(LirsPolicy&&) = delete;
+
+    explicit LirsPolicy(const size_t capacity);
+    void set_capacity(const size_t capacity);
+
+    PolicyLink on_insert(const std::string* key, const uint64_t hash);
+    void on_hit(const PolicyLink link);
+    const std::string* victim(const uint64_t incoming_hash);
+    void on_erase(const PolicyLink link);
+
+private:
+    void push_top(const uint32_t i);
+    void demote_bottom();
+    void prune();
+    void drop_ghost(const uint32_t i);
+
+    void count_sizes()
+    {
+        telemetry_->protected_num = lir_num_;
+        telemetry_->probation_num = queue_.size();
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,110 @@
+#include "policy_s3fifo.h"
+
+#include <algorithm>
+
+namespace cmp_mem_engine
+{
+
+S3FifoPolicy::S3FifoPolicy(const size_t capacity)
+{
+    set_capacity(capacity);
+    nodes_.reserve(capacity);
+}
+
+void S3FifoPolicy::set_capacity(const size_t capacity)
+{
+    small_space_ = std::max<size_t>(capacity * kS3FifoSmallPercent / 100, 1);
+    ghost_space_ = capacity - std::min(capacity, small_space_);
+}
+
+PolicyLink S3FifoPolicy::on_insert(const std::string* key, const uint64_t hash)
+{
+    const uint32_t i = nodes_.alloc();
+    Node& node = nodes_[i];
+    node.key = key;
+    node.hash = hash;
+
+    // the ghost entry is left to age out
+    node.in_main = ghost_cnt_.count(hash) != 0;
+    if (node.in_main)
+        main_.push_back(nodes_, i);
+    else
+        small_.push_back(nodes_, i);
+
+    ++telemetry_->insert_cnt;
+    count_sizes();
+    return i;
+}
+
+const std::string* S3FifoPolicy::victim(const uint64_t)
+{
+    while (!small_.empty() || !main_.empty())
+    {
+        if (small_.size() >= small_space_ || main_.empty())
+        {
+            const uint32_t i = small_.pop_front(nodes_);
+            Node& node = nodes_[i];
+            if (node.freq != 0)
+            {
+                // hit in S, it is not a one-hit wonder
+                node.freq = 0;
+                node.in_main = true;
+                main_.push_back(nodes_, i);
+                ++telemetry_->promote_cnt;
+                continue;
+            }
+
+            add_ghost(node.hash);
+            nodes_.free(i);
+            ++telemetry_->evict_cnt;
+            count_sizes();
+            return node.key;
+        }
+
+        const uint32_t i = main_.pop_front(nodes_);
+        Node& node = nodes_[i];
+        if (node.freq != 0)
+        {
+            --node.freq;
+            main_.push_back(nodes_, i);
+            continue;
+        }
+
+        nodes_.free(i);
+        ++telemetry_->evict_cnt;
+        count_sizes();
+        return node.key;
+    }
+
+    return nullptr;
+}
+
+void S3FifoPolicy::on_erase(const PolicyLink link)
+{
+    if (nodes_[link].in_main)
+        main_.remove(nodes_, link);
+    else
+        small_.remove(nodes_, link);
+
+    nodes_.free(link);
+    count_sizes();
+}
+
+void S3FifoPolicy::add_ghost(const uint64_t hash)
+{
+    if (ghost_space_ == 0)
+        return;
+
+    ghost_.push_back(hash);
+    ++ghost_cnt_[hash];
+
+    while (ghost_.size() > ghost_space_)
+    {
+        const auto it = ghost_cnt_.find(ghost_.front());
+        if (--it->second == 0)
+            ghost_cnt_.erase(it);
+        ghost_.pop_front();
+    }
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+#include "eviction_policy.h"
+
+/* S3-FIFO (Yang et al., SOSP'23): three FIFO queues, a small one S of kS3FifoSmallPercent of capacity,
+ * a main one M, and a ghost one G of the hashes of the keys evicted from S (no more than the size of M).
+ *
+ * A hit only increases the 2-bit frequency of the key, no queue is touched, so a hit is cheap and
+ * could be lock-free in a concurrent cache.
+ * A new key goes to S, or to M if it is in G. The eviction takes the head of S when S is over its size:
+ * if it is hit in S it moves to M, else it is evicted to G. Otherwise the head of M is evicted if not hit,
+ * else it goes to the tail of M with one less frequency (like CLOCK).
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kS3FifoSmallPercent = 10;
+constexpr uint8_t kS3FifoMaxFreq = 3;
+
+class S3FifoPolicy : public PolicyTelemetryRef
+{
+private:
+    struct Node
+    {
+        const std::string* key = nullptr;
+        uint64_t hash = 0;
+        uint32_t prev = kPolicyNil;
+        uint32_t next = kPolicyNil;
+        uint8_t freq = 0;
+        bool in_main = false;
+    };
+
+    size_t small_space_;
+    size_t ghost_space_;
+
+    NodePool<Node> nodes_;
+    NodeList<Node> small_;
+    NodeList<Node> main_;
+
+    // FIFO of hashes, and the count of each hash in it
+    std::deque<uint64_t> ghost_;
+    std::unordered_map<uint64_t, uint32_t> ghost_cnt_;
+
+public:
+    static constexpr const char* kName = "s3-fifo";
+
+    S3FifoPolicy() = delete;
+    S3FifoPolicy(const S3FifoPolicy&) = delete;
+    S3FifoPolicy(S3FifoPolicy&&) = delete;
+    S3FifoPolicy& operator=(const S3FifoPolicy&) = delete;
+    S3FifoPolicy& operator=(S3FifoPolicy&&) = delete;
+
+    explicit S3FifoPolicy(const size_t capacity);
+    void set_capacity(const size_t capacity);
+
+    PolicyLink on_insert(const std::string* key, const uint64_t hash);
+
+    void on_hit(const PolicyLink link)
+    {
+        Node& node = nodes_[link];
+        if (node.freq < kS3FifoMaxFreq)
+            ++node.freq;
+
+        if (node.in_main)
+            ++telemetry_->protected_hit_cnt;
+        else
+            ++telemetry_->probation_hit_cnt;
+    }
+
+    const std::string* victim(const uint64_t incoming_hash);
+    void on_erase(const PolicyLink link);
+
+private:
+    void add_ghost(const uint64_t hash);
+
+    void count_sizes()
+    {
+        telemetry_->protected_num = main_.size();
+        telemetry_->probation_num = small_.size();
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,122 @@
+#include "policy_slru.h"
+
+namespace cmp_mem_engine
+{
+
+SlruPolicy::SlruPolicy(const size_t capacity, const size_t protect_percent)
+    : protect_percent_(protect_percent), protect_space_(capacity * protect_percent / 100)
+{
+    nodes_.reserve(capacity);
+}
+
+void SlruPolicy::set_capacity(const size_t capacity)
+{
+    // a larger protected segment than the new size shrinks by the demotions of the later hits
+    protect_space_ = capacity * protect_percent_ / 100;
+}
+
+PolicyLink SlruPolicy::on_insert(const std::string* key, const uint64_t)
+{
+    const uint32_t i = nodes_.alloc();
+    nodes_[i].key = key;
+
+    if (protected_list_.size() < protect_space_)
+    {
+        nodes_[i].is_protected = true;
+        protected_list_.push_back(nodes_, i);
+    }
+    else
+    {
+        nodes_[i].is_protected = false;
+        probationary_list_.push_back(nodes_, i);
+    }
+
+    ++telemetry_->insert_cnt;
+    count_sizes();
+    return i;
+}
+
+void SlruPolicy::on_hit(const PolicyLink link)
+{
+    Node& node = nodes_[link];
+
+    if (node.is_protected)
+    {
+        // if it happens in protection
+        // promote it to the warmest in protection
+        protected_list_.remove(nodes_, link);
+        protected_list_.push_back(nodes_, link);
+        ++telemetry_->protected_hit_cnt;
+        return;
+    }
+
+    // else it happens in probation
+    if (protected_list_.size() >= protect_space_ && !protected_list_.empty())
+    {
+        // protection is full, demote the coldest in protection to the warmest in probation
+        const uint32_t coldest = protected_list_.pop_front(nodes_);
+        nodes_[coldest].is_protected = false;
+        probationary_list_.push_back(nodes_, coldest);
+        ++telemetry_->demote_cnt;
+    }
+
+    // then promote it from probation to the coldest in protection
+    probationary_list_.remove(nodes_, link);
+    node.is_protected = true;
+    protected_list_.push_front(nodes_, link);
+    ++telemetry_->probation_hit_cnt;
+    ++telemetry_->promote_cnt;
+    count_sizes();
+}
+
+void SlruPolicy::preload(const PolicyLink link)
+{
+    Node& node = nodes_[link];
+
+    if (node.is_protected)
+    {
+        protected_list_.remove(nodes_, link);
+        protected_list_.push_back(nodes_, link);
+        return;
+    }
+
+    if (protected_list_.size() >= protect_space_ && !protected_list_.empty())
+    {
+        const uint32_t coldest = protected_list_.pop_front(nodes_);
+        nodes_[coldest].is_protected = false;
+        probationary_list_.push_back(nodes_, coldest);
+    }
+
+    probationary_list_.remove(nodes_, link);
+    node.is_protected = true;
+    protected_list_.push_back(nodes_, link);
+    count_sizes();
+}
+
+const std::string* SlruPolicy::victim(const uint64_t)
+{
+    NodeList<Node>& list = probationary_list_.empty() ? protected_list_ : probationary_list_;
+
+    const uint32_t i = list.pop_front(nodes_);
+    if (i == kPolicyNil)
+        return nullptr;
+
+    const std::string* key = nodes_[i].key;
+    nodes_.free(i);
+    ++telemetry_->evict_cnt;
+    count_sizes();
+    return key;
+}
+
+void SlruPolicy::on_erase(const PolicyLink link)
+{
+    if (nodes_[link].is_protected)
+        protected_list_.remove(nodes_, link);
+    else
+        probationary_list_.remove(nodes_, link);
+
+    nodes_.free(link);
+    count_sizes();
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "const_and_share_struct.h"
+#include "eviction_policy.h"
+
+/* Segmented LRU (the 2Q of this engine): a protected segment of kProtectPercent of capacity and a probationary one.
+ * A new key goes to the warm end of protected until it is full, then to the warm end of probation.
+ * A hit in protected moves the key to the warm end of protected,
+ * a hit in probation promotes the key to the cold end of protected (demoting the coldest protected one if full).
+ * The victim is the coldest in probation (or in protected if probation is empty).
+ *
+ * For a warm restart, walk_hot() gives the keys of protected from the warm end, and preload() rebuilds
+ * the order of protected by moving the keys to the warm end one by one (see CacheData::warm_up()).
+ */
+
+namespace cmp_mem_engine
+{
+
+class SlruPolicy : public PolicyTelemetryRef
+{
+private:
+    struct Node
+    {
+        const std::string* key = nullptr;
+        uint32_t prev = kPolicyNil;
+        uint32_t next = kPolicyNil;
+        bool is_protected = false;
+    };
+
+    const size_t protect_percent_;
+    size_t protect_space_;
+
+    NodePool<Node> nodes_;
+    // lists of cold(front) -> warm(back)
+    NodeList<Node> protected_list_;
+    NodeList<Node> probationary_list_;
+
+    void count_sizes()
+    {
+        telemetry_->protected_num = protected_list_.size();
+        telemetry_->probation_num = probationary_list_.size();
+    }
+
+public:
+    static constexpr const char* kName = "slru";
+
+    SlruPolicy() = delete;
+    SlruPolicy(const SlruPolicy&) = delete;
+    SlruPolicy(SlruPolicy&&) = delete;
+    SlruPolicy& operator=(const SlruPolicy&) = delete;
+    SlruPolicy& operator=(SlruPolicy&&) = delete;
+
+    // protect_percent of capacity is the protected segment
+    explicit SlruPolicy(const size_t capacity, const size_t protect_percent = kProtectPercent);
+    void set_capacity(const size_t capacity);
+
+    PolicyLink on_insert(const std::string* key, const uint64_t hash);
+    void on_hit(const PolicyLink link);
+    const std::string* victim(const uint64_t incoming_hash);
+    void on_erase(const PolicyLink link);
+
+    // Call on_key(key) for no more than max_num keys of protected from the warmest
+    template <typename F>
+    void walk_hot(const size_t max_num, F&& on_key) const
+    {
+        size_t cnt = 0;
+        for (uint32_t i = protected_list_.back(); i != kPolicyNil && cnt != max_num; i = nodes_[i].prev, ++cnt)
+            on_key(nodes_[i].key);
+    }
+
+    // Move the key to the warm end of protected (demoting the coldest protected one if full), not a hit
+    void preload(const PolicyLink link);
+};
+
+}   // namespace cmp_mem_engine
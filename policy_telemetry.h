@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* The telemetry of an eviction policy: the hits of its segments, the moves between them and the sampled ages.
+ *
+ * Each policy maps its own segments to protected (the keys proved hot: SLRU protected, S3-FIFO main, ARC T2, LIRS LIR)
+ * and probation (the others). A promotion moves a key to protected, a demotion moves one back.
+ *
+ * The age of a key is the number of lookups of the cache since it was inserted, sampled by AgeSampler
+ * for about 1 / kAgeSampleRate keys, in log2 buckets.
+ *
+ * PolicyTelemetry is trivially copyable and only has monotonic counters (and the two gauges of occupancy),
+ * so it can be in LiveStats and the reader gets a window by the difference of two reads.
+ * The writer is the owner thread of the cache, no lock and no allocation.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kAgeBucketNum = 40;
+
+struct PolicyTelemetry
+{
+    size_t protected_hit_cnt = 0;
+    size_t probation_hit_cnt = 0;
+    size_t promote_cnt = 0;
+    size_t demote_cnt = 0;
+    size_t insert_cnt = 0;
+    size_t evict_cnt = 0;
+
+    size_t protected_num = 0;           // the keys in the segments now
+    size_t probation_num = 0;
+
+    // the bucket i is of the ages in [2^(i-1), 2^i), the bucket 0 is of age 0
+    uint64_t hit_age[kAgeBucketNum] = {};
+    uint64_t evict_age[kAgeBucketNum] = {};
+
+    static size_t age_bucket(const uint64_t age)
+    {
+        const size_t bucket = age == 0 ? 0 : static_cast<size_t>(64 - __builtin_clzll(age));
+        return bucket < kAgeBucketNum ? bucket : kAgeBucketNum - 1;
+    }
+
+    // The upper bound of the bucket of percentile (0 - 100) of the ages in (a window of) buckets, 0 if empty
+    static uint64_t age_percentile(const uint64_t* buckets, const double percentile)
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i != kAgeBucketNum; ++i)
+            total += buckets[i];
+        if (total == 0)
+            return 0;
+
+        const double rank = static_cast<double>(total) * percentile / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i != kAgeBucketNum; ++i)
+        {
+            seen += buckets[i];
+            if (static_cast<double>(seen) >= rank)
+                return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+        }
+        return UINT64_MAX;
+    }
+};
+
+/* The insert times of the sampled keys by the key pointer, in a fixed open addressing table
+ * (no more than half full, the keys inserted when it is full are not sampled).
+ * A key is sampled by its hash, so a hit only probes the table if the key is sampled.
+ */
+class AgeSampler
+{
+private:
+    static constexpr size_t kSlotNum = 1<<14;
+    static constexpr uint64_t kSampleRate = 64;
+
+    struct Slot
+    {
+        const std::string* key = nullptr;
+        uint64_t born = 0;
+    };
+
+    std::vector<Slot> slots_;
+    size_t used_ = 0;
+
+public:
+    AgeSampler() : slots_(kSlotNum)
+    {}
+
+    AgeSampler(const AgeSampler&) = delete;
+    AgeSampler(AgeSampler&&) = delete;
+    AgeSampler& operator=(const AgeSampler&) = delete;
+    AgeSampler& operator=(AgeSampler&&) = delete;
+
+    static bool is_sampled(const uint64_t hash)
+    {
+        return ((hash >> 52) & (kSampleRate - 1)) == 0;
+    }
+
+    void on_insert(const std::string* key, const uint64_t hash, const uint64_t now)
+    {
+        if (!is_sampled(hash) || used_ * 2 >= kSlotNum)
+            return;
+
+        const size_t pos = find(key);
+        if (slots_[pos].key == nullptr)
+            ++used_;
+        slots_[pos] = Slot{key, now};
+    }
+
+    void on_hit(const std::string* key, const uint64_t hash, const uint64_t now, PolicyTelemetry& telemetry) const
+    {
+        if (!is_sampled(hash))
+            return;
+
+        const Slot& slot = slots_[find(key)];
+        if (slot.key != nullptr)
+            ++telemetry.hit_age[PolicyTelemetry::age_bucket(now - slot.born)];
+    }
+
+    // the key is evicted (telemetry is not nullptr) or removed otherwise
+    void on_remove(const std::string* key, const uint64_t now, PolicyTelemetry* telemetry)
+    {
+        if (used_ == 0)
+            return;
+
+        const size_t pos = find(key);
+        if (slots_[pos].key == nullptr)
+            return;
+
+        if (telemetry != nullptr)
+            ++telemetry->evict_age[PolicyTelemetry::age_bucket(now - slots_[pos].born)];
+        erase(pos);
+    }
+
+private:
+    static size_t home_of(const std::string* key)
+    {
+        return static_cast<size_t>((reinterpret_cast<uintptr_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) & (kSlotNum - 1);
+    }
+
+    size_t find(const std::string* key) const
+    {
+        size_t pos = home_of(key);
+        while (slots_[pos].key != nullptr && slots_[pos].key != key)
+            pos = (pos + 1) & (kSlotNum - 1);
+        return pos;
+    }
+
+    // backward shift deletion, so no tombstone for linear probing
+    void erase(size_t pos)
+    {
+        slots_[pos].key = nullptr;
+        --used_;
+
+        for (size_t next = (pos + 1) & (kSlotNum - 1); slots_[next].key != nullptr; next = (next + 1) & (kSlotNum - 1))
+        {
+            const size_t home = home_of(slots_[next].key);
+
+            // the slot stays if its home is cyclically in (pos, next]
+            const bool stay = pos <= next ? (pos < home && home <= next) : (pos < home || home <= next);
+            if (stay)
+                continue;
+
+            slots_[pos] = slots_[next];
+            slots_[next].key = nullptr;
+            pos = next;
+        }
+    }
+};
+
+}   // namespace cmp_mem_engine
@@ -11,332 +11,213 @@ namespace cmp_mem_engine
 
 const char* kNotFound = "Not Found Value";
 
-Tasks::Tasks()
+Tasks::Tasks(const size_t producer_num)
+    : done_(producer_num), producer_parkers_(producer_num), producer_num_(producer_num), deliver_masks_(producer_num, 0)
 {
+    assert(producer_num > 0);
+
     for (size_t i = 0; i != kTaskLen; ++i)
     {
         tasks_[i].key = nullptr;
         tasks_[i].val = nullptr;
         tasks_[i].pid = 0;
     }
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    const int res = pthread_spin_init(&spinlock_, PTHREAD_PROCESS_PRIVATE);
-    assert(res == 0);
-#endif
-}
-
-Tasks::~Tasks()
-{
-#ifdef USE_SPINLOCK_FOR_TASKS
-    const int res = pthread_spin_destroy(&spinlock_);
-    assert(res == 0);
-#endif
 }
 
-// caller guarantee to use lock
+// take all the results of pid which the consumer has done, and free their slots
 void Tasks::producer_dealwith_output(const size_t pid, std::vector<Output>& outputs)
 {
-    // caller must guarantee the outputs has accurate capacity (no need for memory allocation in lock)
+    // caller must guarantee the outputs has accurate capacity (no need for memory allocation)
     assert(outputs.empty() && outputs.capacity() == kTaskLen);
 
-    for (size_t i = 0; i != kTaskLen; ++i)
+    std::atomic<uint64_t>& done = done_[pid-1].bits;
+    if (done.load(std::memory_order_relaxed) == 0)
+        return;
+
+    const uint64_t mask = done.exchange(0, std::memory_order_acquire);
+
+    for (uint64_t bits = mask; bits != 0; bits &= bits - 1)
     {
-        if (pid != tasks_[i].pid)
-            continue;
+        const size_t i = static_cast<size_t>(__builtin_ctzll(bits));
+        assert(tasks_[i].pid == pid && tasks_[i].val != nullptr);
 
-        if (tasks_[i].val != nullptr)
-        {
-            // found consumer thread finish this task of the same pid
-            outputs.emplace_back(tasks_[i].key, tasks_[i].val);
+        outputs.emplace_back(tasks_[i].key, tasks_[i].val);
 
-            tasks_[i].pid = 0;
-            tasks_[i].key = nullptr;
-            tasks_[i].val = nullptr;
-        }
+        tasks_[i].pid = 0;
+        tasks_[i].key = nullptr;
+        tasks_[i].val = nullptr;
+    }
+
+    // the slots can be claimed by others now
+    occupied_.fetch_and(~mask, std::memory_order_seq_cst);
+
+    // wake up the producers which are waiting for free slots
+    if (full_.load(std::memory_order_seq_cst) && full_.exchange(false, std::memory_order_relaxed))
+    {
+        for (Parker& parker : producer_parkers_)
+            parker.unpark();
     }
 }
 
-// calleer guarantee to use lock, return how many input keys input to tasks (from begin)
+// return how many input keys input to tasks (from input_keys[from])
 // return the number of task putting into task_, 0 meaning the task_ is full 
-// NOTE: The caller needs guarantee input_keys is not empty
-size_t Tasks::producer_dealwith_input(const size_t pid, const std::vector<std::string*>& input_keys)
+// NOTE: The caller needs guarantee from < input_keys.size()
+size_t Tasks::producer_dealwith_input(const size_t pid, const std::vector<const std::string*>& input_keys, const size_t from)
 {
     assert(pid != kPidZeroMeaningEmpty);
 
-    // find the first index position in tasks_ which is empty
-    size_t index = kTaskLen;
-    for (size_t i = 0; i != kTaskLen; ++i)
+    const size_t want = input_keys.size() - from;
+
+    // claim the lowest free slots as many as want
+    uint64_t occupied = occupied_.load(std::memory_order_relaxed);
+    uint64_t claim;
+    do
     {
-        if (tasks_[i].pid == kPidZeroMeaningEmpty)
+        claim = 0;
+        uint64_t free_bits = ~occupied & kAllSlots;
+        for (size_t n = 0; n != want && free_bits != 0; ++n)
         {
-            index = i;
-            break;
+            claim |= free_bits & (~free_bits + 1);      // the lowest free bit
+            free_bits &= free_bits - 1;
         }
-    }
 
-    if (index == kTaskLen)
-        return 0;       // tasks_ is full
+        if (claim == 0)
+        {
+            // tasks_ is full, the producer taking its results will unpark me
+            full_.store(true, std::memory_order_seq_cst);
+            return 0;
+        }
+    }
+    while (!occupied_.compare_exchange_weak(occupied, occupied | claim,
+                                            std::memory_order_acquire, std::memory_order_relaxed));
 
-    // tasks_ is not empty from index position
     size_t cnt = 0;
-    for (size_t i = 0; i != input_keys.size(); ++i)
+    for (uint64_t bits = claim; bits != 0; bits &= bits - 1)
     {
+        const size_t index = static_cast<size_t>(__builtin_ctzll(bits));
+
         assert(tasks_[index].pid == kPidZeroMeaningEmpty);
         assert(tasks_[index].key == nullptr);
         assert(tasks_[index].val == nullptr);
 
         tasks_[index].pid = pid;
-        tasks_[index].key = input_keys[i];
+        tasks_[index].key = input_keys[from + cnt];
         ++cnt;
-
-        // find next available index
-        for (index = index + 1; index != kTaskLen; ++index)
-        {
-            if (tasks_[index].pid  == kPidZeroMeaningEmpty)
-                break;
-        }
-
-        if (index == kTaskLen)
-            break;      // reach the end of tasks_, i.e., tasks_ is full
     }
 
+    // publish to the consumer
+    ready_.fetch_or(claim, std::memory_order_release);
+    consumer_parker_.unpark();
+
     return cnt;
 }
 
 // only for outputs
 void Tasks::producer_process(const size_t pid, std::vector<Output>& outputs)
 {
-    assert(pid != kPidZeroMeaningEmpty && pid != kPidMaxMeaninngExit);
+    assert(pid != kPidZeroMeaningEmpty && pid <= producer_num_);
     assert(outputs.empty());
 
-#ifdef USE_SPINLOCK_FOR_TASKS
-    int res = pthread_spin_lock(&spinlock_);
-    assert(res == 0);
-#else
-    std::lock_guard<std::mutex> lk(mutex_);
-#endif
-
     producer_dealwith_output(pid, outputs);
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_unlock(&spinlock_);
-    assert(res == 0);
-#endif
 }
 
 // only for inputs
-size_t Tasks::producer_process(const size_t pid, const std::vector<std::string*>& input_keys)
+size_t Tasks::producer_process(const size_t pid, const std::vector<const std::string*>& input_keys, const size_t from)
 {
-    assert(pid != kPidZeroMeaningEmpty && pid != kPidMaxMeaninngExit);
-    assert(!input_keys.empty());
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    int res = pthread_spin_lock(&spinlock_);
-    assert(res == 0);
-#else
-    std::lock_guard<std::mutex> lk(mutex_);
-#endif
+    assert(pid != kPidZeroMeaningEmpty && pid <= producer_num_);
+    assert(from < input_keys.size());
 
-    const size_t num = producer_dealwith_input(pid, input_keys);
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_unlock(&spinlock_);
-    assert(res == 0);
-#endif
-
-    return num;
+    return producer_dealwith_input(pid, input_keys, from);
 }
 
 // both: inputs and outputs
-size_t Tasks::producer_process(const size_t pid, 
-                               const std::vector<std::string*>& input_keys, std::vector<Output>& outputs)
+size_t Tasks::producer_process(const size_t pid, const std::vector<const std::string*>& input_keys, const size_t from,
+                               std::vector<Output>& outputs)
 {
-    assert(pid != kPidZeroMeaningEmpty && pid != kPidMaxMeaninngExit);
-    assert(!input_keys.empty() && outputs.empty());
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    int res = pthread_spin_lock(&spinlock_);
-    assert(res == 0);
-#else
-    std::lock_guard<std::mutex> lk(mutex_);
-#endif
+    assert(pid != kPidZeroMeaningEmpty && pid <= producer_num_);
+    assert(from < input_keys.size() && outputs.empty());
 
     // deal output first (so we can make some task empty for the following input step)
     producer_dealwith_output(pid, outputs);
 
     // then deal input
-    const size_t num = producer_dealwith_input(pid, input_keys);
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_unlock(&spinlock_);
-    assert(res == 0);
-#endif
-
-    return num;
+    return producer_dealwith_input(pid, input_keys, from);
 }
 
 void Tasks::add_exit_task()
 {
-#ifdef USE_SPINLOCK_FOR_TASKS
-    int res = pthread_spin_lock(&spinlock_);
-    assert(res == 0);
-#else
-    std::lock_guard<std::mutex> lk(mutex_);
-#endif
-
-    assert(tasks_[0].pid == kPidZeroMeaningEmpty 
-           && tasks_[0].key == nullptr
-           && tasks_[0].val == nullptr);      // must be available, usually all task are finished and taken
-
-    tasks_[0].pid = kPidMaxMeaninngExit;
-
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_unlock(&spinlock_);
-    assert(res == 0);
-#endif
+    // usually all task are finished and taken
+    assert(occupied_.load(std::memory_order_relaxed) == 0);
+
+    exit_.store(true, std::memory_order_release);
+    consumer_parker_.unpark();
 }
 
-/* The caller guarantee pids are all false before call-in 
- * If one pid is processed, set pids[pid-1] to true,
- * so the caller (consumer) can signal the assocaated producers to process in async way
- * if pids is not nullptr (i.e., if pids is nullptr, the producer/consumer does not care) */
-size_t Tasks::consumer_process(SingleData &cache, std::array<bool, kFixProducerNumber>* pids)
+// Take all published tasks to batch (with the index in tasks_ as the handle)
+size_t Tasks::consumer_collect(ConsumerBatch& batch)
 {
-    std::array<const std::string*, kTaskLen> keys;
-    std::array<size_t, kTaskLen> indexs;
-    
-    // First take some unfinished tasks
-    size_t consumed_cnt = 0;
-#ifdef USE_SPINLOCK_FOR_TASKS
-    int res = pthread_spin_lock(&spinlock_);
-    assert(res == 0);
-#else
-    std::unique_lock<std::mutex> lk(mutex_);
-#endif
-    for (size_t i = 0; i != kTaskLen; ++i)
-    {
-        if (tasks_[i].pid == kPidMaxMeaninngExit)
-            return kPidMaxMeaninngExit;
+    if (exit_.load(std::memory_order_relaxed))
+        return kPidMaxMeaninngExit;
 
-        if (tasks_[i].pid == kPidZeroMeaningEmpty)
-            continue;
+    // read first, so the idle consumer does not write the cache line
+    if (ready_.load(std::memory_order_relaxed) == 0)
+        return 0;
 
-        if (tasks_[i].val != nullptr)
-            continue;       // not taken by producer, i.e., the task already done by consumer
+    const uint64_t ready = ready_.exchange(0, std::memory_order_acquire);
 
-        keys[consumed_cnt] = tasks_[i].key;
-        indexs[consumed_cnt] = i;
-        ++consumed_cnt;
-    }
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_unlock(&spinlock_);
-    assert(res == 0);
-#else
-    lk.unlock();
-#endif
-
-    if (consumed_cnt == 0)
-        return 0;       // no any one available task
-
-    // Second, find the results in cache without lock
-    std::array<const std::string*, kTaskLen> vals;
-    for (size_t i = 0; i != consumed_cnt; ++i)
+    size_t consumed_cnt = 0;
+    for (uint64_t bits = ready; bits != 0; bits &= bits - 1)
     {
-        const std::string& key = *keys[i];
-        const std::string* val = cache.find_val(key);
+        const size_t i = static_cast<size_t>(__builtin_ctzll(bits));
+        assert(tasks_[i].pid != kPidZeroMeaningEmpty && tasks_[i].val == nullptr);
 
-        if (val == nullptr)
-        {
-            // not found, but we can not put nullptr in vals, using an literal pointer instead
-            vals[i] = reinterpret_cast<const std::string*>(kNotFound);
-        }
-        else
-        {
-            vals[i] = val;
-        }
+        batch.add(tasks_[i].key, i);
+        ++consumed_cnt;
     }
 
-    // Last, lock for write results to tasks_
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_lock(&spinlock_);
-    assert(res == 0);
-#else
-    lk.lock();
-#endif
-    for (size_t i = 0; i != consumed_cnt; ++i)
+    return consumed_cnt;
+}
+
+/* The caller guarantee pids are all false before call-in 
+ * If one pid is processed, set pids[pid-1] to true,
+ * so the caller (consumer) can signal the assocaated producers to process in async way
+ * if pids is not nullptr (i.e., if pids is nullptr, the producer/consumer does not care) */
+void Tasks::consumer_deliver(const ConsumerBatch& batch, std::vector<bool>* pids)
+{
+    assert(batch.vals.size() == batch.size());
+
+    for (size_t i = 0; i != batch.size(); ++i)
     {
-        const size_t index = indexs[i];
+        const size_t index = batch.handles[i];
 
-        assert(tasks_[index].key == keys[i]);
+        assert(tasks_[index].key == batch.keys[i]);
         assert(tasks_[index].val == nullptr);
-        assert(vals[i] != nullptr);
+        assert(batch.vals[i] != nullptr);
 
-        tasks_[index].val = vals[i];
+        tasks_[index].val = batch.vals[i];
         const size_t pid = tasks_[index].pid;
         assert(pid != kPidZeroMeaningEmpty);
-        if (pids != nullptr)
-            (*pids)[pid-1] = true;
+        deliver_masks_[pid-1] |= uint64_t(1) << index;
     }
-#ifdef USE_SPINLOCK_FOR_TASKS
-    res = pthread_spin_unlock(&spinlock_);
-    assert(res == 0);
-#else
-    lk.unlock();
-#endif
 
-    return consumed_cnt;
-}
-
-Consumer::Consumer(SingleData& cache, Tasks& tasks) 
-    : cache_(cache), tasks_(tasks)
-{}
-
-Consumer::~Consumer()
-{
-    try
+    // one atomic operation for each producer of the batch
+    for (size_t i = 0; i != producer_num_; ++i)
     {
-        wait_until_join();
-    }
-    catch (std::system_error& e)
-    {
-        std::cerr << "~Consumer thread join failed, reason = " << e.what() << '\n';
-    }
-}
-
-void Consumer::consumer_thread_loop()
-{
-    consumer_thread_loop_impl();
-}
-
-size_t Consumer::process(std::array<bool, kFixProducerNumber>* pids)
-{
-    return tasks_.consumer_process(cache_, pids);
-}
-
-void Consumer::start_thread_loop()
-{
-    // std::thread t(consumer_thread_loop, std::ref(cache_), std::ref(tasks_), std::ref(task_flags_));
-    std::thread t(&Consumer::consumer_thread_loop, this);
-    thread_ = std::move(t);
-}
+        if (deliver_masks_[i] == 0)
+            continue;
 
-void Consumer::wait_until_join()
-{
-    if (thread_.joinable())
-        thread_.join();
-}
+        done_[i].bits.fetch_or(deliver_masks_[i], std::memory_order_release);
+        deliver_masks_[i] = 0;
 
-void Consumer::set_exit_task()
-{
-    tasks_.add_exit_task();
-    
-    set_exit_task_more();
+        if (pids != nullptr)
+            (*pids)[i] = true;
+        else
+            producer_parkers_[i].unpark();
+    }
 }
 
-
-Producer::Producer(const size_t pid, Tasks& tasks, const std::vector<std::string>& samples)
-    : re_(pid), tasks_(tasks)
+KeySampler::KeySampler(const size_t seed, const std::vector<std::string>& samples)
+    : re_(seed)
 {
     hot_keys_ = samples;
 
@@ -350,25 +231,17 @@ Producer::Producer(const size_t pid, Tasks& tasks, const std::vector<std::string
     }
 }
 
-Producer::~Producer()
+size_t KeySampler::rand_batch_num()
 {
-    try
-    {
-        wait_until_join();
-    }
-    catch(std::system_error& e)
-    {
-        std::cerr << "~Producer() failed when join, reason = " << e.what() << '\n';
-    }
+    return re_.rand_size_scope(kTransactionOneStepLeastKeys, kTransactionOneStepMostKeys+1);
 }
 
-// allocating memory is OK for producer before call producer_process()
-std::vector<std::string*> Producer::prepare_input_keys(const size_t num)
+// allocating memory is OK for producer before sending the keys
+void KeySampler::prepare_input_keys(const size_t num, std::vector<const std::string*>& keys)
 {
     assert(num > 0);
 
-    std::vector<std::string*> keys;
-    keys.reserve(num);
+    keys.clear();
 
     for (size_t i = 0; i != num; ++i)
     {
@@ -384,74 +257,6 @@ std::vector<std::string*> Producer::prepare_input_keys(const size_t num)
             keys.emplace_back(&random_keys_[index]);
         }
     }
-
-    return keys;
-}
-
-// allocatimng memory is OK for producer before call producer_process() 
-std::vector<Tasks::Output> Producer::prepare_outputs() const
-{
-    std::vector<Tasks::Output> outputs;
-    outputs.reserve(kTaskLen);
-    return outputs;
-}
-
-size_t Producer::process(const size_t pid, const std::vector<std::string*>& input_keys)
-{
-    return tasks_.producer_process(pid, input_keys);
-}
-
-void Producer::process(const size_t pid, std::vector<Tasks::Output>& outputs)
-{
-    tasks_.producer_process(pid, outputs);
-}
-
-
-void Producer::benchmark()
-{
-    using namespace std::chrono_literals;
-
-    time_start_ = std::chrono::high_resolution_clock::now();
-
-    size_t cnt = 0;
-
-    while (cnt < kBenchmarkCount)
-    {
-        // We assume each step of a transaction need to read [kTransactionOneStepLeastKeys, kTransactionOneStepMostKeys] keys
-        const size_t key_batch_num = re_.rand_size_scope(kTransactionOneStepLeastKeys, kTransactionOneStepMostKeys+1);
-        auto keys = prepare_input_keys(key_batch_num);
-
-        batch_keys(keys);
-
-        cnt += key_batch_num;
-    }
-
-    time_end_ = std::chrono::high_resolution_clock::now();
-
-    bench_cnt_ = cnt;
-}
-
-std::tuple<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>
-Producer::get_time_points() const
-{
-    return {time_start_, time_end_};
-}
-
-size_t Producer::get_bench_count() const
-{
-    return bench_cnt_;
-}
-
-void Producer::start_thread()
-{
-    std::thread t(&Producer::benchmark, this);
-    thread_ = std::move(t);
-}
-
-void Producer::wait_until_join()
-{
-    if (thread_.joinable())
-        thread_.join();
 }
 
 }   // cmp_mem_engine
\ No newline at end of file
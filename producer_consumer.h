@@ -1,19 +1,124 @@
 #pragma once
 
-#include <mutex>
+#include <array>
+#include <vector>
+#include <atomic>
 #include <thread>
+#include <chrono>
+#include <tuple>
+#include <memory>
+#include <iostream>
 
 #include <pthread.h>
 
 #include "const_and_share_struct.h"
-
+#include "cache_data.h"
+#include "wait_strategy.h"
+#include "open_loop.h"
+#include "adaptive_batch.h"
+#include "batch_dedup.h"
+#include "near_cache.h"
+#include "latency_histogram.h"
+#include "live_stats.h"
+#include "trace.h"
+#include "read_through.h"
+
+
+/* Producer<Transport, Wait> and Consumer<Transport, Wait> are templates.
+ * The Transport policy is how the keys go from producers to the consumer and the results come back,
+ * the Wait policy (see wait_strategy.h) is what to do for a round of no progress.
+ * Each combination gets its own fully inlined hot loop, no virtual call at all.
+ *
+ * A Transport policy is a class with three members:
+ *
+ *   using Channel = ...;     The shared struct between producers and the consumer, 
+ *                            constructed by main thread as Channel(producer_num), pid is in [1, producer_num]
+ *
+ *   class ProducerEnd        Owned by one producer thread
+ *       ProducerEnd(const size_t pid, Channel& channel);
+ *       Parker& parker();                 // unparked by the consumer when results are delivered
+ *       bool can_send() const;
+ *       // send keys[from, ...) as many as possible, return how many keys have been sent (0 meaning full)
+ *       size_t send(const std::vector<const std::string*>& keys, const size_t from);
+ *       // call on_result(key, val) for each result, return how many results have been received
+ *       // (see the lifetime of val below)
+ *       template <typename F> size_t receive(F&& on_result);
+ *
+ *   class ConsumerEnd        Owned by the consumer thread
+ *       explicit ConsumerEnd(Channel& channel);
+ *       Parker& parker();                 // unparked by the producers when requests are sent
+ *       size_t capacity() const;          // the most requests in one batch
+ *       // add the requests to batch, return the number of them, or kPidMaxMeaninngExit for exit
+ *       size_t collect(ConsumerBatch& batch);
+ *       void deliver(const ConsumerBatch& batch);
+ *       void set_exit();                  // called by main thread
+ *
+ * The val of a result is kNotFound, or points to the value in the cache of the consumer, which the consumer
+ * frees or changes when the key is evicted, expired, loaded again or written (by a compute request).
+ * The producer can not see when, so it may read *val only if the cache releases no value while it reads
+ * (CacheData::released_val_num() does not change, e.g., no capacity, no loader, no TTL and no write).
+ * Otherwise val is only a hit/miss answer, and the value is read by ComputeOp::kGets, which copies it.
+ *
+ * A key pointer may be a tagged compute request (see compute_op.h), a transport which reads the key
+ * gets it by request_key().
+ *
+ *   static constexpr bool kWholeDelivery = true;
+ *                            Optional, if defined, the producer takes the results of one sending all at once,
+ *                            so the consumer can not answer a part of them later (e.g., by a loader)
+ *
+ * See pc_pure.h, pc_signal.h, pc_lockless.h and pc_ring.h
+ */
 
 namespace cmp_mem_engine
 {
 
+// The requests which the consumer takes in one round.
+// handles[i] is the reply address of keys[i] which only the transport understands
+struct ConsumerBatch
+{
+    explicit ConsumerBatch(const size_t capacity)
+    {
+        keys.reserve(capacity);
+        handles.reserve(capacity);
+        vals.reserve(capacity);
+    }
+
+    size_t size() const
+    {
+        return keys.size();
+    }
+
+    void add(const std::string* key, const size_t handle)
+    {
+        keys.push_back(key);
+        handles.push_back(handle);
+    }
+
+    void clear()
+    {
+        keys.clear();
+        handles.clear();
+        vals.clear();
+    }
+
+    std::vector<const std::string*> keys;
+    std::vector<size_t> handles;
+    std::vector<const std::string*> vals;
+};
+
+/* The shared slots of all producers, without lock.
+ *
+ *   occupied_   bit i is set when a producer claims slot i (CAS), and cleared when it takes the result
+ *   ready_      bit i is set when the request in slot i is published, the consumer takes all by one exchange
+ *   done_[pid]  bit i is set when the result of slot i is written, the producer pid takes all by one exchange
+ *
+ * So a producer finds free slots by ctz of ~occupied_ and its results without scanning the others,
+ * and the consumer gets all requests by one atomic operation.
+ */
 class Tasks
 {
 public:
+    // val is kNotFound or the value in the cache, see the lifetime of a result value above
     struct Output
     {
         explicit Output(const std::string* k, const std::string* v) : key(k), val(v)
@@ -24,6 +129,8 @@ public:
     };
 
 private:
+    // the fields are owned by the claiming producer, or the consumer between ready_ and done_,
+    // the ownership is passed by the release/acquire of the bitmaps
     struct TaskElement
     {
         const std::string* key;
@@ -31,33 +138,66 @@ private:
         size_t pid;
     };
 
+    struct alignas(kCacheLineSize) AlignAtomicMask
+    {
+        std::atomic<uint64_t> bits{0};
+    };
+
+    static_assert(kTaskLen <= 64, "the slots are indexed by a 64-bit bitmap");
+    static constexpr uint64_t kAllSlots = kTaskLen == 64 ? ~uint64_t(0) : (uint64_t(1) << kTaskLen) - 1;
+
 private:
-#ifdef USE_SPINLOCK_FOR_TASKS
-    pthread_spinlock_t spinlock_;
-#else
-    mutable std::mutex mutex_;
-#endif
-    // char padding_[hardware_destructive_interference_size];
-    std::array<TaskElement, kTaskLen> tasks_;
+    alignas(kCacheLineSize) std::atomic<uint64_t> occupied_{0};
+    alignas(kCacheLineSize) std::atomic<uint64_t> ready_{0};
+    alignas(kCacheLineSize) std::atomic<bool> exit_{false};
+    std::atomic<bool> full_{false};             // some producer found no free slot
+
+    std::vector<AlignAtomicMask> done_;         // done_[pid-1]
+
+    // the consumer parks on consumer_parker_ when no request, a producer on producer_parkers_[pid-1]
+    Parker consumer_parker_;
+    std::vector<Parker> producer_parkers_;
+
+    alignas(kCacheLineSize) std::array<TaskElement, kTaskLen> tasks_;
+
+    const size_t producer_num_;
+
+    std::vector<uint64_t> deliver_masks_;       // only used by consumer_deliver(), one for each producer
 
 public:
-    Tasks();
-    ~Tasks();
+    explicit Tasks(const size_t producer_num);
     // Note: outputs should outputs.reserver(kTaskLen) and empty() before call-in
-    //       which will avoid allocation for Task (because it use lock)
-    // 
-    // It is producer responsibility to guarantee to avoid no duplictated input key 
-    // if key has already been processed (i.e., val != nullptr or no repeating of taken and input) 
+    //
+    // It is producer responsibility to guarantee to avoid no duplictated input key
+    // if key has already been processed (i.e., val != nullptr or no repeating of taken and input)
     // NOTE: If happened, it is also OK but useless
-    size_t producer_process(const size_t pid, 
-                           const std::vector<std::string*>& input_keys, std::vector<Output>& outputs);
+    size_t producer_process(const size_t pid, const std::vector<const std::string*>& input_keys, const size_t from,
+                            std::vector<Output>& outputs);
     void producer_process(const size_t pid, std::vector<Output>& outputs);
-    size_t producer_process(const size_t pid, const std::vector<std::string*>& input_keys);
+    size_t producer_process(const size_t pid, const std::vector<const std::string*>& input_keys, const size_t from);
 
-    // consume something, return the result
-    // if return std::numeric_limits<size_t>::max(), it means consumer thread should exit
+    // Take all published tasks to batch, the handle is the index in tasks_
+    // if return kPidMaxMeaninngExit, it means consumer thread should exit
     // else the number of consuming task (may be zero)
-    size_t consumer_process(SingleData& cache, std::array<bool, kFixProducerNumber>* pids);
+    size_t consumer_collect(ConsumerBatch& batch);
+    // Write the results (batch.vals) back to tasks_
+    // If pids is not nullptr, set (*pids)[pid-1] to true for each pid of the batch
+    void consumer_deliver(const ConsumerBatch& batch, std::vector<bool>* pids);
+
+    size_t producer_num() const
+    {
+        return producer_num_;
+    }
+
+    Parker& consumer_parker()
+    {
+        return consumer_parker_;
+    }
+
+    Parker& producer_parker(const size_t pid)
+    {
+        return producer_parkers_[pid-1];
+    }
 
     // NOTE: caller (main thread) should guarantee all produecr has exited and the consumer thread is alive only
     //       and all related work has been done corretly
@@ -66,96 +206,757 @@ public:
 
 private:
     void producer_dealwith_output(const size_t pid, std::vector<Output>& outputs);
-    size_t producer_dealwith_input(const size_t pid, const std::vector<std::string*>& input_keys);
+    size_t producer_dealwith_input(const size_t pid, const std::vector<const std::string*>& input_keys, const size_t from);
 };
 
-class Consumer
+// The keys which a producer looks up, 90% from hot keys (the samples), and 10% from random keys (usually miss)
+class KeySampler
+{
+private:
+    RandomEngine re_;
+
+    std::vector<std::string> hot_keys_;
+    std::vector<std::string> random_keys_;
+
+public:
+    KeySampler() = delete;
+    KeySampler(const KeySampler&) = delete;
+    KeySampler(KeySampler&&) = delete;
+    KeySampler& operator=(const KeySampler&) = delete;
+    KeySampler& operator=(KeySampler&&) = delete;
+
+    explicit KeySampler(const size_t seed, const std::vector<std::string>& samples);
+
+    // We assume each step of a transaction need to read [kTransactionOneStepLeastKeys, kTransactionOneStepMostKeys] keys
+    size_t rand_batch_num();
+    // clear keys then fill num keys
+    void prepare_input_keys(const size_t num, std::vector<const std::string*>& keys);
+};
+
+template <typename Transport, typename Wait>
+class Producer
 {
 private:
+    KeySampler sampler_;
     std::thread thread_;
-    SingleData& cache_;
-    Tasks& tasks_;
-    // std::array<std::atomic<bool>, kFixProducerNumber>& task_flags_;
 
+    typename Transport::ProducerEnd end_;
+    Wait wait_;
+
+    // point to local_stats_, or to a block of LiveStats if published
+    ProducerStats local_stats_;
+    ProducerStats* stats_ = &local_stats_;
+    const size_t bench_num_;
+    const size_t pid_;
+
+    OpenLoopConfig open_loop_;
+    LatencyHistogram latency_;
+
+    // optional, the keys not answered by the near cache are in near_misses_
+    std::unique_ptr<NearCache> near_;
+    std::vector<const std::string*> near_misses_;
+
+    std::chrono::high_resolution_clock::time_point time_start_;
+    std::chrono::high_resolution_clock::time_point time_end_;
 
 public:
-    Consumer() = delete;
-    Consumer(const Consumer&) = delete;
-    Consumer(Consumer&&) = delete;
-    Consumer& operator=(const Consumer&) = delete;
-    Consumer& operator=(Consumer&&) = delete;
+    Producer() = delete;
+    Producer(const Producer&) = delete;
+    Producer(Producer&&) = delete;
+    Producer& operator=(const Producer&) = delete;
+    Producer& operator=(Producer&&) = delete;
+
+    // The producer looks up bench_num keys in benchmark()
+    explicit Producer(const size_t pid, typename Transport::Channel& channel, const std::vector<std::string>& samples,
+                      const size_t bench_num = kBenchmarkCount)
+        : sampler_(pid, samples), end_(pid, channel), bench_num_(bench_num), pid_(pid)
+    {
+        wait_.bind(end_.parker());
+    }
 
-    virtual ~Consumer() noexcept;
+    // Call before start_thread(), then the producer runs in open loop for config.duration (bench_num is not used)
+    void set_open_loop(const OpenLoopConfig& config)
+    {
+        open_loop_ = config;
+    }
+
+    // Call before start_thread(), then the producer has a near cache validated by versions (see near_cache.h)
+    void set_near_cache(const VersionStripes& versions)
+    {
+        near_ = std::make_unique<NearCache>(versions);
+        near_misses_.reserve(kTransactionOneStepMostKeys);
+    }
 
-    Consumer(SingleData& cache, Tasks& tasks);
+    ~Producer() noexcept
+    {
+        try
+        {
+            wait_until_join();
+        }
+        catch(std::system_error& e)
+        {
+            std::cerr << "~Producer() failed when join, reason = " << e.what() << '\n';
+        }
+    }
+
+    void start_thread()
+    {
+        std::thread t(&Producer::benchmark, this);
+        thread_ = std::move(t);
+    }
 
-    void start_thread_loop();
-    void wait_until_join();
-    // called by main thread to signal consumer thread need to exit
-    void set_exit_task();
+    void wait_until_join()
+    {
+        if (thread_.joinable())
+            thread_.join();
+    }
 
-protected:
-    /* The caller guarantee pids are all false before call-in 
-     * If pids is nullptr, the consumer does not care aoub the pids
-     * otherwise, 
-     * when one pid is processed, set pids[pid-1] to true,
-     * so the caller (consumer) can signal the assocaated producers to process in async way */    
-    size_t process(std::array<bool, kFixProducerNumber>* pids);
+    std::tuple<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>
+    get_time_points() const
+    {
+        return {time_start_, time_end_};
+    }
 
-// Interface of virtual function
-private:
-    virtual void consumer_thread_loop_impl() = 0;
-    virtual void set_exit_task_more() = 0;
+    size_t get_bench_count() const
+    {
+        return stats_->bench_cnt;
+    }
+
+    const ProducerStats& get_stats() const
+    {
+        return *stats_;
+    }
+
+    // Call before start_thread(), then the stats are written to the shared memory of live_stats
+    void publish_stats(LiveStats& live_stats)
+    {
+        ProducerStats* block = live_stats.add_producer(pid_);
+        if (block != nullptr)
+            stats_ = block;
+    }
+
+    // the latency of each transaction from its intended send time, only for open loop
+    const LatencyHistogram& get_latency() const
+    {
+        return latency_;
+    }
 
 private:
-    void consumer_thread_loop();
+    void benchmark()
+    {
+        CMP_TRACE_THREAD("producer " + std::to_string(pid_));
+
+        const size_t cpu_start = thread_cpu_ns();
+
+        if (open_loop_.tx_per_sec > 0)
+            benchmark_open_loop();
+        else
+            benchmark_closed_loop();
+
+        stats_->cpu_ns = thread_cpu_ns() - cpu_start;
+    }
+
+    void benchmark_closed_loop()
+    {
+        std::vector<const std::string*> keys;
+        keys.reserve(kTransactionOneStepMostKeys);
+
+        time_start_ = std::chrono::high_resolution_clock::now();
+
+        // bench_cnt is updated for each transaction, so it is live for LiveStats
+        while (stats_->bench_cnt < bench_num_)
+        {
+            const size_t key_batch_num = sampler_.rand_batch_num();
+            sampler_.prepare_input_keys(key_batch_num, keys);
+
+            batch_keys(keys);
+
+            stats_->bench_cnt += key_batch_num;
+        }
+
+        time_end_ = std::chrono::high_resolution_clock::now();
+    }
+
+    void benchmark_open_loop()
+    {
+        std::vector<const std::string*> keys;
+        keys.reserve(kTransactionOneStepMostKeys);
+
+        time_start_ = std::chrono::high_resolution_clock::now();
+        const std::chrono::high_resolution_clock::time_point stop = time_start_ + open_loop_.duration;
+
+        ArrivalSchedule schedule(pid_, open_loop_, time_start_);
+
+        while (true)
+        {
+            const std::chrono::high_resolution_clock::time_point intended = schedule.next();
+            if (intended >= stop)
+                break;
+
+            // prepare the keys before the intended time, it is not a part of the latency
+            const size_t key_batch_num = sampler_.rand_batch_num();
+            sampler_.prepare_input_keys(key_batch_num, keys);
+
+            ArrivalSchedule::wait_until(intended);
+
+            batch_keys(keys);
+
+            const auto done = std::chrono::high_resolution_clock::now();
+            latency_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+
+            stats_->bench_cnt += key_batch_num;
+        }
+
+        time_end_ = std::chrono::high_resolution_clock::now();
+    }
+
+    // return the keys which are not answered by the near cache
+    const std::vector<const std::string*>& near_lookup(const std::vector<const std::string*>& keys)
+    {
+        near_misses_.clear();
+
+        for (const std::string* key : keys)
+        {
+            // a compute request always goes to the consumer, its pointer is not a key
+            if (as_compute_request(key) != nullptr)
+            {
+                near_misses_.push_back(key);
+                continue;
+            }
+
+            const std::string* val = near_->lookup(key);
+            if (val == nullptr)
+            {
+                near_->reserve(key);
+                near_misses_.push_back(key);
+                continue;
+            }
+
+            ++stats_->near_hit_cnt;
+            if (reinterpret_cast<const char*>(val) == kNotFound)
+                ++stats_->miss_cnt;
+            else
+                ++stats_->hit_cnt;
+        }
+
+        if (near_misses_.empty())
+            ++stats_->near_tx_cnt;
+
+        return near_misses_;
+    }
+
+    // client/server mode, return until all keys have been answered by the near cache or the consumer
+    void batch_keys(const std::vector<const std::string*>& all_keys)
+    {
+        const std::vector<const std::string*>& keys = near_ != nullptr ? near_lookup(all_keys) : all_keys;
+
+        size_t sent_cnt = 0;
+        size_t answer_cnt = 0;
+
+        size_t request_most = 0;
+        size_t result_most = 0;
+
+        while (answer_cnt != keys.size())
+        {
+            bool progress = false;
+
+            // first the client (producer) sends the requests
+            if (sent_cnt != keys.size() && end_.can_send())
+            {
+                const size_t sent_in_this_turn = end_.send(keys, sent_cnt);
+
+                if (sent_in_this_turn == 0)
+                {
+                    ++stats_->request_wait_cnt;
+                    ++request_most;
+                }
+                else
+                {
+                    CMP_TRACE_EVENT(TraceType::kRequestPublish, sent_in_this_turn);
+                    sent_cnt += sent_in_this_turn;
+
+                    if (request_most > stats_->request_wait_most)
+                        stats_->request_wait_most = request_most;
+
+                    request_most = 0;
+                    progress = true;
+                }
+            }
+
+            // then the client (producer) checks the answers
+            const size_t answered_in_this_turn = end_.receive([this](const std::string* key, const std::string* val)
+            {
+                if (near_ != nullptr && as_compute_request(key) == nullptr)
+                    near_->fill(key, val);
+
+                if (reinterpret_cast<const char*>(val) == kNotFound)
+                {
+                    ++stats_->miss_cnt;
+                }
+                else
+                {
+                    ++stats_->hit_cnt;
+                }
+            });
+
+            if (answered_in_this_turn == 0)
+            {
+                ++stats_->result_wait_cnt;
+                ++result_most;
+            }
+            else
+            {
+                CMP_TRACE_EVENT(TraceType::kResultObserved, answered_in_this_turn);
+                answer_cnt += answered_in_this_turn;
+
+                if (result_most > stats_->result_wait_most)
+                    stats_->result_wait_most = result_most;
+
+                result_most = 0;
+                progress = true;
+            }
+
+            if (progress)
+            {
+                wait_.reset();
+            }
+            else
+            {
+                if (wait_.idle())
+                    ++stats_->sleep_cnt;
+            }
+        }
+    }
 };
 
-class Producer
+template <typename Transport, typename Wait>
+class Consumer
 {
 private:
-    RandomEngine re_;
+    static constexpr size_t kBusyFlushMask = (1<<10) - 1;
+    // the steps of the timer wheel in one idle round, small so a request coming is not delayed by expiry
+    static constexpr size_t kExpireStepBudget = 64;
+
     std::thread thread_;
+    SingleData& cache_;
 
-    Tasks& tasks_;
-    std::vector<std::string> hot_keys_;
-    std::vector<std::string> random_keys_;
+    typename Transport::ConsumerEnd end_;
+    Wait wait_;
 
-    std::chrono::high_resolution_clock::time_point time_start_;
-    std::chrono::high_resolution_clock::time_point time_end_;
+    ConsumerBatch batch_;
+    // point to local_stats_, or to a block of LiveStats if published
+    ConsumerStats local_stats_;
+    ConsumerStats* stats_ = &local_stats_;
+
+    AdaptiveBatcher batcher_;
+    LatencyHistogram batch_sizes_;      // not latency, the number of requests of each batch
 
-    size_t bench_cnt_ = 0;
+    const size_t capacity_;
+    BatchDedup dedup_;
 
-    // std::array<std::atomic<bool>, cmp_mem_engine::kFixProducerNumber>& task_flags_;
+    // optional, the misses are loaded by it (see read_through.h) and answered by loaded_ later
+    std::unique_ptr<ReadThrough> read_through_;
+    ConsumerBatch loaded_;
+
+    // optional, the hot set of the cache is dumped to it for a warm restart (see CacheData::dump_hot())
+    std::string hot_dump_path_;
+    std::chrono::milliseconds hot_dump_interval_{0};
+    std::chrono::steady_clock::time_point last_hot_dump_;
 
 public:
-    Producer() = delete;
-    Producer(const Producer&) = delete;
-    Producer(Producer&&) = delete;
-    Producer& operator=(const Producer&) = delete;
-    Producer& operator=(Producer&&) = delete;
+    Consumer() = delete;
+    Consumer(const Consumer&) = delete;
+    Consumer(Consumer&&) = delete;
+    Consumer& operator=(const Consumer&) = delete;
+    Consumer& operator=(Consumer&&) = delete;
 
-    virtual ~Producer() noexcept;
+    Consumer(SingleData& cache, typename Transport::Channel& channel)
+        : cache_(cache), end_(channel), batch_(end_.capacity()), capacity_(end_.capacity()), dedup_(capacity_),
+          loaded_(capacity_)
+    {
+        wait_.bind(end_.parker());
+    }
 
-    Producer(const size_t pid, Tasks& tasks, const std::vector<std::string>& samples);
-    void start_thread();
-    void wait_until_join();
+    ~Consumer() noexcept
+    {
+        try
+        {
+            wait_until_join();
+        }
+        catch (std::system_error& e)
+        {
+            std::cerr << "~Consumer thread join failed, reason = " << e.what() << '\n';
+        }
+    }
+
+    void start_thread_loop()
+    {
+        std::thread t(&Consumer::consumer_thread_loop, this);
+        thread_ = std::move(t);
+    }
 
-    std::tuple<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>
-    get_time_points() const;
-    size_t get_bench_count() const;
+    void wait_until_join()
+    {
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    // called by main thread to signal consumer thread need to exit.
+    // The main thread needs to guarantee that
+    // all tasks have been finished (i.e., all producer threads exits)
+    void set_exit_task()
+    {
+        end_.set_exit();
+    }
+
+    const ConsumerStats& get_stats() const
+    {
+        return *stats_;
+    }
+
+    // Call before start_thread_loop(), then the stats (and the policy telemetry of the cache)
+    // are written to the shared memory of live_stats until the thread exits
+    void publish_stats(LiveStats& live_stats, const size_t index = 0)
+    {
+        ConsumerStats* block = live_stats.add_consumer(index);
+        if (block != nullptr)
+        {
+            stats_ = block;
+            cache_.set_telemetry(&block->policy);
+        }
+    }
+
+    // Call before start_thread_loop(), see adaptive_batch.h. The default is immediate service
+    void set_batching(const BatchingConfig& config)
+    {
+        batcher_.configure(config);
+    }
+
+    // Call before start_thread_loop(), then a miss is loaded by loader on worker_num threads and inserted to the cache,
+    // the producer gets the loaded value (or kNotFound if loader does not have it) later (see read_through.h).
+    // Not for the transports of kWholeDelivery
+    void set_loader(Loader& loader, const size_t worker_num = kLoadWorkerNum) requires (!requires { Transport::kWholeDelivery; })
+    {
+        read_through_ = std::make_unique<ReadThrough>(loader, end_.parker(), worker_num);
+    }
+
+    // Call before start_thread_loop(), then the hot set of the cache is dumped to path when the thread exits,
+    // and every interval when the consumer is idle (0 for only at exit)
+    void set_hot_dump(const std::string& path, const std::chrono::milliseconds interval = std::chrono::milliseconds(0))
+    {
+        hot_dump_path_ = path;
+        hot_dump_interval_ = interval;
+        last_hot_dump_ = std::chrono::steady_clock::now();
+    }
 
-protected:
-    void benchmark();
-    size_t process(const size_t pid, const std::vector<std::string*>& input_keys);
-    void process(const size_t pid, std::vector<Tasks::Output>& outputs);
-    
-    std::vector<std::string*> prepare_input_keys(const size_t num);
-    std::vector<Tasks::Output> prepare_outputs() const;
+    // the distribution of the batch sizes, read after the thread exits
+    const LatencyHistogram& get_batch_sizes() const
+    {
+        return batch_sizes_;
+    }
 
 private:
-    virtual void batch_keys(std::vector<std::string*>& keys) = 0;
+    void consumer_thread_loop()
+    {
+        CMP_TRACE_THREAD("consumer");
+
+        const size_t cpu_start = thread_cpu_ns();
+
+        bool busy = false;
+        std::chrono::high_resolution_clock::time_point busy_start;
+        size_t busy_rounds = 0;
+
+        while (true)
+        {
+            batch_.clear();
+
+            // the loads finished since the last round are answered first
+            const size_t loaded_cnt = read_through_ != nullptr ? deliver_loaded() : 0;
+
+            const size_t request_cnt = end_.collect(batch_);
+
+            if (request_cnt == kPidMaxMeaninngExit)
+                break;          // exit consumer thread
+
+            size_t batch_cnt = request_cnt;
+
+            if (request_cnt == 0 && loaded_cnt != 0)
+            {
+                wait_.reset();
+                continue;
+            }
+
+            if (request_cnt == 0)
+            {
+                // no task
+                if (busy)
+                {
+                    // only call chrono when switch between busy and idle
+                    busy = false;
+                    stats_->busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::high_resolution_clock::now() - busy_start).count();
+                }
+
+                if (stats_->bench_cnt != 0)
+                    ++stats_->wait_cnt;
+
+                // proactive expiry only when idle, and bounded, the lookups treat the expired keys as misses anyway
+                stats_->expired_cnt += cache_.expire_step(kExpireStepBudget);
+                // and the write-behind flush by interval, the puts check it too
+                if (cache_.write_behind() != nullptr)
+                    cache_.write_behind()->tick();
+                if (hot_dump_interval_.count() != 0)
+                    dump_hot_by_interval();
+
+                if (wait_.idle() && stats_->bench_cnt != 0)
+                    ++stats_->sleep_cnt;
+
+                continue;
+            }
+
+            // some task is coming
+            if (!busy)
+            {
+                busy = true;
+                busy_start = std::chrono::high_resolution_clock::now();
+            }
+            else if ((++busy_rounds & kBusyFlushMask) == 0)
+            {
+                // flush busy_ns now and then for a long busy time, so the readers of LiveStats see it
+                const auto now = std::chrono::high_resolution_clock::now();
+                stats_->busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - busy_start).count();
+                busy_start = now;
+
+                publish_top_keys();
+                // and the wheel runs now and then under load too, so an expired key (and a near cache answer
+                // of it) does not live until the consumer is idle
+                stats_->expired_cnt += cache_.expire_step(kExpireStepBudget);
+            }
+
+            wait_.reset();
+
+            if (batcher_.enabled())
+                batch_cnt = accumulate(request_cnt);
+
+            CMP_TRACE_EVENT(TraceType::kConsumerPickup, batch_cnt);
+            process_requests();
+            CMP_TRACE_EVENT(TraceType::kLookupDone, batch_cnt);
+            if (read_through_ != nullptr)
+                drop_parked();
+            if (batch_.size() != 0)
+                end_.deliver(batch_);
+
+            stats_->bench_cnt += batch_cnt;
+            ++stats_->batch_cnt;
+            batch_sizes_.record(batch_cnt);
+        }
+
+        if (busy)
+            stats_->busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::high_resolution_clock::now() - busy_start).count();
+
+        stats_->cpu_ns = thread_cpu_ns() - cpu_start;
+        publish_top_keys();
+
+        // the block may be reset by the next run, the cache keeps counting in its own telemetry
+        cache_.set_telemetry(nullptr);
+
+        if (!hot_dump_path_.empty())
+            cache_.dump_hot(hot_dump_path_.c_str());
+    }
+
+    void dump_hot_by_interval()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - last_hot_dump_ < hot_dump_interval_)
+            return;
+
+        cache_.dump_hot(hot_dump_path_.c_str());
+        last_hot_dump_ = now;
+    }
+
+    // copy the heavy hitters of the cache to the stats, like a seqlock for the readers of LiveStats
+    void publish_top_keys()
+    {
+        ++stats_->top_seq;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        stats_->top_num = cache_.heavy_hitters().top(stats_->top_keys, kHeavyHitterTopNum);
+
+        std::atomic_thread_fence(std::memory_order_release);
+        ++stats_->top_seq;
+    }
+
+    // keep polling to grow the batch of cnt requests if the batcher expects more soon,
+    // return the number of requests in the batch
+    size_t accumulate(size_t cnt)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        const uint64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+
+        const uint64_t budget = batcher_.budget(cnt, start_ns);
+        if (budget == 0)
+            return cnt;
+
+        const size_t first_cnt = cnt;
+        const size_t target = std::min(batcher_.target(), end_.capacity());
+        uint64_t waited_ns = 0;
+
+        while (cnt < target && waited_ns < budget)
+        {
+            const size_t more = end_.collect(batch_);
+            if (more == kPidMaxMeaninngExit)
+                break;          // the exit is seen again by the next round
+
+            cnt += more;
+            waited_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        batcher_.waited(cnt - first_cnt, start_ns + waited_ns);
+        ++stats_->batch_wait_cnt;
+        stats_->batch_wait_ns += waited_ns;
+
+        return cnt;
+    }
+
+    // find the results in cache, no lock needed because the cache is owned by the consumer thread.
+    // The same key in one batch is looked up only once (see batch_dedup.h)
+    void process_requests()
+    {
+        batch_.vals.resize(batch_.size());
+
+        const bool dedup = batch_.size() > 1 && batch_.size() <= capacity_;
+        if (dedup)
+            dedup_.begin_batch();
+
+        for (size_t i = 0; i != batch_.size(); ++i)
+        {
+            // a compute request always runs, the result is in the request
+            if (ComputeRequest* request = as_compute_request(batch_.keys[i]); request != nullptr)
+            {
+                cache_.apply(*request);
+                batch_.vals[i] = request->status == ComputeStatus::kNotFound
+                                     ? reinterpret_cast<const std::string*>(kNotFound) : &request->result;
+                ++stats_->compute_cnt;
+                if (request->status != ComputeStatus::kOk)
+                    ++stats_->compute_fail_cnt;
+
+                // the answers before a write are stale for the lookups after it
+                if (dedup && request->op != ComputeOp::kGets && request->op != ComputeOp::kGetAndTouch)
+                    dedup_.begin_batch();
+                continue;
+            }
+
+            if (dedup)
+            {
+                const size_t first = dedup_.find_or_add(batch_.keys, i);
+                if (first != BatchDedup::kNoSlot)
+                {
+                    batch_.vals[i] = batch_.vals[first];
+                    ++stats_->dedup_cnt;
+                    if (batch_.vals[i] == nullptr)
+                    {
+                        // the first one is parked, so it joins the same load
+                        park(i);
+                        ++stats_->miss_cnt;
+                    }
+                    else if (reinterpret_cast<const char*>(batch_.vals[i]) == kNotFound)
+                        ++stats_->miss_cnt;
+                    else
+                        ++stats_->hit_cnt;
+                    continue;
+                }
+            }
+
+            const std::string* val = cache_.find_val(*batch_.keys[i]);
+
+            if (val == nullptr && read_through_ != nullptr)
+            {
+                park(i);
+                ++stats_->miss_cnt;
+            }
+            else if (val == nullptr)
+            {
+                // not found, but we can not put nullptr in vals, using an literal pointer instead
+                batch_.vals[i] = reinterpret_cast<const std::string*>(kNotFound);
+                ++stats_->miss_cnt;
+            }
+            else
+            {
+                batch_.vals[i] = val;
+                ++stats_->hit_cnt;
+            }
+        }
+    }
+
+    // the request i of the batch waits for the load of its key, its val is nullptr until drop_parked()
+    void park(const size_t i)
+    {
+        batch_.vals[i] = nullptr;
+        if (read_through_->park(batch_.keys[i], batch_.handles[i]))
+            ++stats_->load_cnt;
+        else
+            ++stats_->load_join_cnt;
+    }
+
+    // remove the parked requests from the batch, the others keep their order
+    void drop_parked()
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i != batch_.size(); ++i)
+        {
+            if (batch_.vals[i] == nullptr)
+                continue;
+
+            batch_.keys[kept] = batch_.keys[i];
+            batch_.handles[kept] = batch_.handles[i];
+            batch_.vals[kept] = batch_.vals[i];
+            ++kept;
+        }
+
+        batch_.keys.resize(kept);
+        batch_.handles.resize(kept);
+        batch_.vals.resize(kept);
+    }
+
+    // insert the loaded values to the cache and answer their waiters, return the number of the finished loads
+    size_t deliver_loaded()
+    {
+        loaded_.clear();
+
+        const size_t cnt = read_through_->drain(
+            [this](const std::string& key, std::string* val, const std::vector<ReadThrough::Waiter>& waiters)
+        {
+            const std::string* answer = val == nullptr ? reinterpret_cast<const std::string*>(kNotFound)
+                                                       : cache_.insert_absent(key, std::move(*val));
+            for (const ReadThrough::Waiter& waiter : waiters)
+            {
+                loaded_.add(waiter.key, waiter.handle);
+                loaded_.vals.push_back(answer);
+            }
+        });
+
+        if (loaded_.size() != 0)
+            end_.deliver(loaded_);
+
+        return cnt;
+    }
 };
 
+// The consumers of a Transport: kNum consumer threads, the consumer index uses
+// Consumer<Transport, Wait> on channel(channel, index).
+// One consumer for all transports except the sharded one (see pc_sharded.h)
+template <typename T>
+struct ConsumerSide
+{
+    using Transport = T;
+    static constexpr size_t kNum = 1;
+
+    static typename T::Channel& channel(typename T::Channel& channel, const size_t)
+    {
+        return channel;
+    }
+};
 
-}   // cmp_mem_engine
\ No newline at end of file
+}   // cmp_mem_engine
@@ -0,0 +1,95 @@
+#include "read_through.h"
+
+#include <functional>
+
+namespace cmp_mem_engine
+{
+
+LatencyBackend::LatencyBackend(const std::chrono::microseconds latency, const int absent_percent, const size_t val_len)
+    : latency_(latency), absent_percent_(absent_percent), val_len_(val_len)
+{}
+
+bool LatencyBackend::load(const std::string& key, std::string& val)
+{
+    load_cnt_.fetch_add(1, std::memory_order_relaxed);
+
+    if (latency_.count() != 0)
+        std::this_thread::sleep_for(latency_);
+
+    const uint64_t hash = std::hash<std::string>()(key);
+    if (static_cast<int>((hash >> 40) % 100) < absent_percent_)
+        return false;
+
+    val.assign(val_len_, static_cast<char>('a' + hash % 26));
+    return true;
+}
+
+ReadThrough::ReadThrough(Loader& loader, Parker& consumer_parker, const size_t worker_num)
+    : loader_(loader), consumer_parker_(consumer_parker)
+{
+    workers_.reserve(worker_num);
+    for (size_t i = 0; i != worker_num; ++i)
+        workers_.emplace_back(&ReadThrough::worker_loop, this);
+}
+
+ReadThrough::~ReadThrough() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(job_mutex_);
+        stop_ = true;
+    }
+    job_cv_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+bool ReadThrough::park(const std::string* key, const size_t handle)
+{
+    const auto [it, inserted] = loading_.try_emplace(*key);
+    it->second.push_back(Waiter{key, handle});
+    if (!inserted)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(job_mutex_);
+        jobs_.push_back(*key);
+    }
+    job_cv_.notify_one();
+
+    return true;
+}
+
+void ReadThrough::worker_loop()
+{
+    while (true)
+    {
+        std::string key;
+        {
+            std::unique_lock<std::mutex> lock(job_mutex_);
+            job_cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+
+            // the jobs left at stop have no waiter any more (the producers have exited)
+            if (stop_)
+                return;
+
+            key = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        Loaded one{std::move(key), false, std::string()};
+        one.found = loader_.load(one.key, one.val);
+
+        {
+            std::lock_guard<std::mutex> lock(loaded_mutex_);
+            loaded_.push_back(std::move(one));
+            loaded_num_.store(loaded_.size(), std::memory_order_relaxed);
+        }
+        consumer_parker_.unpark();
+    }
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cassert>
+
+#include "parker.h"
+
+/* Read-through: a miss of the consumer loads the value from a slower backend (a Loader) and inserts it.
+ *
+ * The consumer parks the request of a missed key (its key pointer and its transport handle) instead of answering it,
+ * and goes on serving the other requests. The misses of the same key while it is being loaded join the load
+ * (single flight), so the backend sees one load for each key at a time.
+ * The loads run on a pool of worker threads, a finished load is queued back and the consumer is unparked.
+ * The consumer drains the finished loads between its batches, inserts the values to its cache,
+ * and answers all waiters of each key at once (see Consumer::set_loader()).
+ *
+ * The waiters are only touched by the consumer thread, the workers only see the keys (copies) and the values,
+ * so the only shared state is the two queues under their mutexes, which is fine for a backend of microseconds.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kLoadWorkerNum = 16;
+
+// The backend of a read-through cache. load() is called by the worker threads of ReadThrough at the same time
+class Loader
+{
+public:
+    virtual ~Loader() = default;
+
+    // Load the value of key to val, return false if the backend does not have key. It may block
+    virtual bool load(const std::string& key, std::string& val) = 0;
+};
+
+// A stand-in of a slow backend for the benchmarks: each load sleeps latency,
+// absent_percent of the keys (by hash) are not in the backend, and the value of a key is made from its hash
+class LatencyBackend : public Loader
+{
+private:
+    const std::chrono::microseconds latency_;
+    const int absent_percent_;
+    const size_t val_len_;
+
+    std::atomic<size_t> load_cnt_{0};
+
+public:
+    LatencyBackend() = delete;
+    LatencyBackend(const LatencyBackend&) = delete;
+    LatencyBackend(LatencyBackend&&) = delete;
+    LatencyBackend& operator=(const LatencyBackend&) = delete;
+    LatencyBackend& operator=(LatencyBackend&&) = delete;
+
+    LatencyBackend(const std::chrono::microseconds latency, const int absent_percent, const size_t val_len);
+
+    bool load(const std::string& key, std::string& val) override;
+
+    size_t load_num() const
+    {
+        return load_cnt_.load(std::memory_order_relaxed);
+    }
+};
+
+class ReadThrough
+{
+public:
+    // a parked request, the transport answers it by handle (see ConsumerBatch)
+    struct Waiter
+    {
+        const std::string* key;
+        size_t handle;
+    };
+
+private:
+    struct Loaded
+    {
+        std::string key;
+        bool found;
+        std::string val;
+    };
+
+    Loader& loader_;
+    Parker& consumer_parker_;
+
+    // owned by the consumer thread, the waiters of each key being loaded
+    std::unordered_map<std::string, std::vector<Waiter>> loading_;
+
+    std::mutex job_mutex_;
+    std::condition_variable job_cv_;
+    std::deque<std::string> jobs_;
+    bool stop_ = false;
+
+    std::mutex loaded_mutex_;
+    std::vector<Loaded> loaded_;
+    std::atomic<size_t> loaded_num_{0};     // the consumer polls it without the mutex
+    std::vector<Loaded> taken_;             // owned by the consumer thread, swapped with loaded_
+
+    std::vector<std::thread> workers_;
+
+public:
+    ReadThrough() = delete;
+    ReadThrough(const ReadThrough&) = delete;
+    ReadThrough(ReadThrough&&) = delete;
+    ReadThrough& operator=(const ReadThrough&) = delete;
+    ReadThrough& operator=(ReadThrough&&) = delete;
+
+    // consumer_parker is unparked when a load is finished
+    ReadThrough(Loader& loader, Parker& consumer_parker, const size_t worker_num = kLoadWorkerNum);
+    ~ReadThrough() noexcept;
+
+    // Park the request (key, handle) of a miss until key is loaded.
+    // Return true if a load of key is started, false if the request joins the load in flight
+    bool park(const std::string* key, const size_t handle);
+
+    // the keys being loaded
+    size_t loading_num() const
+    {
+        return loading_.size();
+    }
+
+    // Call on_loaded(key, val, waiters) for each finished load, val is nullptr if the backend does not have key,
+    // else it can be moved. Return the number of finished loads
+    template <typename F>
+    size_t drain(F&& on_loaded)
+    {
+        if (loaded_num_.load(std::memory_order_relaxed) == 0)
+            return 0;
+
+        {
+            std::lock_guard<std::mutex> lock(loaded_mutex_);
+            taken_.swap(loaded_);
+            loaded_num_.store(0, std::memory_order_relaxed);
+        }
+
+        for (Loaded& one : taken_)
+        {
+            const auto it = loading_.find(one.key);
+            assert(it != loading_.end());
+
+            on_loaded(it->first, one.found ? &one.val : nullptr, it->second);
+            loading_.erase(it);
+        }
+
+        const size_t cnt = taken_.size();
+        taken_.clear();
+        return cnt;
+    }
+
+private:
+    void worker_loop();
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,202 @@
+#include "shards_mrc.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cmp_mem_engine
+{
+
+ShardsMrc::ShardsMrc(const size_t max_size, const size_t split_size, const size_t sample_max)
+    : max_size_(std::max<size_t>(max_size, 1)), sample_max_(sample_max), split_size_(split_size),
+      threshold_(static_cast<uint64_t>(static_cast<double>(kShardsModulus) * kShardsInitRate)),
+      bins_(kShardsBinNum + 1, 0)
+{
+    // the times are renumbered when they reach the end, no more often than each 3 * sample_max references
+    size_t fenwick_size = 16;
+    while (fenwick_size < sample_max_ * 4)
+        fenwick_size *= 2;
+    fenwick_.assign(fenwick_size, 0);
+
+    last_time_.reserve(sample_max_ + 1);
+
+    for (const size_t percent : kShardsSplitPercents)
+        sims_.push_back(std::make_unique<MiniSim>(0, percent));
+    resize_sims();
+}
+
+void ShardsMrc::add_sampled(const std::string& key, const uint64_t hash)
+{
+    if (now_ == fenwick_.size())
+        renumber();
+
+    const double weight = 1 / sample_rate();
+    sampled_weight_ += weight;
+
+    const auto [it, inserted] = last_time_.try_emplace(hash, 0);
+    if (inserted)
+    {
+        // a cold miss at any size
+        values_.push({value_of(hash), hash});
+    }
+    else
+    {
+        // the distinct keys referenced after the last reference of key
+        const uint64_t last = it->second;
+        const size_t distance = fenwick_sum(now_ - 1) - fenwick_sum(last);
+        fenwick_add(last, -1);
+
+        const double scaled = static_cast<double>(distance) * weight;
+        const size_t bin = static_cast<size_t>(std::min(scaled * kShardsBinNum / static_cast<double>(max_size_),
+                                                        static_cast<double>(kShardsBinNum)));
+        bins_[bin] += weight;
+    }
+
+    it->second = now_;
+    fenwick_add(now_, 1);
+    ++now_;
+
+    for (auto& sim : sims_)
+    {
+        ++sim->ref_cnt;
+
+        const auto found = sim->keys.find(hash);
+        if (found != sim->keys.end())
+        {
+            ++sim->hit_cnt;
+            sim->policy.on_hit(found->second.link);
+            continue;
+        }
+
+        while (sim->keys.size() >= sim_capacity_ && !sim->keys.empty())
+            evict_sim(*sim);
+
+        SimEntry& added = sim->keys.emplace(hash, SimEntry{key, kPolicyNil}).first->second;
+        added.link = sim->policy.on_insert(&added.key, hash);
+    }
+
+    if (last_time_.size() > sample_max_)
+        lower_threshold();
+}
+
+// drop the sampled key of the largest value, and the threshold is its value
+void ShardsMrc::lower_threshold()
+{
+    threshold_ = values_.top().first;
+
+    while (!values_.empty() && values_.top().first >= threshold_)
+    {
+        const uint64_t hash = values_.top().second;
+        const auto it = last_time_.find(hash);
+        fenwick_add(it->second, -1);
+        last_time_.erase(it);
+        values_.pop();
+
+        for (auto& sim : sims_)
+        {
+            const auto found = sim->keys.find(hash);
+            if (found != sim->keys.end())
+            {
+                sim->policy.on_erase(found->second.link);
+                sim->keys.erase(found);
+            }
+        }
+    }
+
+    resize_sims();
+}
+
+// the last reference times to 0, 1, ... in the same order
+void ShardsMrc::renumber()
+{
+    std::vector<std::pair<uint64_t, uint64_t>> times;
+    times.reserve(last_time_.size());
+    for (const auto& [hash, time] : last_time_)
+        times.push_back({time, hash});
+    std::sort(times.begin(), times.end());
+
+    std::fill(fenwick_.begin(), fenwick_.end(), 0);
+    now_ = 0;
+    for (const auto& [time, hash] : times)
+    {
+        last_time_[hash] = now_;
+        fenwick_add(now_, 1);
+        ++now_;
+    }
+}
+
+void ShardsMrc::resize_sims()
+{
+    sim_capacity_ = std::max<size_t>(static_cast<size_t>(std::lround(static_cast<double>(split_size_) * sample_rate())), 1);
+
+    for (auto& sim : sims_)
+    {
+        sim->policy.set_capacity(sim_capacity_);
+        while (sim->keys.size() > sim_capacity_)
+            evict_sim(*sim);
+    }
+}
+
+void ShardsMrc::evict_sim(MiniSim& sim)
+{
+    const std::string* victim = sim.policy.victim(0);
+    sim.keys.erase(std::hash<std::string>()(*victim));
+}
+
+void ShardsMrc::fenwick_add(size_t pos, const int delta)
+{
+    for (++pos; pos <= fenwick_.size(); pos += pos & (~pos + 1))
+        fenwick_[pos - 1] += static_cast<uint32_t>(delta);
+}
+
+size_t ShardsMrc::fenwick_sum(size_t pos) const
+{
+    size_t sum = 0;
+    for (++pos; pos != 0; pos -= pos & (~pos + 1))
+        sum += fenwick_[pos - 1];
+    return sum;
+}
+
+std::vector<MrcPoint> ShardsMrc::curve(const size_t point_num) const
+{
+    std::vector<MrcPoint> points;
+    if (ref_cnt_ == 0)
+        return points;
+
+    // the references the samples miss (or overcount) are thought as hits of distance 0
+    const double adjust = static_cast<double>(ref_cnt_) - sampled_weight_;
+    const double total = static_cast<double>(ref_cnt_);
+
+    for (size_t p = 1; p <= point_num; ++p)
+    {
+        const size_t size = max_size_ * p / point_num;
+        const size_t bin_end = std::min(size * kShardsBinNum / max_size_, kShardsBinNum);
+
+        double hits = adjust;
+        for (size_t b = 0; b != bin_end; ++b)
+            hits += bins_[b];
+
+        points.push_back(MrcPoint{size, std::clamp(hits * 100 / total, 0.0, 100.0)});
+    }
+
+    return points;
+}
+
+std::vector<MrcSplit> ShardsMrc::splits() const
+{
+    std::vector<MrcSplit> res;
+    for (size_t i = 0; i != kShardsSplitNum; ++i)
+    {
+        const MiniSim& sim = *sims_[i];
+        const double hit = sim.ref_cnt == 0 ? 0
+                           : static_cast<double>(sim.hit_cnt) * 100 / static_cast<double>(sim.ref_cnt);
+        res.push_back(MrcSplit{kShardsSplitPercents[i], hit});
+    }
+
+    std::stable_sort(res.begin(), res.end(), [](const MrcSplit& a, const MrcSplit& b)
+    {
+        return a.hit_percent > b.hit_percent;
+    });
+    return res;
+}
+
+}   // namespace cmp_mem_engine
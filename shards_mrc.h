@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
+#include "policy_slru.h"
+
+/* The miss ratio curve (MRC) of a key stream by SHARDS (Waldspurger et al., FAST'15), i.e., the hit ratio of
+ * a LRU cache of each size, and the best protected percent of a SLRU cache of one size.
+ *
+ * A key is sampled if the value of its hash is less than the threshold, the sample rate R is threshold / kShardsModulus.
+ * The reuse distance (the number of distinct keys since the last reference of the key) of a sampled reference
+ * is counted in the sampled keys by a Fenwick tree of their last reference times, and scaled by 1 / R.
+ * No more than sample_max keys are tracked: when more, the key of the largest value is dropped and the threshold
+ * is lowered to it (the fixed-size SHARDS), so the memory is bounded whatever the number of keys.
+ * The sampled references are weighted by 1 / R of their time, and the difference to the real number of references
+ * is added to the distance 0 (SHARDS-adj).
+ *
+ * The SLRU splits are the miniature simulations (Waldspurger et al., ATC'17): a SLRU cache of split_size * R keys
+ * for each of kShardsSplitPercents, fed by the sampled references only.
+ *
+ * The curve is of the references (hit or miss of the engine), as if any key can be loaded into the cache.
+ * Not thread safe, it is fed by the consumer thread (CacheData::set_mrc()) or by an offline stream.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr size_t kShardsSampleMax = 1<<13;
+constexpr uint64_t kShardsModulus = uint64_t(1) << 24;
+constexpr double kShardsInitRate = 0.1;
+constexpr size_t kShardsBinNum = 1<<10;
+constexpr size_t kShardsSplitPercents[] = {50, 60, 70, 80, 90, 95};
+constexpr size_t kShardsSplitNum = sizeof(kShardsSplitPercents) / sizeof(kShardsSplitPercents[0]);
+
+struct MrcPoint
+{
+    size_t size;                // the cache size in keys
+    double hit_percent;
+};
+
+struct MrcSplit
+{
+    size_t protect_percent;
+    double hit_percent;
+};
+
+class ShardsMrc
+{
+private:
+    struct SimEntry
+    {
+        std::string key;
+        PolicyLink link;
+    };
+
+    // a SLRU cache of the sampled keys by hash, a key not sampled any more is removed
+    struct MiniSim
+    {
+        SlruPolicy policy;
+        std::unordered_map<uint64_t, SimEntry> keys;
+        size_t hit_cnt = 0;
+        size_t ref_cnt = 0;
+
+        MiniSim(const size_t capacity, const size_t protect_percent) : policy(capacity, protect_percent)
+        {}
+    };
+
+    const size_t max_size_;
+    const size_t sample_max_;
+    const size_t split_size_;
+
+    uint64_t threshold_;
+    // the sampled keys by hash -> the time of the last reference, and the heap of their (value, hash)
+    std::unordered_map<uint64_t, uint64_t> last_time_;
+    std::priority_queue<std::pair<uint64_t, uint64_t>> values_;
+
+    // the Fenwick tree of the last reference times, one bit for each sampled key, renumbered when full
+    std::vector<uint32_t> fenwick_;
+    uint64_t now_ = 0;
+
+    // the weights of the scaled distances, the last bin is of max_size_ or more
+    std::vector<double> bins_;
+    double sampled_weight_ = 0;
+    uint64_t ref_cnt_ = 0;
+
+    std::vector<std::unique_ptr<MiniSim>> sims_;
+    size_t sim_capacity_ = 0;
+
+public:
+    ShardsMrc() = delete;
+    ShardsMrc(const ShardsMrc&) = delete;
+    ShardsMrc(ShardsMrc&&) = delete;
+    ShardsMrc& operator=(const ShardsMrc&) = delete;
+    ShardsMrc& operator=(ShardsMrc&&) = delete;
+
+    // max_size is the largest cache size of the curve, split_size is the cache size of the SLRU splits
+    ShardsMrc(const size_t max_size, const size_t split_size, const size_t sample_max = kShardsSampleMax);
+
+    // One reference of key, hash is std::hash<std::string> of key
+    void add(const std::string& key, const uint64_t hash)
+    {
+        ++ref_cnt_;
+        if (value_of(hash) < threshold_)
+            add_sampled(key, hash);
+    }
+
+    double sample_rate() const
+    {
+        return static_cast<double>(threshold_) / static_cast<double>(kShardsModulus);
+    }
+
+    uint64_t ref_num() const
+    {
+        return ref_cnt_;
+    }
+
+    // The hit ratios of point_num cache sizes of max_size / point_num, 2 * max_size / point_num, ..., max_size
+    std::vector<MrcPoint> curve(const size_t point_num) const;
+
+    // The hit ratio of the SLRU cache of split_size for each protected percent, the best first
+    std::vector<MrcSplit> splits() const;
+
+private:
+    static uint64_t value_of(const uint64_t hash)
+    {
+        // not the bits of the shards, the stripes and the Bloom filter
+        return ((hash ^ (hash >> 29)) * 0xBF58476D1CE4E5B9ull) >> 40;
+    }
+
+    void add_sampled(const std::string& key, const uint64_t hash);
+    void lower_threshold();
+    void renumber();
+    void resize_sims();
+    void evict_sim(MiniSim& sim);
+
+    void fenwick_add(size_t pos, const int delta);
+    // the number of the bits in [0, pos]
+    size_t fenwick_sum(size_t pos) const;
+};
+
+}   // namespace cmp_mem_engine
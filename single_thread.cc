@@ -4,7 +4,7 @@
 #include <memory>
 #include <ctime>
 
-#include "const_and_share_struct.h"
+#include "cache_data.h"
 
 namespace cmp_mem_engine
 {
@@ -7,6 +7,7 @@
 #include <list>
 
 #include "const_and_share_struct.h"
+#include "cache_data.h"
 #include "random_str.h"
 
 
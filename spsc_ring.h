@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cassert>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "const_and_share_struct.h"
+
+namespace cmp_mem_engine
+{
+
+/* Bounded single producer single consumer ring.
+ *
+ * The writer owns tail_ and a cached copy of head_, the reader owns head_ and a cached copy of tail_,
+ * the two pairs are on separate cache lines. A side reloads the other index only when its cached one
+ * says full (or empty), and publishes its own index once for a batch,
+ * so a batch of any size costs a few cache line transfers.
+ * The indexes increase forever, the slot is index & mask_.
+ */
+template <typename T>
+class SpscRing
+{
+private:
+    // the writer side
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+
+    // the reader side
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+
+    alignas(kCacheLineSize) const size_t mask_;
+    std::vector<T> slots_;
+
+public:
+    SpscRing() = delete;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing(SpscRing&&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    SpscRing& operator=(SpscRing&&) = delete;
+
+    // depth must be a power of 2
+    explicit SpscRing(const size_t depth) : mask_(depth - 1), slots_(depth)
+    {
+        assert(depth != 0 && (depth & (depth - 1)) == 0);
+    }
+
+    size_t depth() const
+    {
+        return mask_ + 1;
+    }
+
+    // Called by the writer. Push items[0, n) as many as possible, return the number pushed
+    size_t push(const T* items, const size_t n)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+
+        size_t room = depth() - (tail - cached_head_);
+        if (room < n)
+        {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            room = depth() - (tail - cached_head_);
+        }
+
+        const size_t cnt = std::min(room, n);
+        if (cnt == 0)
+            return 0;
+
+        for (size_t i = 0; i != cnt; ++i)
+            slots_[(tail + i) & mask_] = items[i];
+
+        tail_.store(tail + cnt, std::memory_order_release);
+        return cnt;
+    }
+
+    // Called by the reader. Call on_item(const T&) for at most max items, return the number popped
+    template <typename F>
+    size_t pop(const size_t max, F&& on_item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == cached_tail_)
+        {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+                return 0;
+        }
+
+        const size_t cnt = std::min(cached_tail_ - head, max);
+
+        for (size_t i = 0; i != cnt; ++i)
+            on_item(slots_[(head + i) & mask_]);
+
+        head_.store(head + cnt, std::memory_order_release);
+        return cnt;
+    }
+};
+
+}   // namespace cmp_mem_engine
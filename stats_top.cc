@@ -0,0 +1,279 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "live_stats.h"
+
+// Watch the LiveStats of a running cmp (see live_stats.h) like top.
+// Every second it samples all blocks and prints the rates of the last second.
+// usage: ./stats_top [shared memory name]
+
+namespace
+{
+
+using cmp_mem_engine::LiveStatsHeader;
+using cmp_mem_engine::LiveStatsBlock;
+using cmp_mem_engine::LiveStatsRole;
+
+struct Segment
+{
+    const LiveStatsHeader* header = nullptr;
+    const LiveStatsBlock* blocks = nullptr;
+    void* addr = nullptr;
+    size_t size = 0;
+};
+
+// return false if the segment does not exist or the layout is not the same version
+bool open_segment(const char* name, Segment& seg)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+        return false;
+
+    void* addr = mmap(nullptr, sizeof(LiveStatsHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    const LiveStatsHeader* h = static_cast<const LiveStatsHeader*>(addr);
+    if (h->magic != cmp_mem_engine::kLiveStatsMagic
+        || h->version != cmp_mem_engine::kLiveStatsVersion
+        || h->block_size != sizeof(LiveStatsBlock))
+    {
+        std::cerr << "stats_top: layout of " << name << " is not version " << cmp_mem_engine::kLiveStatsVersion << '\n';
+        munmap(addr, sizeof(LiveStatsHeader));
+        close(fd);
+        return false;
+    }
+
+    const size_t size = sizeof(LiveStatsHeader) + h->max_block_num * sizeof(LiveStatsBlock);
+    munmap(addr, sizeof(LiveStatsHeader));
+
+    addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    seg.addr = addr;
+    seg.size = size;
+    seg.header = static_cast<const LiveStatsHeader*>(addr);
+    seg.blocks = reinterpret_cast<const LiveStatsBlock*>(static_cast<const char*>(addr) + sizeof(LiveStatsHeader));
+    return true;
+}
+
+// copy all published blocks, return the generation
+uint64_t snapshot(const Segment& seg, std::vector<LiveStatsBlock>& blocks)
+{
+    const uint64_t generation = seg.header->generation.load(std::memory_order_acquire);
+    const uint32_t num = seg.header->block_num.load(std::memory_order_acquire);
+
+    blocks.resize(num);
+    if (num != 0)
+        std::memcpy(static_cast<void*>(blocks.data()), seg.blocks, num * sizeof(LiveStatsBlock));
+
+    return generation;
+}
+
+std::string rate_to_str(const double rate)
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1);
+    if (rate >= 1e9)
+        os << rate / 1e9 << "g";
+    else if (rate >= 1e6)
+        os << rate / 1e6 << "m";
+    else if (rate >= 1e3)
+        os << rate / 1e3 << "k";
+    else
+        os << rate;
+    return os.str();
+}
+
+double percent(const size_t part, const size_t total)
+{
+    return total == 0 ? 0 : static_cast<double>(part) * 100 / static_cast<double>(total);
+}
+
+void print_rates(const std::vector<LiveStatsBlock>& prev, const std::vector<LiveStatsBlock>& cur, const double seconds)
+{
+    std::cout << "\033[H\033[2J";       // clear screen
+    std::cout << std::left << std::setw(10) << "role" << std::setw(6) << "id"
+              << std::setw(10) << "qps" << std::setw(8) << "hit%"
+              << std::setw(8) << "busy%" << std::setw(8) << "idle%"
+              << std::setw(10) << "wait/s" << std::setw(10) << "sleep/s" << std::setw(8) << "batch" << std::setw(8) << "dedup%"
+              << std::setw(10) << "expire/s" << std::setw(10) << "load/s" << std::setw(11) << "compute/s" << '\n';
+
+    double producer_qps = 0;
+    for (size_t i = 0; i != cur.size(); ++i)
+    {
+        const LiveStatsBlock& c = cur[i];
+        const LiveStatsBlock empty{};
+        const LiveStatsBlock& p = i < prev.size() ? prev[i] : empty;
+
+        std::cout << std::fixed << std::setprecision(1);
+        if (c.role == LiveStatsRole::kConsumer)
+        {
+            const size_t hit = c.consumer.hit_cnt - p.consumer.hit_cnt;
+            const size_t miss = c.consumer.miss_cnt - p.consumer.miss_cnt;
+            const double busy = percent(c.consumer.busy_ns - p.consumer.busy_ns, static_cast<size_t>(seconds * 1e9));
+            const size_t batches = c.consumer.batch_cnt - p.consumer.batch_cnt;
+            const double batch = batches == 0 ? 0 : static_cast<double>(c.consumer.bench_cnt - p.consumer.bench_cnt) / batches;
+            std::cout << std::setw(10) << "consumer" << std::setw(6) << c.id
+                      << std::setw(10) << rate_to_str((c.consumer.bench_cnt - p.consumer.bench_cnt) / seconds)
+                      << std::setw(8) << percent(hit, hit + miss)
+                      << std::setw(8) << busy << std::setw(8) << 100 - busy
+                      << std::setw(10) << rate_to_str((c.consumer.wait_cnt - p.consumer.wait_cnt) / seconds)
+                      << std::setw(10) << rate_to_str((c.consumer.sleep_cnt - p.consumer.sleep_cnt) / seconds)
+                      << std::setw(8) << batch
+                      << std::setw(8) << percent(c.consumer.dedup_cnt - p.consumer.dedup_cnt, 
+                                                 c.consumer.bench_cnt - p.consumer.bench_cnt)
+                      << std::setw(10) << rate_to_str((c.consumer.expired_cnt - p.consumer.expired_cnt) / seconds)
+                      << std::setw(10) << rate_to_str((c.consumer.load_cnt - p.consumer.load_cnt) / seconds)
+                      << std::setw(11) << rate_to_str((c.consumer.compute_cnt - p.consumer.compute_cnt) / seconds)
+                      << '\n';
+        }
+        else if (c.role == LiveStatsRole::kProducer)
+        {
+            const size_t hit = c.producer.hit_cnt - p.producer.hit_cnt;
+            const size_t miss = c.producer.miss_cnt - p.producer.miss_cnt;
+            const double qps = (hit + miss) / seconds;
+            producer_qps += qps;
+            std::cout << std::setw(10) << "producer" << std::setw(6) << c.id
+                      << std::setw(10) << rate_to_str(qps)
+                      << std::setw(8) << percent(hit, hit + miss)
+                      << std::setw(8) << "-" << std::setw(8) << "-"
+                      << std::setw(10) << rate_to_str((c.producer.result_wait_cnt - p.producer.result_wait_cnt) / seconds)
+                      << std::setw(10) << rate_to_str((c.producer.sleep_cnt - p.producer.sleep_cnt) / seconds)
+                      << '\n';
+        }
+    }
+
+    std::cout << "producers qps(total) = " << rate_to_str(producer_qps) << std::endl;
+}
+
+// the heavy hitters of each consumer, skip the one which was being refreshed when copied
+void print_top_keys(const Segment& seg, const std::vector<LiveStatsBlock>& cur)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    for (size_t i = 0; i != cur.size(); ++i)
+    {
+        const LiveStatsBlock& c = cur[i];
+        if (c.role != LiveStatsRole::kConsumer)
+            continue;
+
+        std::cout << "consumer " << c.id << " top keys:";
+        if (c.consumer.top_seq % 2 != 0 || seg.blocks[i].consumer.top_seq != c.consumer.top_seq)
+        {
+            std::cout << " (refreshing)\n";
+            continue;
+        }
+
+        for (size_t k = 0; k != c.consumer.top_num && k != cmp_mem_engine::kHeavyHitterTopNum; ++k)
+        {
+            const cmp_mem_engine::HeavyHitter& h = c.consumer.top_keys[k];
+            std::cout << ' ' << h.head(12) << '(' << h.count << "±" << h.error << ')';
+        }
+        std::cout << '\n';
+    }
+}
+
+// the eviction policy of each consumer in the window: the hits of the protected segment, the moves and the ages
+void print_policy(const std::vector<LiveStatsBlock>& prev, const std::vector<LiveStatsBlock>& cur, const double seconds)
+{
+    using cmp_mem_engine::PolicyTelemetry;
+    using cmp_mem_engine::kAgeBucketNum;
+
+    std::cout << std::left << std::setw(10) << "policy" << std::setw(6) << "id"
+              << std::setw(8) << "prot%" << std::setw(10) << "promote/s" << std::setw(10) << "demote/s"
+              << std::setw(10) << "evict/s" << std::setw(16) << "prot/probation"
+              << std::setw(16) << "hit age p50/99" << std::setw(16) << "evict age p50/99" << '\n';
+
+    for (size_t i = 0; i != cur.size(); ++i)
+    {
+        const LiveStatsBlock& c = cur[i];
+        if (c.role != LiveStatsRole::kConsumer)
+            continue;
+
+        const LiveStatsBlock empty{};
+        const PolicyTelemetry& pt = i < prev.size() ? prev[i].consumer.policy : empty.consumer.policy;
+        const PolicyTelemetry& ct = c.consumer.policy;
+
+        uint64_t hit_age[kAgeBucketNum];
+        uint64_t evict_age[kAgeBucketNum];
+        for (size_t b = 0; b != kAgeBucketNum; ++b)
+        {
+            hit_age[b] = ct.hit_age[b] - pt.hit_age[b];
+            evict_age[b] = ct.evict_age[b] - pt.evict_age[b];
+        }
+
+        const size_t protected_hit = ct.protected_hit_cnt - pt.protected_hit_cnt;
+        const size_t probation_hit = ct.probation_hit_cnt - pt.probation_hit_cnt;
+        const std::string occupancy = std::to_string(ct.protected_num) + "/" + std::to_string(ct.probation_num);
+        const std::string hit_ages = std::to_string(PolicyTelemetry::age_percentile(hit_age, 50)) + "/"
+                                     + std::to_string(PolicyTelemetry::age_percentile(hit_age, 99));
+        const std::string evict_ages = std::to_string(PolicyTelemetry::age_percentile(evict_age, 50)) + "/"
+                                       + std::to_string(PolicyTelemetry::age_percentile(evict_age, 99));
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(10) << "consumer" << std::setw(6) << c.id
+                  << std::setw(8) << percent(protected_hit, protected_hit + probation_hit)
+                  << std::setw(10) << rate_to_str((ct.promote_cnt - pt.promote_cnt) / seconds)
+                  << std::setw(10) << rate_to_str((ct.demote_cnt - pt.demote_cnt) / seconds)
+                  << std::setw(10) << rate_to_str((ct.evict_cnt - pt.evict_cnt) / seconds)
+                  << std::setw(16) << occupancy << std::setw(16) << hit_ages << std::setw(16) << evict_ages << '\n';
+    }
+}
+
+}   // namespace
+
+int main(int argc, char* argv[])
+{
+    using namespace std::chrono_literals;
+
+    const char* name = argc > 1 ? argv[1] : cmp_mem_engine::kLiveStatsName;
+
+    Segment seg;
+    while (!open_segment(name, seg))
+    {
+        std::cout << "waiting for " << name << " ..." << std::endl;
+        std::this_thread::sleep_for(1s);
+    }
+
+    std::vector<LiveStatsBlock> prev, cur;
+    uint64_t prev_generation = snapshot(seg, prev);
+    auto prev_time = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        std::this_thread::sleep_for(1s);
+
+        const uint64_t generation = snapshot(seg, cur);
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - prev_time).count();
+
+        if (generation != prev_generation)
+            prev.clear();       // a new run, the rates start from zero
+
+        print_rates(prev, cur, seconds);
+        print_top_keys(seg, cur);
+        print_policy(prev, cur, seconds);
+
+        prev.swap(cur);
+        prev_generation = generation;
+        prev_time = now;
+    }
+
+    return 0;
+}
@@ -1,10 +1,36 @@
 #include <iostream>
+#include <iomanip>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Part 1: the overshoot of sleep.
 // Test result show Linux and MacOS need less than 100us timer resolution
 // For long sleep, there is 100us more cost for 1ms or 10ms sleep
+//
+// Part 2: the wake-up latency between two threads (for choosing the idle strategy of the consumer).
+// Two threads ping-pong by one mechanism, the round trip time is measured for each round,
+// with the threads on the same core, on the SMT siblings, and on different cores.
+// Each run is bounded by kPingPongRounds and kPingPongTimeLimit.
+//
+// build: make sleep_cost (C++20 for std::atomic::wait)
 
 constexpr size_t kNumMicrosPerSecond = 1000000;
 
@@ -13,14 +39,14 @@ enum class SleepMethod
     kSleepFor, kNanoSleep,
 };
 
-void test_sleep(const SleepMethod sleep_method, const size_t micros)
+void test_sleep(const SleepMethod sleep_method, const size_t micros, const int repeat)
 {
     using namespace std::chrono_literals;
 
     std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
     int cnt = 0;
-    while (cnt != 100'000)
+    while (cnt != repeat)
     {
         switch (sleep_method)
         {
@@ -31,6 +57,7 @@ void test_sleep(const SleepMethod sleep_method, const size_t micros)
             int ret;
             ret = nanosleep(&sleep_time, &sleep_time);
             assert(ret == 0);
+            (void)ret;
             break;
 
         case SleepMethod::kSleepFor:
@@ -40,7 +67,7 @@ void test_sleep(const SleepMethod sleep_method, const size_t micros)
         default:
             assert(0);
         }
-        
+
         ++cnt;
     }
 
@@ -48,17 +75,456 @@ void test_sleep(const SleepMethod sleep_method, const size_t micros)
     std::chrono::microseconds duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
     std::cout << "SleepMothod = " << (sleep_method == SleepMethod::kSleepFor ? "kSleepFor" : "kNanoSleep")
-              << "total repeat times = " << cnt 
+              << ", sleep(us) = " << micros
+              << ", total repeat times = " << cnt
               << ", elasped time(ms) = " << duration.count() / 1000
               << ", one avg sleep(us) = " << duration.count() / cnt
               << '\n';
 }
 
+constexpr size_t kPingPongRounds = 20'000;
+constexpr std::chrono::milliseconds kPingPongTimeLimit = std::chrono::milliseconds(300);
+
+/* The events, each one has one poster and one waiter, post() and wait() alternate.
+ *   void post();     wake up the waiter
+ *   void wait();     return after post(), and reset for the next post()
+ */
+
+// busy loop on the flag
+class SpinEvent
+{
+private:
+    std::atomic<uint32_t> flag_{0};
+
+public:
+    void post()
+    {
+        flag_.store(1, std::memory_order_release);
+    }
+
+    void wait()
+    {
+        while (flag_.load(std::memory_order_acquire) == 0)
+        {}
+        flag_.store(0, std::memory_order_relaxed);
+    }
+};
+
+// sched_yield() for each check
+class YieldEvent
+{
+private:
+    std::atomic<uint32_t> flag_{0};
+
+public:
+    void post()
+    {
+        flag_.store(1, std::memory_order_release);
+    }
+
+    void wait()
+    {
+        while (flag_.load(std::memory_order_acquire) == 0)
+            sched_yield();
+        flag_.store(0, std::memory_order_relaxed);
+    }
+};
+
+// futex syscall for each post and wait
+class FutexEvent
+{
+private:
+    std::atomic<uint32_t> flag_{0};
+
+public:
+    void post()
+    {
+        flag_.store(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&flag_), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    void wait()
+    {
+        while (flag_.load(std::memory_order_acquire) == 0)
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&flag_), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+        flag_.store(0, std::memory_order_relaxed);
+    }
+};
+
+class AtomicWaitEvent
+{
+private:
+    std::atomic<uint32_t> flag_{0};
+
+public:
+    void post()
+    {
+        flag_.store(1, std::memory_order_release);
+        flag_.notify_one();
+    }
+
+    void wait()
+    {
+        flag_.wait(0, std::memory_order_acquire);
+        flag_.store(0, std::memory_order_relaxed);
+    }
+};
+
+class CondVarEvent
+{
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool flag_ = false;
+
+public:
+    void post()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            flag_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        cv_.wait(lk, [this] { return flag_; });
+        flag_ = false;
+    }
+};
+
+class SemEvent
+{
+private:
+    sem_t sem_;
+
+public:
+    SemEvent()
+    {
+        sem_init(&sem_, 0, 0);
+    }
+
+    ~SemEvent()
+    {
+        sem_destroy(&sem_);
+    }
+
+    void post()
+    {
+        sem_post(&sem_);
+    }
+
+    void wait()
+    {
+        while (sem_wait(&sem_) != 0)
+        {}
+    }
+};
+
+class EventFdEvent
+{
+private:
+    const int fd_;
+
+public:
+    EventFdEvent() : fd_(eventfd(0, 0))
+    {}
+
+    ~EventFdEvent()
+    {
+        close(fd_);
+    }
+
+    void post()
+    {
+        const uint64_t one = 1;
+        const ssize_t n = write(fd_, &one, sizeof(one));
+        assert(n == sizeof(one));
+        (void)n;
+    }
+
+    void wait()
+    {
+        uint64_t val;
+        const ssize_t n = read(fd_, &val, sizeof(val));
+        assert(n == sizeof(val));
+        (void)n;
+    }
+};
+
+class PipeEvent
+{
+private:
+    int fds_[2];
+
+public:
+    PipeEvent()
+    {
+        const int res = pipe(fds_);
+        assert(res == 0);
+        (void)res;
+    }
+
+    ~PipeEvent()
+    {
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    void post()
+    {
+        const char c = 1;
+        const ssize_t n = write(fds_[1], &c, 1);
+        assert(n == 1);
+        (void)n;
+    }
+
+    void wait()
+    {
+        char c;
+        const ssize_t n = read(fds_[0], &c, 1);
+        assert(n == 1);
+        (void)n;
+    }
+};
+
+// The two CPUs of a placement, -1 meaning not pinned
+struct Placement
+{
+    const char* name;
+    int cpu_a;
+    int cpu_b;
+};
+
+struct PingPongResult
+{
+    size_t rounds;
+    uint64_t median_ns;
+    uint64_t p99_ns;
+    double rounds_per_sec;
+};
+
+// pin the calling thread to cpu, -1 for no pinning
+bool pin_this_thread(const int cpu)
+{
+    if (cpu < 0)
+        return true;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+template <typename Event>
+PingPongResult ping_pong(const Placement& placement)
+{
+    Event ping, pong;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> b_ready{false};
+
+    std::vector<uint64_t> rtts;
+    rtts.reserve(kPingPongRounds);
+
+    std::chrono::steady_clock::time_point start, end;
+
+    // B: wait for ping then pong back, until stop
+    std::thread b([&]
+    {
+        pin_this_thread(placement.cpu_b);
+        b_ready.store(true, std::memory_order_release);
+
+        while (true)
+        {
+            ping.wait();
+            if (stop.load(std::memory_order_relaxed))
+                break;
+            pong.post();
+        }
+    });
+
+    // A: ping, wait for pong, measure the round trip
+    std::thread a([&]
+    {
+        // both are pinned before the first round
+        pin_this_thread(placement.cpu_a);
+        while (!b_ready.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        start = std::chrono::steady_clock::now();
+        const std::chrono::steady_clock::time_point deadline = start + kPingPongTimeLimit;
+
+        std::chrono::steady_clock::time_point t0 = start;
+        for (size_t i = 0; i != kPingPongRounds; ++i)
+        {
+            ping.post();
+            pong.wait();
+
+            const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            rtts.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+            t0 = t1;
+
+            if (t1 >= deadline)
+                break;
+        }
+        end = t0;
+
+        stop.store(true, std::memory_order_relaxed);
+        ping.post();
+    });
+
+    a.join();
+    b.join();
+
+    std::sort(rtts.begin(), rtts.end());
+
+    PingPongResult res;
+    res.rounds = rtts.size();
+    res.median_ns = rtts[rtts.size() / 2];
+    res.p99_ns = rtts[std::min(rtts.size() - 1, rtts.size() * 99 / 100)];
+    res.rounds_per_sec = static_cast<double>(rtts.size()) * 1e9
+                         / std::max<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), 1);
+    return res;
+}
+
+template <typename Event>
+void report_ping_pong(const char* mechanism, const Placement& placement)
+{
+    const PingPongResult r = ping_pong<Event>(placement);
+
+    std::cout << std::left << std::setw(16) << placement.name
+              << std::setw(14) << mechanism
+              << std::right << std::setw(12) << r.median_ns
+              << std::setw(12) << r.p99_ns
+              << std::setw(14) << static_cast<size_t>(r.rounds_per_sec)
+              << std::setw(10) << r.rounds
+              << '\n';
+}
+
+// the CPUs this process can run on
+std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return cpus;
+
+    for (int i = 0; i != CPU_SETSIZE; ++i)
+    {
+        if (CPU_ISSET(i, &set))
+            cpus.push_back(i);
+    }
+
+    return cpus;
+}
+
+// the SMT siblings of cpu (include cpu), from sysfs like "0,4" or "0-1"
+std::vector<int> smt_siblings(const int cpu)
+{
+    std::vector<int> res;
+
+    std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+    std::string list;
+    if (!std::getline(in, list))
+        return res;
+
+    std::stringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ','))
+    {
+        const size_t dash = part.find('-');
+        if (dash == std::string::npos)
+        {
+            res.push_back(std::stoi(part));
+        }
+        else
+        {
+            for (int i = std::stoi(part.substr(0, dash)); i <= std::stoi(part.substr(dash + 1)); ++i)
+                res.push_back(i);
+        }
+    }
+
+    return res;
+}
+
+std::vector<Placement> find_placements()
+{
+    std::vector<Placement> placements;
+
+    const std::vector<int> cpus = allowed_cpus();
+    if (cpus.empty())
+    {
+        placements.push_back({"not pinned", -1, -1});
+        return placements;
+    }
+
+    const int first = cpus[0];
+    placements.push_back({"same core", first, first});
+
+    const std::vector<int> siblings = smt_siblings(first);
+    int sibling = -1;
+    int other = -1;
+    for (const int cpu : cpus)
+    {
+        if (cpu == first)
+            continue;
+
+        const bool is_sibling = std::find(siblings.begin(), siblings.end(), cpu) != siblings.end();
+        if (is_sibling && sibling == -1)
+            sibling = cpu;
+        if (!is_sibling && other == -1)
+            other = cpu;
+    }
+
+    if (sibling != -1)
+        placements.push_back({"smt sibling", first, sibling});
+    else
+        std::cout << "smt sibling: skipped, no SMT sibling of cpu " << first << " is available\n";
+
+    if (other != -1)
+        placements.push_back({"different core", first, other});
+    else
+        std::cout << "different core: skipped, only one core is available\n";
+
+    return placements;
+}
+
+void test_ping_pong()
+{
+    const std::vector<Placement> placements = find_placements();
+
+    std::cout << std::left << std::setw(16) << "placement"
+              << std::setw(14) << "mechanism"
+              << std::right << std::setw(12) << "median(ns)"
+              << std::setw(12) << "p99(ns)"
+              << std::setw(14) << "round trips/s"
+              << std::setw(10) << "rounds"
+              << '\n';
+
+    for (const Placement& placement : placements)
+    {
+        report_ping_pong<SpinEvent>("spin", placement);
+        report_ping_pong<YieldEvent>("sched_yield", placement);
+        report_ping_pong<FutexEvent>("futex", placement);
+        report_ping_pong<AtomicWaitEvent>("atomic::wait", placement);
+        report_ping_pong<CondVarEvent>("condvar", placement);
+        report_ping_pong<SemEvent>("semaphore", placement);
+        report_ping_pong<EventFdEvent>("eventfd", placement);
+        report_ping_pong<PipeEvent>("pipe", placement);
+    }
+}
+
 int main()
 {
-    test_sleep(SleepMethod::kSleepFor, 10);
+    test_sleep(SleepMethod::kSleepFor, 10, 10'000);
 
-    test_sleep(SleepMethod::kNanoSleep, 10);
+    test_sleep(SleepMethod::kNanoSleep, 10, 10'000);
+
+    test_ping_pong();
 
     return 0;
-}
\ No newline at end of file
+}
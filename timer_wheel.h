@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <string>
+
+/* A hierarchical timing wheel of the keys with TTL, owned by the consumer thread.
+ *
+ * The time is in ms (uint32_t, so about 49 days from the start). There are kLevelNum levels of kSlotNum slots,
+ * a timer of level l is in the slot of bits [8l, 8l+8) of its expire time, if the expire time is less than 256^(l+1) ms later.
+ * When the wheel time passes a multiple of 256^l, the slot of level l is cascaded to the lower levels,
+ * so each timer is moved no more than kLevelNum - 1 times before it is due.
+ *
+ * advance() does a bounded number of steps (a timer moved or due, or a tick), and goes on from there next time,
+ * so the caller never pays for a burst of expiry at once. A timer is (key, expire) of 16 bytes.
+ */
+
+namespace cmp_mem_engine
+{
+
+class TimerWheel
+{
+private:
+    static constexpr size_t kLevelBits = 8;
+    static constexpr size_t kSlotNum = size_t(1) << kLevelBits;
+    static constexpr uint32_t kSlotMask = kSlotNum - 1;
+    static constexpr size_t kLevelNum = 4;
+
+    struct Timer
+    {
+        const std::string* key;
+        uint32_t expire_ms;
+    };
+
+    std::array<std::array<std::vector<Timer>, kSlotNum>, kLevelNum> slots_;
+    uint32_t current_ms_ = 0;       // the slot of current_ms_ in level 0 is being processed
+    size_t cascade_level_ = 0;      // not 0 if the slot of the level is being cascaded for current_ms_
+    size_t size_ = 0;
+
+public:
+    TimerWheel() = default;
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // a timer already due is due in the next advance()
+    void insert(const std::string* key, const uint32_t expire_ms)
+    {
+        place(Timer{key, expire_ms});
+    }
+
+    // Advance the wheel to now_ms by no more than budget steps, call on_due(key, expire_ms) for each due timer.
+    // Return the number of due timers
+    template <typename F>
+    size_t advance(const uint32_t now_ms, size_t budget, F&& on_due)
+    {
+        if (size_ == 0)
+        {
+            // nothing to cascade or due, jump to now
+            if (now_ms > current_ms_)
+            {
+                current_ms_ = now_ms;
+                cascade_level_ = 0;
+            }
+            return 0;
+        }
+
+        size_t due_cnt = 0;
+        while (budget != 0)
+        {
+            --budget;
+
+            if (cascade_level_ != 0)
+            {
+                std::vector<Timer>& slot = slots_[cascade_level_][slot_of(current_ms_, cascade_level_)];
+                if (slot.empty())
+                {
+                    --cascade_level_;
+                    continue;
+                }
+
+                const Timer timer = slot.back();
+                slot.pop_back();
+                --size_;
+                place(timer);
+                continue;
+            }
+
+            std::vector<Timer>& slot = slots_[0][current_ms_ & kSlotMask];
+            if (!slot.empty())
+            {
+                const Timer timer = slot.back();
+                slot.pop_back();
+                --size_;
+                on_due(timer.key, timer.expire_ms);
+                ++due_cnt;
+                continue;
+            }
+
+            if (current_ms_ >= now_ms)
+                break;
+
+            // the next tick, cascade the highest level first if it is the start of its slot
+            ++current_ms_;
+            if ((current_ms_ & kSlotMask) == 0)
+            {
+                cascade_level_ = 1;
+                while (cascade_level_ + 1 < kLevelNum && slot_of(current_ms_, cascade_level_) == 0)
+                    ++cascade_level_;
+            }
+        }
+
+        return due_cnt;
+    }
+
+private:
+    static size_t slot_of(const uint32_t ms, const size_t level)
+    {
+        return (ms >> (level * kLevelBits)) & kSlotMask;
+    }
+
+    void place(const Timer& timer)
+    {
+        ++size_;
+
+        if (timer.expire_ms <= current_ms_)
+        {
+            slots_[0][current_ms_ & kSlotMask].push_back(timer);
+            return;
+        }
+
+        const uint32_t delta = timer.expire_ms - current_ms_;
+        size_t level = 0;
+        while (level + 1 < kLevelNum && (delta >> ((level + 1) * kLevelBits)) != 0)
+            ++level;
+
+        slots_[level][slot_of(timer.expire_ms, level)].push_back(timer);
+    }
+};
+
+}   // namespace cmp_mem_engine
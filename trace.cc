@@ -0,0 +1,176 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+namespace cmp_mem_engine
+{
+
+std::atomic<bool> Tracer::enabled_{false};
+thread_local TraceBuffer* Tracer::buffer_ = nullptr;
+
+namespace
+{
+
+// the buffers live until exit, so they can be dumped after the threads have exited
+std::mutex g_buffers_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> g_buffers;
+
+std::string g_dump_path;
+
+// pair of (tsc, steady clock) for converting TSC to microseconds
+struct ClockPoint
+{
+    uint64_t tsc;
+    std::chrono::steady_clock::time_point time;
+
+    static ClockPoint now()
+    {
+        return {Tracer::now_tsc(), std::chrono::steady_clock::now()};
+    }
+};
+
+ClockPoint g_start;
+
+const char* event_name(const TraceType type)
+{
+    switch (type)
+    {
+    case TraceType::kRequestPublish:
+        return "publish";
+    case TraceType::kConsumerPickup:
+    case TraceType::kLookupDone:
+        return "serve";
+    case TraceType::kResultObserved:
+        return "result";
+    }
+    return "unknown";
+}
+
+// the consumer batch is shown as a slice (from pickup to lookup done), others are instant events
+const char* event_phase(const TraceType type)
+{
+    switch (type)
+    {
+    case TraceType::kConsumerPickup:
+        return "B";
+    case TraceType::kLookupDone:
+        return "E";
+    default:
+        return "i";
+    }
+}
+
+void dump_at_exit()
+{
+    Tracer::dump(g_dump_path.c_str());
+}
+
+}   // namespace
+
+void Tracer::enable(const char* path)
+{
+    if (is_enabled())
+        return;
+
+    g_dump_path = path;
+    g_start = ClockPoint::now();
+    std::atexit(dump_at_exit);
+
+    enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::enable_by_env()
+{
+    const char* path = std::getenv("CMP_TRACE");
+    if (path != nullptr && path[0] != '\0')
+        enable(path);
+}
+
+TraceBuffer* Tracer::new_thread_buffer()
+{
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+    g_buffers.push_back(std::make_unique<TraceBuffer>(static_cast<uint32_t>(g_buffers.size() + 1)));
+    buffer_ = g_buffers.back().get();
+    buffer_->name = "thread " + std::to_string(buffer_->tid);
+
+    return buffer_;
+}
+
+void Tracer::set_thread_name(const std::string& name)
+{
+    if (!is_enabled())
+        return;
+
+    TraceBuffer* buffer = buffer_ == nullptr ? new_thread_buffer() : buffer_;
+    buffer->name = name;
+}
+
+bool Tracer::dump(const char* path)
+{
+    if (!is_enabled())
+        return false;
+
+    enabled_.store(false, std::memory_order_relaxed);
+
+    const ClockPoint end = ClockPoint::now();
+    const double elapsed_us = std::chrono::duration<double, std::micro>(end.time - g_start.time).count();
+    const double tsc_per_us = end.tsc > g_start.tsc && elapsed_us > 0
+                              ? static_cast<double>(end.tsc - g_start.tsc) / elapsed_us : 1.0;
+
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Tracer can not open " << path << '\n';
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+    size_t event_num = 0;
+    char line[256];
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::unique_ptr<TraceBuffer>& buffer : g_buffers)
+    {
+        std::snprintf(line, sizeof(line),
+                      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                      first ? "" : ",\n", buffer->tid, buffer->name.c_str());
+        out << line;
+        first = false;
+
+        // only the last kTraceBufferEvents events are kept
+        const size_t begin = buffer->head > kTraceBufferEvents ? buffer->head - kTraceBufferEvents : 0;
+        bool in_slice = false;
+        for (size_t i = begin; i != buffer->head; ++i)
+        {
+            const TraceEvent& e = buffer->events[i & (kTraceBufferEvents - 1)];
+
+            // the slice begin maybe overwritten
+            if (e.type == TraceType::kLookupDone && !in_slice)
+                continue;
+            in_slice = e.type == TraceType::kConsumerPickup;
+
+            const double ts = e.tsc >= g_start.tsc ? static_cast<double>(e.tsc - g_start.tsc) / tsc_per_us : 0;
+            std::snprintf(line, sizeof(line),
+                          ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s,\"args\":{\"n\":%u}}",
+                          event_name(e.type), event_phase(e.type), ts, buffer->tid,
+                          e.type == TraceType::kRequestPublish || e.type == TraceType::kResultObserved ? ",\"s\":\"t\"" : "",
+                          e.arg);
+            out << line;
+            ++event_num;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+    std::cout << "Tracer dumps " << event_num << " events of " << g_buffers.size() << " threads to " << path << '\n';
+    return true;
+}
+
+}   // namespace cmp_mem_engine
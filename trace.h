@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/* In-process event tracer for the timeline of producers and consumers.
+ *
+ * Each thread has its own ring buffer of compact events (TSC timestamp, type, arg),
+ * written by the owner thread only (no lock, no atomic), the oldest events are overwritten.
+ * At exit the buffers are dumped to Chrome trace JSON (open it in chrome://tracing or ui.perfetto.dev).
+ *
+ * Compile time: CMP_TRACE_EVENT() is nothing unless CMP_TRACE is defined (make cmp_trace).
+ * Run time:     nothing is recorded until Tracer::enable(), e.g., by the env CMP_TRACE=trace.json
+ */
+
+#ifdef CMP_TRACE
+#define CMP_TRACE_EVENT(type, arg) cmp_mem_engine::Tracer::record((type), static_cast<uint32_t>(arg))
+#define CMP_TRACE_THREAD(name) cmp_mem_engine::Tracer::set_thread_name(name)
+#else
+#define CMP_TRACE_EVENT(type, arg) ((void)0)
+#define CMP_TRACE_THREAD(name) ((void)0)
+#endif
+
+namespace cmp_mem_engine
+{
+
+enum class TraceType : uint32_t
+{
+    kRequestPublish,        // producer, arg is the number of keys sent
+    kConsumerPickup,        // consumer, arg is the number of requests in the batch
+    kLookupDone,            // consumer, arg is the number of requests in the batch
+    kResultObserved,        // producer, arg is the number of results received
+};
+
+struct TraceEvent
+{
+    uint64_t tsc;
+    TraceType type;
+    uint32_t arg;
+};
+
+constexpr size_t kTraceBufferEvents = 1<<16;      // 1M bytes for each thread
+static_assert((kTraceBufferEvents & (kTraceBufferEvents - 1)) == 0);
+
+struct TraceBuffer
+{
+    explicit TraceBuffer(const uint32_t _tid) : tid(_tid), events(kTraceBufferEvents)
+    {}
+
+    const uint32_t tid;
+    std::string name;
+    size_t head = 0;        // the number of events recorded, the ring position is head % kTraceBufferEvents
+    std::vector<TraceEvent> events;
+};
+
+class Tracer
+{
+private:
+    static std::atomic<bool> enabled_;
+    static thread_local TraceBuffer* buffer_;
+
+public:
+    // start recording, and dump to path at exit
+    static void enable(const char* path);
+    // enable if the env CMP_TRACE is set (as the path)
+    static void enable_by_env();
+    static bool is_enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static void set_thread_name(const std::string& name);
+
+    static void record(const TraceType type, const uint32_t arg)
+    {
+        if (!is_enabled())
+            return;
+
+        TraceBuffer* buffer = buffer_;
+        if (buffer == nullptr)
+            buffer = new_thread_buffer();       // only once for a thread
+
+        TraceEvent& e = buffer->events[buffer->head & (kTraceBufferEvents - 1)];
+        e.tsc = now_tsc();
+        e.type = type;
+        e.arg = arg;
+        ++buffer->head;
+    }
+
+    // write all events to path as Chrome trace JSON.
+    // The caller guarantees that the traced threads have exited
+    static bool dump(const char* path);
+
+    static uint64_t now_tsc()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+private:
+    static TraceBuffer* new_thread_buffer();
+};
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "parker.h"
+
+/* A wait strategy decides what a producer or a consumer thread does
+ * when one round of polling made no progress.
+ * It is a compile-time policy (no virtual function),
+ * so the loop of Producer<Transport, Wait> or Consumer<Transport, Wait> is inlined.
+ *
+ * Interface:
+ *   void bind(Parker& parker);   called once before the threads start, parker is the one which
+ *                                the other side unparks when there is work for this thread
+ *   void reset();    some progress is made, go back to the most aggressive state
+ *   bool idle();     no progress in this round, return true if the thread has slept (for stats)
+ */
+
+namespace cmp_mem_engine
+{
+
+// Busy loop without doing anything, the original behaviour of all producers
+class SpinWait
+{
+public:
+    void bind(Parker&)
+    {}
+
+    void reset()
+    {}
+
+    bool idle()
+    {
+        return false;
+    }
+};
+
+// Give up the time slice for each round of no progress
+class YieldWait
+{
+public:
+    void bind(Parker&)
+    {}
+
+    void reset()
+    {}
+
+    bool idle()
+    {
+        std::this_thread::yield();
+        return false;
+    }
+};
+
+// Sleep kSleepUs for each round of no progress
+template <long kSleepUs = 1>
+class SleepWait
+{
+public:
+    void bind(Parker&)
+    {}
+
+    void reset()
+    {}
+
+    bool idle()
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(kSleepUs));
+        return true;
+    }
+};
+
+// If in busy mode, loop for kBusyMs to check whether there is a task.
+// If no task at all, switch to **no busy mode**, which will sleep for kSleepUs then check again.
+// If a task is coming (i.e., reset()), switch to busy mode.
+// The default is the original behaviour of the consumer of pure and signal (100ms then 1ms)
+template <long kBusyMs = 100, long kSleepUs = 1000>
+class BusyThenSleepWait
+{
+private:
+    std::chrono::high_resolution_clock::time_point check_ = std::chrono::high_resolution_clock::now();
+    size_t check_cnt_ = 0;
+    bool busy_mode_ = true;
+
+public:
+    void bind(Parker&)
+    {}
+
+    void reset()
+    {
+        busy_mode_ = true;
+        check_cnt_ = 0;
+    }
+
+    bool idle()
+    {
+        if (!busy_mode_)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(kSleepUs));
+            return true;
+        }
+
+        if (check_cnt_ == 0)
+            check_ = std::chrono::high_resolution_clock::now();
+
+        ++check_cnt_;
+
+        if (check_cnt_ % (1<<10) == 0)
+        {
+            // reduce the call to chrono to make efficiency by mod(%)
+            std::chrono::high_resolution_clock::time_point cur = std::chrono::high_resolution_clock::now();
+            if (cur - check_ >= std::chrono::milliseconds(kBusyMs))
+                busy_mode_ = false;
+        }
+
+        return false;
+    }
+};
+
+// Spin with pause (exponential backoff up to kMaxPause) for kSpinRounds,
+// then yield for kYieldRounds, then park on the futex word until unparked.
+// So a short wait costs no syscall, and a long wait costs no CPU.
+template <size_t kSpinRounds = 64, size_t kYieldRounds = 16, size_t kMaxPause = 64>
+class ParkWait
+{
+private:
+    Parker* parker_ = nullptr;
+    size_t rounds_ = 0;
+    size_t pause_ = 1;
+    bool announced_ = false;
+
+public:
+    void bind(Parker& parker)
+    {
+        parker_ = &parker;
+        parker_->enable();
+    }
+
+    void reset()
+    {
+        if (announced_)
+        {
+            parker_->cancel();
+            announced_ = false;
+        }
+
+        rounds_ = 0;
+        pause_ = 1;
+    }
+
+    bool idle()
+    {
+        if (rounds_ < kSpinRounds)
+        {
+            ++rounds_;
+            for (size_t i = 0; i != pause_; ++i)
+                cpu_pause();
+            if (pause_ < kMaxPause)
+                pause_ *= 2;
+            return false;
+        }
+
+        if (rounds_ < kSpinRounds + kYieldRounds)
+        {
+            ++rounds_;
+            std::this_thread::yield();
+            return false;
+        }
+
+        // announce first, the caller polls once more, then park in the next round
+        if (!announced_)
+        {
+            parker_->announce();
+            announced_ = true;
+            return false;
+        }
+
+        parker_->park();
+        announced_ = false;
+        return true;
+    }
+
+private:
+    static void cpu_pause()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    }
+};
+
+// The CPU time of the calling thread, for comparing the cost of the wait strategies
+inline size_t thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<size_t>(ts.tv_sec) * 1'000'000'000 + static_cast<size_t>(ts.tv_nsec);
+}
+
+}   // namespace cmp_mem_engine
@@ -0,0 +1,184 @@
+#include "write_behind.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cmp_mem_engine
+{
+
+FileSink::FileSink(const char* path)
+{
+    fd_ = ::open(path, O_CREAT | O_WRONLY | O_TRUNC | O_APPEND, 0644);
+    if (fd_ == -1)
+        std::cerr << "FileSink open " << path << " failed, reason = " << std::strerror(errno) << '\n';
+}
+
+FileSink::~FileSink() noexcept
+{
+    if (fd_ != -1)
+        ::close(fd_);
+}
+
+bool FileSink::write(const std::vector<WriteRecord>& batch)
+{
+    if (fd_ == -1)
+        return false;
+
+    buf_.clear();
+    for (const WriteRecord& record : batch)
+    {
+        for (const std::string* part : {&record.key, &record.val})
+        {
+            const uint32_t len = static_cast<uint32_t>(part->size());
+            const char* len_bytes = reinterpret_cast<const char*>(&len);
+            buf_.insert(buf_.end(), len_bytes, len_bytes + sizeof(len));
+            buf_.insert(buf_.end(), part->begin(), part->end());
+        }
+    }
+
+    size_t done = 0;
+    while (done != buf_.size())
+    {
+        const ssize_t n = ::write(fd_, buf_.data() + done, buf_.size() - done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+WriteBehind::WriteBehind(Sink& sink, const WriteBehindConfig& config)
+    : sink_(sink), config_(config), last_flush_(std::chrono::steady_clock::now())
+{
+    flusher_ = std::thread(&WriteBehind::flusher_loop, this);
+}
+
+WriteBehind::~WriteBehind() noexcept
+{
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    batch_cv_.notify_one();
+
+    if (flusher_.joinable())
+        flusher_.join();
+}
+
+void WriteBehind::tick()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_flush_ >= config_.flush_interval)
+        flush();
+}
+
+void WriteBehind::flush()
+{
+    last_flush_ = std::chrono::steady_clock::now();
+    if (dirty_.empty())
+        return;
+
+    std::vector<WriteRecord> batch;
+    batch.reserve(dirty_.size());
+    for (auto& [key, val] : dirty_)
+        batch.push_back(WriteRecord{key, std::move(val)});
+    dirty_.clear();
+
+    const size_t bytes = dirty_bytes_;
+    dirty_bytes_ = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // the pending batches have half of the cap, the dirty map which grows next has the other half,
+        // so wait until the flusher makes room (one batch is always accepted)
+        if (pending_bytes_ != 0 && (pending_bytes_ + bytes) * 2 > config_.dirty_cap)
+        {
+            ++stall_cnt_;
+            written_cv_.wait(lock, [this, bytes] { return pending_bytes_ == 0 || (pending_bytes_ + bytes) * 2 <= config_.dirty_cap; });
+        }
+
+        batches_.push_back(std::move(batch));
+        pending_bytes_ += bytes;
+    }
+    batch_cv_.notify_one();
+}
+
+void WriteBehind::sync()
+{
+    flush();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    written_cv_.wait(lock, [this] { return pending_bytes_ == 0; });
+}
+
+WriteBehindStats WriteBehind::stats() const
+{
+    WriteBehindStats res;
+    res.put_cnt = put_cnt_;
+    res.put_bytes = put_bytes_;
+    res.stall_cnt = stall_cnt_;
+    res.record_cnt = record_cnt_.load(std::memory_order_relaxed);
+    res.flush_bytes = flush_bytes_.load(std::memory_order_relaxed);
+    res.batch_cnt = batch_cnt_.load(std::memory_order_relaxed);
+    res.flush_ns = flush_ns_.load(std::memory_order_relaxed);
+    res.fail_cnt = fail_cnt_.load(std::memory_order_relaxed);
+    return res;
+}
+
+void WriteBehind::flusher_loop()
+{
+    while (true)
+    {
+        std::vector<WriteRecord> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            batch_cv_.wait(lock, [this] { return stop_ || !batches_.empty(); });
+
+            // stop only after all batches are written
+            if (batches_.empty())
+                return;
+
+            batch = std::move(batches_.front());
+            batches_.pop_front();
+        }
+
+        size_t bytes = 0;
+        for (const WriteRecord& record : batch)
+            bytes += record.key.size() + record.val.size();
+
+        const auto begin = std::chrono::steady_clock::now();
+        const bool ok = sink_.write(batch);
+        const auto end = std::chrono::steady_clock::now();
+
+        flush_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(),
+                            std::memory_order_relaxed);
+        if (ok)
+        {
+            record_cnt_.fetch_add(batch.size(), std::memory_order_relaxed);
+            flush_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            batch_cnt_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            fail_cnt_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_bytes_ -= bytes;
+        }
+        written_cv_.notify_all();
+    }
+}
+
+}   // namespace cmp_mem_engine
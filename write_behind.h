@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+/* Write-behind: the cache is a write-back tier of a slower backing store (a Sink).
+ *
+ * A put marks its key dirty with a copy of the value, in a map owned by the cache thread, so a put costs
+ * a hash insert and a copy. The repeated puts of a dirty key are coalesced in the map, only the last value is written.
+ * The dirty map is handed to a background flusher thread as one batch when the flush interval has passed,
+ * or when the dirty bytes reach half of dirty_cap (so one batch can be written while the next one grows).
+ * The flusher writes each batch to the sink by one call.
+ *
+ * dirty_cap bounds the bytes of the dirty map and the batches not written yet together: half of it for each,
+ * so they can not pass dirty_cap by more than the last put (or one batch larger than the half, which is always taken).
+ * When the sink can not keep up, the hand-off waits for the flusher (a stall), so the memory is bounded
+ * and the writes are never dropped.
+ *
+ * The dirty map keeps its own copies, so a dirty key can be evicted from the cache before it is written.
+ */
+
+namespace cmp_mem_engine
+{
+
+constexpr std::chrono::milliseconds kWriteBehindInterval = std::chrono::milliseconds(100);
+constexpr size_t kWriteBehindDirtyCap = 16<<20;
+// the clock is read once for this many puts (and each idle round of the consumer)
+constexpr size_t kWriteBehindCheckMask = (1<<10) - 1;
+
+struct WriteRecord
+{
+    std::string key;
+    std::string val;
+};
+
+// The backing store of write-behind, write() is only called by the flusher thread
+class Sink
+{
+public:
+    virtual ~Sink() = default;
+
+    // Write the records of one batch, return false if failed (the batch is dropped and counted)
+    virtual bool write(const std::vector<WriteRecord>& batch) = 0;
+};
+
+// A stand-in of a backing store: the records of a batch are appended to a file by one write(),
+// a record is (key length, key, value length, value) with 4-byte lengths
+class FileSink : public Sink
+{
+private:
+    int fd_ = -1;
+    std::vector<char> buf_;
+
+public:
+    FileSink() = delete;
+    FileSink(const FileSink&) = delete;
+    FileSink(FileSink&&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+    FileSink& operator=(FileSink&&) = delete;
+
+    // the file of path is truncated
+    explicit FileSink(const char* path);
+    ~FileSink() noexcept override;
+
+    bool is_open() const
+    {
+        return fd_ != -1;
+    }
+
+    bool write(const std::vector<WriteRecord>& batch) override;
+};
+
+struct WriteBehindConfig
+{
+    std::chrono::milliseconds flush_interval = kWriteBehindInterval;
+    size_t dirty_cap = kWriteBehindDirtyCap;        // in bytes of keys and values
+};
+
+struct WriteBehindStats
+{
+    size_t put_cnt = 0;
+    size_t put_bytes = 0;
+    size_t stall_cnt = 0;           // the hand-offs which waited for the flusher
+    size_t record_cnt = 0;          // the records written to the sink, put_cnt - record_cnt puts are coalesced
+    size_t flush_bytes = 0;
+    size_t batch_cnt = 0;
+    size_t flush_ns = 0;            // the time of the sink writes
+    size_t fail_cnt = 0;            // the batches the sink failed to write
+
+    // the bytes written to the sink for each byte put, less than 1 if the puts are coalesced
+    double write_amplification() const
+    {
+        return put_bytes == 0 ? 0 : static_cast<double>(flush_bytes) / static_cast<double>(put_bytes);
+    }
+
+    // in MB/s of the time the flusher was writing
+    double flush_mb_per_sec() const
+    {
+        return flush_ns == 0 ? 0 : static_cast<double>(flush_bytes) * 1000 / static_cast<double>(flush_ns);
+    }
+};
+
+class WriteBehind
+{
+private:
+    Sink& sink_;
+    const WriteBehindConfig config_;
+
+    // owned by the cache thread
+    std::unordered_map<std::string, std::string> dirty_;
+    size_t dirty_bytes_ = 0;
+    size_t put_cnt_ = 0;
+    size_t put_bytes_ = 0;
+    size_t stall_cnt_ = 0;
+    std::chrono::steady_clock::time_point last_flush_;
+
+    // shared with the flusher thread
+    std::mutex mutex_;
+    std::condition_variable batch_cv_;          // the flusher waits for a batch
+    std::condition_variable written_cv_;        // the cache thread waits for room or for sync()
+    std::deque<std::vector<WriteRecord>> batches_;
+    size_t pending_bytes_ = 0;                  // of the batches not written yet, including the one being written
+    bool stop_ = false;
+
+    // written by the flusher thread
+    std::atomic<size_t> record_cnt_{0};
+    std::atomic<size_t> flush_bytes_{0};
+    std::atomic<size_t> batch_cnt_{0};
+    std::atomic<size_t> flush_ns_{0};
+    std::atomic<size_t> fail_cnt_{0};
+
+    std::thread flusher_;
+
+public:
+    WriteBehind() = delete;
+    WriteBehind(const WriteBehind&) = delete;
+    WriteBehind(WriteBehind&&) = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
+    WriteBehind& operator=(WriteBehind&&) = delete;
+
+    explicit WriteBehind(Sink& sink, const WriteBehindConfig& config = WriteBehindConfig());
+    // the dirty keys are written before the flusher exits
+    ~WriteBehind() noexcept;
+
+    // Mark key dirty with val, called by the cache thread
+    void put(const std::string& key, const std::string& val)
+    {
+        const auto [it, inserted] = dirty_.try_emplace(key);
+        if (inserted)
+            dirty_bytes_ += key.size();
+        else
+            dirty_bytes_ -= it->second.size();
+        dirty_bytes_ += val.size();
+        it->second = val;
+
+        ++put_cnt_;
+        put_bytes_ += key.size() + val.size();
+
+        if (dirty_bytes_ * 2 >= config_.dirty_cap)
+            flush();
+        else if ((put_cnt_ & kWriteBehindCheckMask) == 0)
+            tick();
+    }
+
+    // Flush if the interval has passed since the last flush, called by the cache thread now and then (e.g., when idle)
+    void tick();
+
+    // Hand the dirty keys to the flusher now
+    void flush();
+
+    // Flush and wait until all are written
+    void sync();
+
+    size_t dirty_bytes() const
+    {
+        return dirty_bytes_;
+    }
+
+    // read by the cache thread
+    WriteBehindStats stats() const;
+
+private:
+    void flusher_loop();
+};
+
+}   // namespace cmp_mem_engine